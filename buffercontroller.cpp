@@ -0,0 +1,151 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "buffercontroller.h"
+
+// How long the download rate has to stay well ahead before the target shrinks.
+static constexpr const qint64 kStablePeriod = 30000;
+// Download rate / consumption rate thresholds.
+static constexpr const qreal kGrowRatio = 1.0;
+static constexpr const qreal kShrinkRatio = 1.5;
+// Weight of a new sample in the moving averages.
+static constexpr const qreal kSampleWeight = 0.2;
+// A stall with at least this much of the limit buffered is blamed on decoding.
+static constexpr const qreal kFullBuffer = 0.9;
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+BufferController::Settings BufferController::settings() const
+{
+    return m_settings;
+}
+
+void BufferController::setSettings(const Settings &value)
+{
+    m_settings = value;
+    m_settings.minDuration = qMax(qint64(0), m_settings.minDuration);
+    m_settings.maxDuration = qMax(m_settings.minDuration, m_settings.maxDuration);
+    m_settings.maxBytes = qMax(qint64(0), m_settings.maxBytes);
+    m_limit = computeLimit();
+    m_target = qBound(m_settings.minDuration, m_target, m_limit);
+}
+
+void BufferController::reset()
+{
+    m_stableTime = 0;
+    m_lastBufferedBytes = 0;
+    m_bytesPerMs = 0.0;
+    m_throughputRatio = 1.0;
+    m_decodeStalls = 0;
+    m_limit = computeLimit();
+    m_target = m_settings.minDuration;
+}
+
+bool BufferController::stalled(const qint64 bufferedDuration)
+{
+    m_stableTime = 0;
+    if (bufferedDuration >= qRound64(m_limit * kFullBuffer)) {
+        ++m_decodeStalls;
+        return false;
+    }
+    return setTarget(qMax(m_target * 2, qint64(100)));
+}
+
+bool BufferController::update(const Sample &sample)
+{
+    if (sample.elapsed <= 0) {
+        return false;
+    }
+    if ((sample.bufferedDuration > 0) && (sample.bufferedBytes > 0)) {
+        const qreal bytesPerMs = static_cast<qreal>(sample.bufferedBytes) / static_cast<qreal>(sample.bufferedDuration);
+        m_bytesPerMs = (m_bytesPerMs > 0.0) ? (m_bytesPerMs * (1.0 - kSampleWeight) + bytesPerMs * kSampleWeight) : bytesPerMs;
+    }
+    if ((m_bytesPerMs > 0.0) && (sample.played > 0)) {
+        const qreal consumed = m_bytesPerMs * static_cast<qreal>(sample.played);
+        const qreal downloaded = qMax(0.0, static_cast<qreal>(sample.bufferedBytes - m_lastBufferedBytes) + consumed);
+        m_throughputRatio = m_throughputRatio * (1.0 - kSampleWeight) + (downloaded / consumed) * kSampleWeight;
+    }
+    m_lastBufferedBytes = sample.bufferedBytes;
+    bool changed = false;
+    const qint64 limit = computeLimit();
+    if (limit != m_limit) {
+        m_limit = limit;
+        m_target = qMin(m_target, m_limit);
+        changed = true;
+    }
+    if (sample.played <= 0) {
+        // Paused or stalled, nothing to learn from.
+        return changed;
+    }
+    m_stableTime += sample.elapsed;
+    if (m_throughputRatio < kGrowRatio) {
+        m_stableTime = 0;
+        changed |= setTarget(m_target + qMax(m_target / 4, qint64(100)));
+    } else if ((m_stableTime >= kStablePeriod) && (m_throughputRatio >= kShrinkRatio)) {
+        m_stableTime = 0;
+        changed |= setTarget(m_target - m_target / 10);
+    }
+    return changed;
+}
+
+qint64 BufferController::target() const
+{
+    return m_target;
+}
+
+qint64 BufferController::limit() const
+{
+    return m_limit;
+}
+
+qreal BufferController::throughputRatio() const
+{
+    return m_throughputRatio;
+}
+
+int BufferController::decodeStalls() const
+{
+    return m_decodeStalls;
+}
+
+bool BufferController::setTarget(const qint64 value)
+{
+    const qint64 target = qBound(m_settings.minDuration, value, m_limit);
+    if (target == m_target) {
+        return false;
+    }
+    m_target = target;
+    return true;
+}
+
+qint64 BufferController::computeLimit() const
+{
+    qint64 limit = m_settings.maxDuration;
+    if ((m_settings.maxBytes > 0) && (m_bytesPerMs > 0.0)) {
+        limit = qMin(limit, qint64(static_cast<qreal>(m_settings.maxBytes) / m_bytesPerMs));
+    }
+    return qMax(limit, m_settings.minDuration);
+}
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,102 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Decides how much MDK should buffer, from the stalls the player runs into
+// and from periodic samples of the buffer. Playback resumes after a stall
+// once "target" milliseconds are buffered and the buffer never grows past
+// "limit" milliseconds:
+// - A stall with a buffer that wasn't full doubles the target, a stall with
+//   a full buffer means decoding can't keep up and more buffering wouldn't
+//   help, so it's only counted.
+// - If the download rate falls behind the consumption rate of the media the
+//   target grows before the next stall happens.
+// - After a stable period with a download rate well above the consumption
+//   rate the target shrinks again, to keep the latency low.
+// - The limit is the maximum duration, lowered to what maxBytes can hold at
+//   the current bit rate.
+// It has no dependencies on MDK or on timers, the caller feeds it samples,
+// so it can be driven by recorded or simulated network conditions.
+class MDKPLAYER_API BufferController
+{
+public:
+    struct Settings
+    {
+        qint64 minDuration = 500;
+        qint64 maxDuration = 10000;
+        // 0 means no limit.
+        qint64 maxBytes = 0;
+    };
+
+    struct Sample
+    {
+        // Milliseconds since the previous sample.
+        qint64 elapsed = 0;
+        // As reported by MDK.
+        qint64 bufferedDuration = 0;
+        qint64 bufferedBytes = 0;
+        // Playback position advance since the previous sample.
+        qint64 played = 0;
+    };
+
+    BufferController() = default;
+    ~BufferController() = default;
+
+    Settings settings() const;
+    void setSettings(const Settings &value);
+
+    void reset();
+
+    // Both return true if the range has changed.
+    bool stalled(const qint64 bufferedDuration);
+    bool update(const Sample &sample);
+
+    qint64 target() const;
+    qint64 limit() const;
+
+    // Bytes downloaded per byte played, averaged over the last samples.
+    qreal throughputRatio() const;
+    int decodeStalls() const;
+
+private:
+    bool setTarget(const qint64 value);
+    qint64 computeLimit() const;
+
+private:
+    Settings m_settings = {};
+    qint64 m_target = 500;
+    qint64 m_limit = 10000;
+    qint64 m_stableTime = 0;
+    qint64 m_lastBufferedBytes = 0;
+    qreal m_bytesPerMs = 0.0;
+    qreal m_throughputRatio = 1.0;
+    int m_decodeStalls = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,415 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "channelzapper.h"
+#include "mdkplayer.h"
+#include <QtCore/qdebug.h>
+#include <QtQuick/qquickwindow.h>
+#include <utility>
+
+// How often live standby players are checked, in milliseconds.
+static constexpr const int kStandbyCheckInterval = 1000;
+// A paused live channel falls behind, reopen it after this many milliseconds.
+static constexpr const qint64 kLiveStandbyAge = 15000;
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+ChannelZapper::ChannelZapper(QQuickItem *parent) : QQuickItem(parent)
+{
+    startTimer(kStandbyCheckInterval);
+}
+
+ChannelZapper::~ChannelZapper() = default;
+
+QList<QUrl> ChannelZapper::channels() const
+{
+    return m_channels;
+}
+
+void ChannelZapper::setChannels(const QList<QUrl> &value)
+{
+    if (m_channels != value) {
+        const QUrl current = m_channels.value(m_currentIndex);
+        m_channels = value;
+        // The standby players know their channels by index.
+        for (auto &&slot : m_slots) {
+            if (slot.channel >= 0) {
+                slot.channel = m_channels.indexOf(slot.player->url());
+            }
+        }
+        Q_EMIT channelsChanged();
+        const int index = m_channels.indexOf(current);
+        if (index != m_currentIndex) {
+            m_currentIndex = index;
+            Q_EMIT currentIndexChanged();
+        }
+        rebalance();
+        qDebug() << "Channel zapper:" << m_channels.size() << "channels.";
+        if ((m_pendingIndex >= 0) && (m_pendingIndex < m_channels.size())) {
+            const int pending = m_pendingIndex;
+            m_pendingIndex = -1;
+            zap(pending);
+        }
+    }
+}
+
+int ChannelZapper::currentIndex() const
+{
+    return m_currentIndex;
+}
+
+QList<int> ChannelZapper::favorites() const
+{
+    return m_favorites;
+}
+
+void ChannelZapper::setFavorites(const QList<int> &value)
+{
+    if (m_favorites != value) {
+        m_favorites = value;
+        rebalance();
+        Q_EMIT favoritesChanged();
+        qDebug() << "Channel zapper: favorites -->" << m_favorites;
+    }
+}
+
+int ChannelZapper::standbyCount() const
+{
+    return m_standbyCount;
+}
+
+void ChannelZapper::setStandbyCount(const int value)
+{
+    if (m_standbyCount != value) {
+        m_standbyCount = qMax(0, value);
+        rebalance();
+        Q_EMIT standbyCountChanged();
+        qDebug() << "Channel zapper: standby count -->" << m_standbyCount;
+    }
+}
+
+qint64 ChannelZapper::standbyMaxBufferDuration() const
+{
+    return m_standbyMaxBufferDuration;
+}
+
+void ChannelZapper::setStandbyMaxBufferDuration(const qint64 value)
+{
+    if (m_standbyMaxBufferDuration != value) {
+        m_standbyMaxBufferDuration = value;
+        for (int i = 1; i < m_slots.size(); ++i) {
+            m_slots.at(i).player->setMaxBufferDuration(m_standbyMaxBufferDuration);
+        }
+        Q_EMIT standbyBufferChanged();
+    }
+}
+
+qint64 ChannelZapper::standbyMaxBufferBytes() const
+{
+    return m_standbyMaxBufferBytes;
+}
+
+void ChannelZapper::setStandbyMaxBufferBytes(const qint64 value)
+{
+    if (m_standbyMaxBufferBytes != value) {
+        m_standbyMaxBufferBytes = value;
+        for (int i = 1; i < m_slots.size(); ++i) {
+            m_slots.at(i).player->setMaxBufferBytes(m_standbyMaxBufferBytes);
+        }
+        Q_EMIT standbyBufferChanged();
+    }
+}
+
+MDKPlayer *ChannelZapper::player() const
+{
+    return m_slots.isEmpty() ? nullptr : m_slots.constFirst().player;
+}
+
+qint64 ChannelZapper::zapLatency() const
+{
+    return m_zapLatency;
+}
+
+int ChannelZapper::zapCount() const
+{
+    return m_zapCount;
+}
+
+int ChannelZapper::standbyHits() const
+{
+    return m_standbyHits;
+}
+
+void ChannelZapper::zap(const int index)
+{
+    if (index >= m_channels.size()) {
+        // QML may set currentIndex before channels.
+        m_pendingIndex = index;
+        return;
+    }
+    if ((index < 0) || (index == m_currentIndex)) {
+        return;
+    }
+    m_zapTimer.start();
+    ++m_zapCount;
+    if ((m_currentIndex >= 0) && !m_slots.isEmpty()) {
+        // Whatever the application changed since the last zap.
+        m_screenSettings = settingsOf(m_slots.constFirst().player);
+    }
+    int slot = -1;
+    for (int i = 1; i < m_slots.size(); ++i) {
+        if ((m_slots.at(i).channel == index) && !m_slots.at(i).player->isStopped()) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot > 0) {
+        ++m_standbyHits;
+        const int previous = m_currentIndex;
+        std::swap(m_slots[0], m_slots[slot]);
+        activate(0);
+        // Kept for zapping back, unless rebalance() needs it elsewhere.
+        standBy(slot, previous);
+    } else {
+        if (m_slots.isEmpty()) {
+            m_slots.append({});
+            m_slots.first().player = createPlayer();
+        }
+        m_slots.first().channel = index;
+        m_slots.first().player->preload(m_channels.at(index));
+        activate(0);
+    }
+    m_currentIndex = index;
+    const auto current = player();
+    m_zapFrames = current->m_totalRenderedFrames;
+    if (window()) {
+        connect(window(), &QQuickWindow::frameSwapped, this, &ChannelZapper::handleFrameSwapped,
+                static_cast<Qt::ConnectionType>(Qt::QueuedConnection | Qt::UniqueConnection));
+    }
+    Q_EMIT currentIndexChanged();
+    Q_EMIT playerChanged();
+    qDebug() << "Zap -->" << index << ((slot > 0) ? "from standby" : "cold");
+    rebalance();
+}
+
+void ChannelZapper::next()
+{
+    if (!m_channels.isEmpty()) {
+        zap((m_currentIndex + 1) % m_channels.size());
+    }
+}
+
+void ChannelZapper::previous()
+{
+    if (!m_channels.isEmpty()) {
+        zap((qMax(m_currentIndex, 0) + m_channels.size() - 1) % m_channels.size());
+    }
+}
+
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+void ChannelZapper::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+#else
+void ChannelZapper::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+#endif
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+#else
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+#endif
+    if (newGeometry.size() != oldGeometry.size()) {
+        for (auto &&slot : qAsConst(m_slots)) {
+            slot.player->setSize(newGeometry.size());
+        }
+    }
+}
+
+void ChannelZapper::timerEvent(QTimerEvent *event)
+{
+    QQuickItem::timerEvent(event);
+    for (int i = 1; i < m_slots.size(); ++i) {
+        const auto &slot = m_slots.at(i);
+        // Live streams have no duration.
+        if ((slot.channel >= 0) && (slot.player->duration() <= 0) && slot.opened.isValid()
+                && slot.opened.hasExpired(kLiveStandbyAge)) {
+            standBy(i, slot.channel);
+        }
+    }
+}
+
+void ChannelZapper::handleFrameSwapped()
+{
+    const auto current = player();
+    if (!m_zapTimer.isValid() || !current || (current->m_totalRenderedFrames == m_zapFrames)) {
+        return;
+    }
+    m_zapLatency = m_zapTimer.elapsed();
+    m_zapTimer.invalidate();
+    if (window()) {
+        disconnect(window(), &QQuickWindow::frameSwapped, this, &ChannelZapper::handleFrameSwapped);
+    }
+    Q_EMIT zapStatisticsChanged();
+    qDebug() << "Zap latency -->" << m_zapLatency << "ms";
+}
+
+ChannelZapper::Settings ChannelZapper::settingsOf(const MDKPlayer *player)
+{
+    Settings settings = {};
+    settings.hiddenBehavior = static_cast<int>(player->hiddenBehavior());
+    settings.adaptiveBuffering = player->adaptiveBuffering();
+    settings.maxBufferDuration = player->maxBufferDuration();
+    settings.maxBufferBytes = player->maxBufferBytes();
+    return settings;
+}
+
+void ChannelZapper::applySettings(MDKPlayer *player, const ChannelZapper::Settings &value)
+{
+    player->setHiddenBehavior(static_cast<MDKPlayer::HiddenBehavior>(value.hiddenBehavior));
+    player->setAdaptiveBuffering(value.adaptiveBuffering);
+    player->setMaxBufferDuration(value.maxBufferDuration);
+    player->setMaxBufferBytes(value.maxBufferBytes);
+}
+
+MDKPlayer *ChannelZapper::createPlayer()
+{
+    const auto player = new MDKPlayer(this);
+    player->setSize(size());
+    if (!m_hasScreenSettings) {
+        // Until the application changes something, what a player does by default.
+        m_screenSettings = settingsOf(player);
+        m_hasScreenSettings = true;
+    }
+    return player;
+}
+
+void ChannelZapper::activate(const int slot)
+{
+    const auto player = m_slots.at(slot).player;
+    applySettings(player, m_screenSettings);
+    player->setZ(1.0);
+    player->setOpacity(1.0);
+    player->play();
+}
+
+// Opens the channel paused on its first frame. The player stays visible to
+// the scenegraph, only transparent, so the frame is rendered into its
+// texture and is there the moment it's shown.
+void ChannelZapper::standBy(const int slot, const int channel)
+{
+    auto &standby = m_slots[slot];
+    const auto player = standby.player;
+    player->setOpacity(0.0);
+    player->setZ(0.0);
+    player->pause();
+    standby.channel = channel;
+    if (channel < 0) {
+        player->stop();
+        return;
+    }
+    // Paused, nothing but the first frame is decoded anyway.
+    player->setHiddenBehavior(MDKPlayer::HiddenBehavior::KeepDecoding);
+    player->setAdaptiveBuffering(true);
+    player->setMaxBufferDuration(m_standbyMaxBufferDuration);
+    player->setMaxBufferBytes(m_standbyMaxBufferBytes);
+    const QUrl url = m_channels.value(channel);
+    // A live stream has moved on while we were watching something else,
+    // reopening it gets back to the live edge.
+    if ((player->url() != url) || player->isStopped() || (player->duration() <= 0)) {
+        player->preload(url);
+        standby.opened.start();
+    }
+}
+
+void ChannelZapper::rebalance()
+{
+    const QList<int> wanted = standbyChannels();
+    QList<int> missing = {};
+    for (auto &&channel : qAsConst(wanted)) {
+        bool covered = false;
+        for (int i = 1; i < m_slots.size(); ++i) {
+            if (m_slots.at(i).channel == channel) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered) {
+            missing.append(channel);
+        }
+    }
+    // Standby players that aren't wanted any more take the missing channels.
+    for (int i = 1; i < m_slots.size(); ++i) {
+        if (wanted.contains(m_slots.at(i).channel)) {
+            continue;
+        }
+        if (missing.isEmpty()) {
+            standBy(i, -1);
+        } else {
+            standBy(i, missing.takeFirst());
+        }
+    }
+    while (!missing.isEmpty() && (m_slots.size() <= m_standbyCount)) {
+        if (m_slots.isEmpty()) {
+            // Nothing on screen yet, slot 0 is reserved for it.
+            m_slots.append({});
+            m_slots.first().player = createPlayer();
+        }
+        m_slots.append({});
+        m_slots.last().player = createPlayer();
+        standBy(m_slots.size() - 1, missing.takeFirst());
+    }
+    // Fewer standby players wanted.
+    while (m_slots.size() > (m_standbyCount + 1)) {
+        const auto player = m_slots.takeLast().player;
+        player->stop();
+        player->deleteLater();
+    }
+}
+
+QList<int> ChannelZapper::standbyChannels() const
+{
+    QList<int> result = {};
+    const int count = m_channels.size();
+    if ((m_standbyCount <= 0) || (count <= 1)) {
+        return result;
+    }
+    const int current = qMax(m_currentIndex, 0);
+    const auto add = [&result, count, this](const int channel) {
+        if ((channel >= 0) && (channel < count) && (channel != m_currentIndex) && !result.contains(channel)
+                && (result.size() < m_standbyCount)) {
+            result.append(channel);
+        }
+    };
+    add((current + 1) % count);
+    add((current + count - 1) % count);
+    for (auto &&favorite : qAsConst(m_favorites)) {
+        add(favorite);
+    }
+    for (int distance = 2; (distance <= (count / 2)) && (result.size() < m_standbyCount); ++distance) {
+        add((current + distance) % count);
+        add((current + count - distance) % count);
+    }
+    return result;
+}
+
+MDKPLAYER_END_NAMESPACE
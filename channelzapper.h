@@ -0,0 +1,163 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qurl.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtQuick/qquickitem.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class MDKPlayer;
+
+// Switches between channels without the usual open, buffer and wait for a
+// key frame. Besides the player on screen it keeps standbyCount players
+// opened and paused on their first frame, for the channels most likely to
+// be picked next: the next and the previous one, the favorites and then
+// further neighbours. Zapping to one of them only makes it visible and
+// resumes it, its frame is already in its texture. The player that was on
+// screen stays on standby for zapping back. Standby players buffer at most
+// standbyMaxBufferDuration and standbyMaxBufferBytes, live channels are
+// reopened from time to time so they don't fall behind.
+class MDKPLAYER_API ChannelZapper : public QQuickItem
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(ChannelZapper)
+
+    Q_PROPERTY(QList<QUrl> channels READ channels WRITE setChannels NOTIFY channelsChanged)
+    Q_PROPERTY(int currentIndex READ currentIndex WRITE zap NOTIFY currentIndexChanged)
+    Q_PROPERTY(QList<int> favorites READ favorites WRITE setFavorites NOTIFY favoritesChanged)
+    Q_PROPERTY(int standbyCount READ standbyCount WRITE setStandbyCount NOTIFY standbyCountChanged)
+    Q_PROPERTY(qint64 standbyMaxBufferDuration READ standbyMaxBufferDuration WRITE setStandbyMaxBufferDuration NOTIFY standbyBufferChanged)
+    Q_PROPERTY(qint64 standbyMaxBufferBytes READ standbyMaxBufferBytes WRITE setStandbyMaxBufferBytes NOTIFY standbyBufferChanged)
+    Q_PROPERTY(MDKPlayer *player READ player NOTIFY playerChanged)
+    Q_PROPERTY(qint64 zapLatency READ zapLatency NOTIFY zapStatisticsChanged)
+    Q_PROPERTY(int zapCount READ zapCount NOTIFY zapStatisticsChanged)
+    Q_PROPERTY(int standbyHits READ standbyHits NOTIFY zapStatisticsChanged)
+
+public:
+    explicit ChannelZapper(QQuickItem *parent = nullptr);
+    ~ChannelZapper() override;
+
+    QList<QUrl> channels() const;
+    void setChannels(const QList<QUrl> &value);
+
+    int currentIndex() const;
+
+    // Indexes into channels, kept on standby before the further neighbours.
+    QList<int> favorites() const;
+    void setFavorites(const QList<int> &value);
+
+    // How many players wait besides the one on screen, 0 disables standby.
+    int standbyCount() const;
+    void setStandbyCount(const int value);
+
+    qint64 standbyMaxBufferDuration() const;
+    void setStandbyMaxBufferDuration(const qint64 value);
+
+    qint64 standbyMaxBufferBytes() const;
+    void setStandbyMaxBufferBytes(const qint64 value);
+
+    // The player on screen, e.g. for its volume.
+    MDKPlayer *player() const;
+
+    // Milliseconds from the last zap to the first new frame on screen.
+    qint64 zapLatency() const;
+    int zapCount() const;
+    // Zaps that found their channel on standby.
+    int standbyHits() const;
+
+public Q_SLOTS:
+    void zap(const int index);
+    void next();
+    void previous();
+
+Q_SIGNALS:
+    void channelsChanged();
+    void currentIndexChanged();
+    void favoritesChanged();
+    void standbyCountChanged();
+    void standbyBufferChanged();
+    void playerChanged();
+    void zapStatisticsChanged();
+
+protected:
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+#else
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+#endif
+    void timerEvent(QTimerEvent *event) override;
+
+private Q_SLOTS:
+    void handleFrameSwapped();
+
+private:
+    // What the application set on the player on screen, handed on to the
+    // next one, standby players run with their own limits.
+    struct Settings
+    {
+        int hiddenBehavior = 0;
+        bool adaptiveBuffering = false;
+        qint64 maxBufferDuration = 0;
+        qint64 maxBufferBytes = 0;
+    };
+
+    struct Standby
+    {
+        MDKPlayer *player = nullptr;
+        int channel = -1;
+        QElapsedTimer opened;
+    };
+
+    static Settings settingsOf(const MDKPlayer *player);
+    static void applySettings(MDKPlayer *player, const Settings &value);
+    MDKPlayer *createPlayer();
+    void activate(const int slot);
+    void standBy(const int slot, const int channel);
+    void rebalance();
+    QList<int> standbyChannels() const;
+
+private:
+    QList<QUrl> m_channels = {};
+    QList<int> m_favorites = {};
+    int m_currentIndex = -1;
+    int m_pendingIndex = -1;
+    int m_standbyCount = 2;
+    qint64 m_standbyMaxBufferDuration = 1000;
+    qint64 m_standbyMaxBufferBytes = 4 * 1024 * 1024;
+    // The first one is on screen.
+    QList<Standby> m_slots = {};
+    Settings m_screenSettings = {};
+    bool m_hasScreenSettings = false;
+    QElapsedTimer m_zapTimer;
+    quint64 m_zapFrames = 0;
+    qint64 m_zapLatency = 0;
+    int m_zapCount = 0;
+    int m_standbyHits = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,313 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "clipexporter.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <mdk/Player.h>
+#include <mdk/VideoFrame.h>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Nothing is rendered and the audio is muted, so the clock is the only thing
+// that paces the demuxer. Let it run much faster than real time.
+static constexpr const float kClipExportPlaybackRate = 32.0f;
+
+// MDK's public API has no demux-only mode, the recorder is fed by a playing
+// player. The recorder copies the demuxed packets, so the video decoder only
+// has to keep the clock going: software decoding (no hardware context to
+// set up) of the key frames alone.
+static const std::vector<std::string> kClipExportVideoDecoders = {"FFmpeg:skip_frame=nokey"};
+
+static inline QString urlToPath(const QUrl &value)
+{
+    return (value.isLocalFile() ? QDir::toNativeSeparators(value.toLocalFile()) : value.url());
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+ClipExportJob::ClipExportJob(ClipExporter *exporter, const QUrl &source, const qint64 start, const qint64 end,
+                             const QUrl &destination, const QString &format)
+    : QObject(exporter), m_exporter(exporter), m_source(source), m_destination(destination),
+      m_startTime(qMax(qint64(0), start)), m_endTime(end), m_format(format)
+{
+    m_position = m_startTime;
+}
+
+ClipExportJob::~ClipExportJob()
+{
+    if (m_player) {
+        m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>(nullptr);
+        m_player->record();
+        m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+        m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    }
+}
+
+QUrl ClipExportJob::source() const
+{
+    return m_source;
+}
+
+QUrl ClipExportJob::destination() const
+{
+    return m_destination;
+}
+
+qint64 ClipExportJob::startTime() const
+{
+    return m_startTime;
+}
+
+qint64 ClipExportJob::endTime() const
+{
+    return m_endTime;
+}
+
+QString ClipExportJob::format() const
+{
+    return m_format;
+}
+
+ClipExportJob::State ClipExportJob::state() const
+{
+    return m_state;
+}
+
+qreal ClipExportJob::progress() const
+{
+    if (m_state == State::Finished) {
+        return 1.0;
+    }
+    if (m_endTime <= m_startTime) {
+        return 0.0;
+    }
+    return qBound(0.0, static_cast<qreal>(m_position - m_startTime) / static_cast<qreal>(m_endTime - m_startTime), 1.0);
+}
+
+qreal ClipExportJob::speed() const
+{
+    if (!m_elapsed.isValid() || (m_elapsed.elapsed() <= 0)) {
+        return 0.0;
+    }
+    return (static_cast<qreal>(m_position - m_startTime) / static_cast<qreal>(m_elapsed.elapsed()));
+}
+
+qint64 ClipExportJob::bytesWritten() const
+{
+    return QFileInfo(urlToPath(m_destination)).size();
+}
+
+void ClipExportJob::cancel()
+{
+    if ((m_state == State::Queued) || (m_state == State::Running)) {
+        finish(State::Cancelled);
+    }
+}
+
+void ClipExportJob::run(const QSharedPointer<mdk::Player> &player)
+{
+    m_player = player;
+    m_state = State::Running;
+    Q_EMIT stateChanged();
+    m_player->setMute(true);
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Subtitle, std::set<int>{});
+    m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, kClipExportVideoDecoders);
+    m_player->setMedia(qUtf8Printable(urlToPath(m_source)));
+    // The recorder starts when the playback starts.
+    m_player->record(qUtf8Printable(urlToPath(m_destination)), m_format.isEmpty() ? nullptr : qUtf8Printable(m_format));
+    m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>([this](MDK_NS_PREPEND(VideoFrame) &frame, int track) {
+        Q_UNUSED(track);
+        // Key frames only, the position check in update() catches the rest.
+        if (!frame || (qRound64(frame.timestamp() * 1000.0) >= m_endTime)) {
+            m_reachedEnd.storeRelease(1);
+        }
+        return 0;
+    });
+    // Start at the key frame preceding "start", a stream copy can't start anywhere else.
+    m_player->prepare(m_startTime, nullptr, MDK_NS_PREPEND(SeekFlag)::FromStart | MDK_NS_PREPEND(SeekFlag)::KeyFrame);
+    m_player->setPlaybackRate(kClipExportPlaybackRate);
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
+    m_elapsed.start();
+    m_timerId = startTimer(50);
+    qDebug() << "Exporting clip" << m_source << '[' << m_startTime << ',' << m_endTime << "] -->" << m_destination;
+}
+
+void ClipExportJob::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+    update();
+}
+
+void ClipExportJob::update()
+{
+    if (!m_player || (m_state != State::Running)) {
+        return;
+    }
+    m_position = qMax(m_position, m_player->position());
+    const bool stopped = (m_player->state() == MDK_NS_PREPEND(PlaybackState)::Stopped);
+    const bool ended = MDK_NS_PREPEND(test_flag)(m_player->mediaStatus() & MDK_NS_PREPEND(MediaStatus)::End);
+    if (m_reachedEnd.loadAcquire() || (m_position >= m_endTime) || ended) {
+        m_position = qMin(m_position, m_endTime);
+        finish(State::Finished);
+        return;
+    }
+    if (stopped || MDK_NS_PREPEND(test_flag)(m_player->mediaStatus() & MDK_NS_PREPEND(MediaStatus)::Invalid)) {
+        finish(State::Failed);
+        return;
+    }
+    Q_EMIT progressChanged();
+}
+
+void ClipExportJob::finish(const State state)
+{
+    if (m_timerId != 0) {
+        killTimer(m_timerId);
+        m_timerId = 0;
+    }
+    const auto player = std::exchange(m_player, {});
+    if (player) {
+        player->onFrame<MDK_NS_PREPEND(VideoFrame)>(nullptr);
+        // Stop the recorder first so that the file is finalized.
+        player->record();
+        player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+        player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    }
+    if (state == State::Cancelled) {
+        QFile::remove(urlToPath(m_destination));
+    }
+    m_state = state;
+    Q_EMIT stateChanged();
+    Q_EMIT progressChanged();
+    qDebug() << "Clip export" << m_destination << "-->" << m_state << "at" << speed() << "x real time.";
+    Q_EMIT finished();
+    if (m_exporter) {
+        if (player) {
+            m_exporter->releasePlayer(player);
+        }
+        m_exporter->jobFinished(this);
+    }
+}
+
+ClipExporter::ClipExporter(QObject *parent) : QObject(parent)
+{
+}
+
+ClipExporter::~ClipExporter()
+{
+    // Jobs are our children, make sure none of them calls back into us.
+    for (auto &&job : qAsConst(m_running)) {
+        job->m_exporter.clear();
+    }
+}
+
+ClipExporter *ClipExporter::instance()
+{
+    static ClipExporter exporter;
+    return &exporter;
+}
+
+int ClipExporter::maxConcurrentJobs() const
+{
+    return m_maxConcurrentJobs;
+}
+
+void ClipExporter::setMaxConcurrentJobs(const int value)
+{
+    const int val = qMax(1, value);
+    if (m_maxConcurrentJobs != val) {
+        m_maxConcurrentJobs = val;
+        while (m_idlePlayers.count() > m_maxConcurrentJobs) {
+            m_idlePlayers.removeLast();
+        }
+        Q_EMIT maxConcurrentJobsChanged();
+        schedule();
+    }
+}
+
+int ClipExporter::pendingJobs() const
+{
+    return m_queue.count();
+}
+
+int ClipExporter::runningJobs() const
+{
+    return m_running.count();
+}
+
+ClipExportJob *ClipExporter::exportClip(const QUrl &source, const qint64 start, const qint64 end,
+                                        const QUrl &destination, const QString &format)
+{
+    if (!source.isValid() || !destination.isValid() || !destination.isLocalFile() || (end <= start)) {
+        qWarning() << "Invalid clip export request:" << source << start << end << destination;
+        return nullptr;
+    }
+    const auto job = new ClipExportJob(this, source, start, end, destination, format);
+    m_queue.append(job);
+    Q_EMIT jobsChanged();
+    schedule();
+    return job;
+}
+
+void ClipExporter::schedule()
+{
+    while (!m_queue.isEmpty() && (m_running.count() < m_maxConcurrentJobs)) {
+        const auto job = m_queue.takeFirst();
+        m_running.append(job);
+        job->run(acquirePlayer());
+    }
+    Q_EMIT jobsChanged();
+}
+
+void ClipExporter::jobFinished(ClipExportJob *job)
+{
+    // Cancelled before it was started.
+    m_queue.removeOne(job);
+    m_running.removeOne(job);
+    schedule();
+}
+
+QSharedPointer<mdk::Player> ClipExporter::acquirePlayer()
+{
+    if (!m_idlePlayers.isEmpty()) {
+        return m_idlePlayers.takeLast();
+    }
+    return QSharedPointer<mdk::Player>(new MDK_NS_PREPEND(Player));
+}
+
+void ClipExporter::releasePlayer(const QSharedPointer<mdk::Player> &player)
+{
+    if (!player || (m_idlePlayers.count() >= m_maxConcurrentJobs)) {
+        return;
+    }
+    player->setMedia(nullptr);
+    player->setPlaybackRate(1.0f);
+    m_idlePlayers.append(player);
+}
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qatomic.h>
+
+namespace mdk
+{
+
+class Player;
+
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class ClipExporter;
+
+// A single "cut [start, end] out of source" job. Packets are copied from
+// the key frame preceding "start" up to "end" without re-encoding. The
+// source is still played by a headless player, but only its key frames are
+// decoded, in software.
+class MDKPLAYER_API ClipExportJob : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(ClipExportJob)
+    Q_CLASSINFO("RegisterEnumClassesUnscoped", "false")
+
+    Q_PROPERTY(QUrl source READ source CONSTANT)
+    Q_PROPERTY(QUrl destination READ destination CONSTANT)
+    Q_PROPERTY(qint64 startTime READ startTime CONSTANT)
+    Q_PROPERTY(qint64 endTime READ endTime CONSTANT)
+    Q_PROPERTY(QString format READ format CONSTANT)
+    Q_PROPERTY(State state READ state NOTIFY stateChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+    Q_PROPERTY(qreal speed READ speed NOTIFY progressChanged)
+    Q_PROPERTY(qint64 bytesWritten READ bytesWritten NOTIFY progressChanged)
+
+    friend class ClipExporter;
+
+public:
+    enum class State : int
+    {
+        Queued = 0,
+        Running,
+        Finished,
+        Failed,
+        Cancelled
+    };
+    Q_ENUM(State)
+
+    ~ClipExportJob() override;
+
+    QUrl source() const;
+    QUrl destination() const;
+    qint64 startTime() const;
+    qint64 endTime() const;
+    QString format() const;
+    State state() const;
+    qreal progress() const;
+    // Media time processed per wall clock time, 1.0 means real time.
+    qreal speed() const;
+    qint64 bytesWritten() const;
+
+public Q_SLOTS:
+    void cancel();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    explicit ClipExportJob(ClipExporter *exporter, const QUrl &source, const qint64 start, const qint64 end,
+                           const QUrl &destination, const QString &format);
+
+    void run(const QSharedPointer<mdk::Player> &player);
+    void update();
+    void finish(const State state);
+
+Q_SIGNALS:
+    void stateChanged();
+    void progressChanged();
+    void finished();
+
+private:
+    QPointer<ClipExporter> m_exporter;
+    QUrl m_source = {};
+    QUrl m_destination = {};
+    qint64 m_startTime = 0;
+    qint64 m_endTime = 0;
+    QString m_format = {};
+    State m_state = State::Queued;
+    qint64 m_position = 0;
+    QElapsedTimer m_elapsed;
+    QSharedPointer<mdk::Player> m_player;
+    // Set from MDK's threads.
+    QAtomicInt m_reachedEnd = 0;
+    int m_timerId = 0;
+};
+
+// Runs clip export jobs on a bounded pool of headless MDK players. Jobs
+// are started in the order they were queued.
+class MDKPLAYER_API ClipExporter : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(ClipExporter)
+
+    Q_PROPERTY(int maxConcurrentJobs READ maxConcurrentJobs WRITE setMaxConcurrentJobs NOTIFY maxConcurrentJobsChanged)
+    Q_PROPERTY(int pendingJobs READ pendingJobs NOTIFY jobsChanged)
+    Q_PROPERTY(int runningJobs READ runningJobs NOTIFY jobsChanged)
+
+    friend class ClipExportJob;
+
+public:
+    explicit ClipExporter(QObject *parent = nullptr);
+    ~ClipExporter() override;
+
+    static ClipExporter *instance();
+
+    int maxConcurrentJobs() const;
+    void setMaxConcurrentJobs(const int value);
+
+    int pendingJobs() const;
+    int runningJobs() const;
+
+    // The exporter owns the returned job, it's deleted together with it.
+    Q_INVOKABLE ClipExportJob *exportClip(const QUrl &source, const qint64 start, const qint64 end,
+                                          const QUrl &destination, const QString &format = {});
+
+private:
+    void schedule();
+    void jobFinished(ClipExportJob *job);
+    QSharedPointer<mdk::Player> acquirePlayer();
+    void releasePlayer(const QSharedPointer<mdk::Player> &player);
+
+Q_SIGNALS:
+    void maxConcurrentJobsChanged();
+    void jobsChanged();
+
+private:
+    int m_maxConcurrentJobs = 2;
+    QList<ClipExportJob *> m_queue = {};
+    QList<ClipExportJob *> m_running = {};
+    QList<QSharedPointer<mdk::Player>> m_idlePlayers = {};
+};
+
+MDKPLAYER_END_NAMESPACE
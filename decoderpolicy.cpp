@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "decoderpolicy.h"
+#include <QtCore/qdebug.h>
+
+static inline QStringList toStringList(const QVariant &value)
+{
+    QStringList list = {};
+    if (value.canConvert<QVariantList>() && (value.userType() != QMetaType::QString)) {
+        const QVariantList values = value.toList();
+        for (auto &&v : qAsConst(values)) {
+            list.append(v.toString().toLower());
+        }
+    } else if (value.isValid()) {
+        list.append(value.toString().toLower());
+    }
+    return list;
+}
+
+static inline QList<int> toIntList(const QVariant &value)
+{
+    QList<int> list = {};
+    if (value.canConvert<QVariantList>() && (value.userType() != QMetaType::QString)) {
+        const QVariantList values = value.toList();
+        for (auto &&v : qAsConst(values)) {
+            list.append(v.toInt());
+        }
+    } else if (value.isValid()) {
+        list.append(value.toInt());
+    }
+    return list;
+}
+
+template<typename T>
+static inline bool inRange(const T value, const T min, const T max)
+{
+    return (((min <= 0) || (value >= min)) && ((max <= 0) || (value <= max)));
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+DecoderPolicy DecoderPolicy::fromVariant(const QVariantList &value)
+{
+    DecoderPolicy policy = {};
+    for (auto &&item : qAsConst(value)) {
+        const QVariantMap map = item.toMap();
+        Rule rule = {};
+        rule.codecs = toStringList(map.value(QStringLiteral("codec")));
+        rule.profiles = toIntList(map.value(QStringLiteral("profile")));
+        rule.minWidth = map.value(QStringLiteral("minWidth")).toInt();
+        rule.maxWidth = map.value(QStringLiteral("maxWidth")).toInt();
+        rule.minHeight = map.value(QStringLiteral("minHeight")).toInt();
+        rule.maxHeight = map.value(QStringLiteral("maxHeight")).toInt();
+        rule.minFrameRate = map.value(QStringLiteral("minFrameRate")).toReal();
+        rule.maxFrameRate = map.value(QStringLiteral("maxFrameRate")).toReal();
+        rule.minBitDepth = map.value(QStringLiteral("minBitDepth")).toInt();
+        rule.maxBitDepth = map.value(QStringLiteral("maxBitDepth")).toInt();
+        const QVariantList decoders = map.value(QStringLiteral("decoders")).toList();
+        for (auto &&decoder : qAsConst(decoders)) {
+            if (decoder.userType() == QMetaType::QString) {
+                rule.decoders.append(decoder.toString());
+            } else {
+                const QVariantMap d = decoder.toMap();
+                const QString name = d.value(QStringLiteral("name")).toString();
+                if (!name.isEmpty()) {
+                    rule.decoders.append(decoderName(name, d.value(QStringLiteral("options")).toMap()));
+                }
+            }
+        }
+        if (rule.decoders.isEmpty()) {
+            qWarning() << "Ignoring a decoder policy rule without decoders:" << map;
+            continue;
+        }
+        policy.m_rules.append(rule);
+    }
+    return policy;
+}
+
+bool DecoderPolicy::isEmpty() const
+{
+    return m_rules.isEmpty();
+}
+
+int DecoderPolicy::match(const MDKPlayer::VideoStreamInfo &stream) const
+{
+    const QString codec = stream.codec.toLower();
+    for (int i = 0; i != m_rules.count(); ++i) {
+        const Rule &rule = m_rules.at(i);
+        if (!rule.codecs.isEmpty() && !rule.codecs.contains(codec)) {
+            continue;
+        }
+        if (!rule.profiles.isEmpty() && !rule.profiles.contains(stream.profile)) {
+            continue;
+        }
+        if (!inRange(stream.width, rule.minWidth, rule.maxWidth)
+                || !inRange(stream.height, rule.minHeight, rule.maxHeight)
+                || !inRange(stream.frameRate, rule.minFrameRate, rule.maxFrameRate)
+                || !inRange(stream.bitDepth, rule.minBitDepth, rule.maxBitDepth)) {
+            continue;
+        }
+        return i;
+    }
+    return -1;
+}
+
+QStringList DecoderPolicy::decoders(const int rule) const
+{
+    if ((rule < 0) || (rule >= m_rules.count())) {
+        return {};
+    }
+    return m_rules.at(rule).decoders;
+}
+
+QString DecoderPolicy::decoderName(const QString &name, const QVariantMap &options)
+{
+    QString result = name;
+    for (auto it = options.constBegin(); it != options.constEnd(); ++it) {
+        result.append(QStringLiteral(":%1=%2").arg(it.key(), it.value().toString()));
+    }
+    return result;
+}
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,77 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer.h"
+#include <QtCore/qvariant.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Maps stream properties to a decoder chain. A policy is a list of rules,
+// the first rule matching the stream wins. In QML:
+//
+//     decoderPolicy: [
+//         { codec: "av1", decoders: [{ name: "dav1d", options: { threads: 8 } }, "FFmpeg"] },
+//         { codec: "hevc", minBitDepth: 10, decoders: ["CUDA", "FFmpeg"] },
+//         { codec: ["h264", "mpeg2video"], maxWidth: 1920,
+//           decoders: [{ name: "FFmpeg", options: { threads: 4, thread_type: "slice" } }] }
+//     ]
+//
+// Supported conditions: codec, profile (a value or a list of them),
+// min/maxWidth, min/maxHeight, min/maxFrameRate and min/maxBitDepth.
+// Decoder options are passed to MDK as "name:key=value:key=value".
+class MDKPLAYER_API DecoderPolicy
+{
+public:
+    struct Rule
+    {
+        QStringList codecs = {};
+        QList<int> profiles = {};
+        int minWidth = 0;
+        int maxWidth = 0;
+        int minHeight = 0;
+        int maxHeight = 0;
+        qreal minFrameRate = 0.0;
+        qreal maxFrameRate = 0.0;
+        int minBitDepth = 0;
+        int maxBitDepth = 0;
+        QStringList decoders = {};
+    };
+
+    static DecoderPolicy fromVariant(const QVariantList &value);
+
+    bool isEmpty() const;
+
+    // Returns the index of the first matching rule, or -1.
+    int match(const MDKPlayer::VideoStreamInfo &stream) const;
+    QStringList decoders(const int rule) const;
+
+    static QString decoderName(const QString &name, const QVariantMap &options);
+
+private:
+    QList<Rule> m_rules = {};
+};
+
+MDKPLAYER_END_NAMESPACE
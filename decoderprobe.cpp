@@ -0,0 +1,376 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "decoderprobe.h"
+#include "mdkplayer.h"
+#include "decodescheduler.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qjsonarray.h>
+#include <QtCore/qjsondocument.h>
+#include <QtCore/qjsonobject.h>
+#include <QtCore/qregularexpression.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qstandardpaths.h>
+#include <mdk/Player.h>
+#include <mdk/VideoFrame.h>
+#include <set>
+#include <algorithm>
+#ifdef Q_OS_WINDOWS
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Frames decoded per decoder and sample, after the first one.
+static constexpr const int kProbeFrames = 240;
+// Give up on a decoder that can't deliver them within this time.
+static constexpr const qint64 kProbeTimeout = 8000;
+static constexpr const float kProbePlaybackRate = 64.0f;
+
+// CPU time consumed by this process so far, in milliseconds. Only a fair
+// measure of the probe because probes run while no player is playing.
+static inline qint64 processCpuTime()
+{
+#ifdef Q_OS_WINDOWS
+    FILETIME creationTime = {}, exitTime = {}, kernelTime = {}, userTime = {};
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+    const auto toMs = [](const FILETIME &ft) -> qint64 {
+        return static_cast<qint64>((static_cast<quint64>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 10000;
+    };
+    return (toMs(kernelTime) + toMs(userTime));
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    const auto toMs = [](const struct timeval &tv) -> qint64 {
+        return (static_cast<qint64>(tv.tv_sec) * 1000) + (tv.tv_usec / 1000);
+    };
+    return (toMs(usage.ru_utime) + toMs(usage.ru_stime));
+#endif
+}
+
+static inline QString urlToPath(const QUrl &value)
+{
+    return (value.isLocalFile() ? QDir::toNativeSeparators(value.toLocalFile()) : value.url());
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+DecoderProbe::DecoderProbe(const QString &filePath, QObject *parent) : QObject(parent), m_filePath(filePath)
+{
+    load();
+}
+
+DecoderProbe::~DecoderProbe()
+{
+    if (m_player) {
+        m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>(nullptr);
+        m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+        m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    }
+}
+
+DecoderProbe *DecoderProbe::instance()
+{
+    static DecoderProbe probe(QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+                                  .filePath(QStringLiteral("mdkplayer_decoders.json")));
+    return &probe;
+}
+
+QString DecoderProbe::streamKey(const QString &codec, const int profile, const int bitDepth)
+{
+    return QStringLiteral("%1/%2/%3").arg(codec.toLower(), QString::number(profile), QString::number(bitDepth));
+}
+
+int DecoderProbe::bitDepth(const QString &pixelFormat)
+{
+    static const QRegularExpression re(QStringLiteral("p(\\d+)(?:le|be)?$"));
+    const QRegularExpressionMatch match = re.match(pixelFormat);
+    return match.hasMatch() ? match.captured(1).toInt() : 8;
+}
+
+bool DecoderProbe::running() const
+{
+    return !m_current.decoder.isEmpty();
+}
+
+DecoderProbe::Results DecoderProbe::results(const QString &key) const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_results.value(key);
+}
+
+QStringList DecoderProbe::rankedDecoders(const QString &key) const
+{
+    Results res = results(key);
+    std::stable_sort(res.begin(), res.end(), [](const Result &lhs, const Result &rhs) {
+        // Prefer the cheaper one if they are about as fast.
+        if (qAbs(lhs.framesPerSecond - rhs.framesPerSecond) < (0.05 * qMax(lhs.framesPerSecond, rhs.framesPerSecond))) {
+            return (lhs.cpuUsage < rhs.cpuUsage);
+        }
+        return (lhs.framesPerSecond > rhs.framesPerSecond);
+    });
+    QStringList list = {};
+    for (auto &&result : qAsConst(res)) {
+        if (result.usable) {
+            list.append(result.decoder);
+        }
+    }
+    return list;
+}
+
+void DecoderProbe::probe(const QList<QUrl> &samples, const QStringList &decoders)
+{
+    const QStringList candidates = decoders.isEmpty() ? MDKPlayer::defaultVideoDecoders() : decoders;
+    for (auto &&sample : qAsConst(samples)) {
+        if (!sample.isValid()) {
+            continue;
+        }
+        for (auto &&decoder : qAsConst(candidates)) {
+            m_tasks.append({sample, decoder});
+        }
+    }
+    if (!running()) {
+        startNext();
+    }
+}
+
+void DecoderProbe::clear()
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_results.clear();
+    }
+    save();
+    Q_EMIT resultsChanged({});
+}
+
+void DecoderProbe::startNext()
+{
+    if (m_tasks.isEmpty()) {
+        m_current = {};
+        m_player.reset();
+        Q_EMIT runningChanged();
+        Q_EMIT finished();
+        return;
+    }
+    const bool wasRunning = running();
+    m_current = m_tasks.takeFirst();
+    m_player.reset();
+    if (m_timerId == 0) {
+        m_timerId = startTimer(20);
+    }
+    if (!wasRunning) {
+        Q_EMIT runningChanged();
+    }
+    // The timer starts it as soon as no player is playing.
+}
+
+void DecoderProbe::startCurrent()
+{
+    m_frames.storeRelease(0);
+    m_failed.storeRelease(0);
+    m_framesAtStart = 0;
+    m_wallStart = -1;
+    m_player.reset(new MDK_NS_PREPEND(Player));
+    m_player->setMute(true);
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Audio, std::set<int>{});
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Subtitle, std::set<int>{});
+    // A single decoder, MDK must not fall back to another one.
+    m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, {m_current.decoder.toStdString()});
+    m_player->onEvent([this](const MDK_NS_PREPEND(MediaEvent) &me) {
+        if ((me.category == "decoder.video") && (me.error < 0)) {
+            m_failed.storeRelease(1);
+        }
+        return false;
+    });
+    m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>([this](MDK_NS_PREPEND(VideoFrame) &frame, int track) {
+        Q_UNUSED(track);
+        if (frame) {
+            m_frames.fetchAndAddOrdered(1);
+        }
+        return 0;
+    });
+    m_player->setMedia(qUtf8Printable(urlToPath(m_current.sample)));
+    m_player->prepare();
+    m_player->setPlaybackRate(kProbePlaybackRate);
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
+    m_elapsed.start();
+}
+
+void DecoderProbe::stopCurrent()
+{
+    m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>(nullptr);
+    m_player->onEvent(nullptr);
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+}
+
+void DecoderProbe::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+    if (!running()) {
+        killTimer(m_timerId);
+        m_timerId = 0;
+        return;
+    }
+    // The CPU time is measured for the whole process, and the probe must not
+    // take the decoders away from real playback either: wait while anybody
+    // plays, and start over if somebody started meanwhile.
+    if (DecodeScheduler::instance()->playingCount() > 0) {
+        if (m_player) {
+            qDebug() << "Decoder probe: playback started, probing" << m_current.decoder << "again later.";
+            stopCurrent();
+            m_player.reset();
+        }
+        return;
+    }
+    if (!m_player) {
+        startCurrent();
+        return;
+    }
+    const int frames = m_frames.loadAcquire();
+    // Don't count opening the decoder, only the steady state matters.
+    if ((m_wallStart < 0) && (frames > 0)) {
+        m_wallStart = m_elapsed.elapsed();
+        m_cpuStart = processCpuTime();
+        m_framesAtStart = frames;
+    }
+    const bool invalid = MDK_NS_PREPEND(test_flag)(m_player->mediaStatus() & MDK_NS_PREPEND(MediaStatus)::Invalid);
+    const bool ended = MDK_NS_PREPEND(test_flag)(m_player->mediaStatus() & MDK_NS_PREPEND(MediaStatus)::End);
+    if (m_failed.loadAcquire() || invalid || ended || ((frames - m_framesAtStart) >= kProbeFrames)
+            || m_elapsed.hasExpired(kProbeTimeout)) {
+        finishCurrent();
+        startNext();
+    }
+}
+
+void DecoderProbe::finishCurrent()
+{
+    const qint64 wall = (m_wallStart < 0) ? 0 : (m_elapsed.elapsed() - m_wallStart);
+    const qint64 cpu = (m_wallStart < 0) ? 0 : (processCpuTime() - m_cpuStart);
+    const int frames = m_frames.loadAcquire() - m_framesAtStart;
+    QString key = {};
+    const auto &info = m_player->mediaInfo();
+    if (!info.video.empty()) {
+        const auto &codec = info.video.front().codec;
+        key = streamKey(QString::fromUtf8(codec.codec), codec.profile, bitDepth(QString::fromUtf8(codec.format_name)));
+    }
+    stopCurrent();
+    if (key.isEmpty()) {
+        qWarning() << "Decoder probe: no video stream in" << m_current.sample;
+        return;
+    }
+    Result result = {};
+    result.decoder = m_current.decoder;
+    result.usable = (!m_failed.loadAcquire() && (frames > 0) && (wall > 0));
+    if (result.usable) {
+        result.framesPerSecond = (frames * 1000.0 / static_cast<qreal>(wall));
+        result.cpuUsage = (static_cast<qreal>(cpu) / static_cast<qreal>(wall));
+    }
+    {
+        const QMutexLocker locker(&m_mutex);
+        Results &list = m_results[key];
+        const auto it = std::find_if(list.begin(), list.end(), [&result](const Result &r) {
+            return (r.decoder == result.decoder);
+        });
+        if (it == list.end()) {
+            list.append(result);
+        } else {
+            *it = result;
+        }
+    }
+    save();
+    qDebug() << "Decoder probe:" << key << result.decoder << (result.usable ? "-->" : "unusable")
+             << result.framesPerSecond << "fps," << result.cpuUsage << "CPU";
+    Q_EMIT resultsChanged(key);
+}
+
+void DecoderProbe::load()
+{
+    QFile file(m_filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        return;
+    }
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    // Results of another MDK version may not apply anymore.
+    if (root.value(QStringLiteral("mdkVersion")).toInt() != MDK_version()) {
+        return;
+    }
+    const QJsonObject streams = root.value(QStringLiteral("streams")).toObject();
+    const QMutexLocker locker(&m_mutex);
+    for (auto it = streams.constBegin(); it != streams.constEnd(); ++it) {
+        Results list = {};
+        const QJsonArray array = it.value().toArray();
+        for (auto &&value : qAsConst(array)) {
+            const QJsonObject obj = value.toObject();
+            Result result = {};
+            result.decoder = obj.value(QStringLiteral("decoder")).toString();
+            result.usable = obj.value(QStringLiteral("usable")).toBool();
+            result.framesPerSecond = obj.value(QStringLiteral("fps")).toDouble();
+            result.cpuUsage = obj.value(QStringLiteral("cpu")).toDouble();
+            if (!result.decoder.isEmpty()) {
+                list.append(result);
+            }
+        }
+        m_results.insert(it.key(), list);
+    }
+}
+
+void DecoderProbe::save() const
+{
+    QJsonObject streams = {};
+    {
+        const QMutexLocker locker(&m_mutex);
+        for (auto it = m_results.constBegin(); it != m_results.constEnd(); ++it) {
+            QJsonArray array = {};
+            for (auto &&result : qAsConst(it.value())) {
+                array.append(QJsonObject{
+                    {QStringLiteral("decoder"), result.decoder},
+                    {QStringLiteral("usable"), result.usable},
+                    {QStringLiteral("fps"), result.framesPerSecond},
+                    {QStringLiteral("cpu"), result.cpuUsage}
+                });
+            }
+            streams.insert(it.key(), array);
+        }
+    }
+    const QJsonObject root = {
+        {QStringLiteral("mdkVersion"), MDK_version()},
+        {QStringLiteral("streams"), streams}
+    };
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QSaveFile file(m_filePath);
+    if (!file.open(QSaveFile::WriteOnly) || (file.write(QJsonDocument(root).toJson()) < 0) || !file.commit()) {
+        qWarning() << "Failed to save the decoder probe results to" << m_filePath;
+    }
+}
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qatomic.h>
+
+namespace mdk
+{
+
+class Player;
+
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Measures how fast every video decoder really is on this machine. Each
+// candidate decoder decodes the beginning of the given sample media on its
+// own (no fallback), the decode rate and the CPU time spent are recorded per
+// codec, profile and bit depth and persisted, so that players can order
+// their decoders by measured data instead of a fixed list. Decoders that
+// aren't available simply fail and are recorded as unusable. Probes only
+// run while no player is playing, so that they neither disturb playback nor
+// count its CPU time.
+class MDKPLAYER_API DecoderProbe : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(DecoderProbe)
+
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+
+public:
+    struct Result
+    {
+        QString decoder = {};
+        bool usable = false;
+        qreal framesPerSecond = 0.0;
+        // CPU time divided by wall time, 1.0 means one core fully loaded.
+        qreal cpuUsage = 0.0;
+    };
+    using Results = QList<Result>;
+
+    explicit DecoderProbe(const QString &filePath, QObject *parent = nullptr);
+    ~DecoderProbe() override;
+
+    static DecoderProbe *instance();
+
+    static QString streamKey(const QString &codec, const int profile, const int bitDepth);
+    // Extracts the bit depth from a pixel format name such as "yuv420p10le".
+    static int bitDepth(const QString &pixelFormat);
+
+    bool running() const;
+
+    Results results(const QString &key) const;
+    // Usable decoders, fastest first. Empty if the stream type was never probed.
+    QStringList rankedDecoders(const QString &key) const;
+
+public Q_SLOTS:
+    // Probes every decoder in "decoders" (the platform defaults if empty)
+    // against every sample. Safe to call while a probe is running already.
+    void probe(const QList<QUrl> &samples, const QStringList &decoders = {});
+    void clear();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void load();
+    void save() const;
+    void startNext();
+    void startCurrent();
+    void stopCurrent();
+    void finishCurrent();
+
+Q_SIGNALS:
+    void runningChanged();
+    void resultsChanged(const QString &param1);
+    void finished();
+
+private:
+    struct Task
+    {
+        QUrl sample = {};
+        QString decoder = {};
+    };
+
+    QString m_filePath = {};
+    mutable QMutex m_mutex;
+    QHash<QString, Results> m_results = {};
+
+    QList<Task> m_tasks = {};
+    Task m_current = {};
+    QSharedPointer<mdk::Player> m_player;
+    QElapsedTimer m_elapsed;
+    qint64 m_cpuStart = 0;
+    qint64 m_wallStart = -1;
+    int m_framesAtStart = 0;
+    int m_timerId = 0;
+    // Written by the decoder thread.
+    QAtomicInt m_frames = 0;
+    QAtomicInt m_failed = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,235 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "decodescheduler.h"
+#include "mdkplayer.h"
+#include <QtCore/qdebug.h>
+#include <algorithm>
+
+// How often the budget is shared out again, in milliseconds.
+static constexpr const int kRebalanceInterval = 1000;
+// Focused items are worth this many times their area.
+static constexpr const qint64 kFocusWeight = 4;
+// Assumed when the media doesn't tell.
+static constexpr const qreal kDefaultFrameRate = 30.0;
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+using QualityTier = MDKPlayer::QualityTier;
+
+// Rough shares of the full decoding work left at each tier. Lower
+// resolutions save more with lowres codecs and on the upload, skipped
+// non-reference frames are most of the frames of a long GOP.
+static inline qreal tierCost(const QualityTier value)
+{
+    switch (value) {
+    case QualityTier::Full:
+        return 1.0;
+    case QualityTier::ReducedResolution:
+        return 0.7;
+    case QualityTier::ReducedFrameRate:
+        return 0.4;
+    case QualityTier::KeyFramesOnly:
+        return 0.1;
+    }
+    return 1.0;
+}
+
+DecodeScheduler::DecodeScheduler(QObject *parent) : QObject(parent)
+{
+}
+
+DecodeScheduler::~DecodeScheduler() = default;
+
+DecodeScheduler *DecodeScheduler::instance()
+{
+    static DecodeScheduler scheduler;
+    return &scheduler;
+}
+
+qint64 DecodeScheduler::pixelBudget() const
+{
+    return m_pixelBudget;
+}
+
+void DecodeScheduler::setPixelBudget(const qint64 value)
+{
+    if (m_pixelBudget != value) {
+        m_pixelBudget = qMax(qint64(0), value);
+        rebalance();
+        Q_EMIT pixelBudgetChanged();
+        qDebug() << "Decode scheduler: pixel budget -->" << m_pixelBudget;
+    }
+}
+
+int DecodeScheduler::playerCount() const
+{
+    return m_players.size();
+}
+
+int DecodeScheduler::playingCount() const
+{
+    return static_cast<int>(std::count_if(m_players.cbegin(), m_players.cend(), [](const QPointer<MDKPlayer> &player) {
+        return (player && player->isPlaying());
+    }));
+}
+
+qint64 DecodeScheduler::demand() const
+{
+    return m_demand;
+}
+
+qint64 DecodeScheduler::load() const
+{
+    return m_load;
+}
+
+qreal DecodeScheduler::frameRate() const
+{
+    return m_frameRate;
+}
+
+void DecodeScheduler::registerPlayer(MDKPlayer *player)
+{
+    if (!player || m_players.contains(player)) {
+        return;
+    }
+    m_players.append(player);
+    if (m_timer == 0) {
+        m_timer = startTimer(kRebalanceInterval);
+        m_frameRateTimer.start();
+    }
+    Q_EMIT statisticsChanged();
+}
+
+void DecodeScheduler::unregisterPlayer(MDKPlayer *player)
+{
+    m_players.removeAll(player);
+    if (m_players.isEmpty() && (m_timer != 0)) {
+        killTimer(m_timer);
+        m_timer = 0;
+    }
+    Q_EMIT statisticsChanged();
+}
+
+void DecodeScheduler::rebalance()
+{
+    struct Entry
+    {
+        MDKPlayer *player = nullptr;
+        qreal cost = 0.0;
+        qint64 score = 0;
+        QualityTier tier = QualityTier::Full;
+    };
+    QList<Entry> entries = {};
+    quint64 renderedFrames = 0;
+    for (auto &&player : qAsConst(m_players)) {
+        if (!player) {
+            continue;
+        }
+        renderedFrames += player->m_totalRenderedFrames;
+        if (player->m_livePreview || player->isStopped() || !player->m_hasVideo || !player->effectivelyVisible()
+                || player->m_mediaInfo.videoStreams.isEmpty()) {
+            player->setQualityTier(QualityTier::Full);
+            continue;
+        }
+        const auto vs = player->m_mediaInfo.videoStreams.value(qMax(0, player->m_variantSelector.currentTrack()));
+        const qreal frameRate = (vs.frameRate > 0.0) ? vs.frameRate : kDefaultFrameRate;
+        Entry entry = {};
+        entry.player = player;
+        entry.cost = qreal(vs.width) * qreal(vs.height) * frameRate * qMax(qAbs(player->playbackRate()), 1.0);
+        entry.score = qint64(player->m_renderSize.width()) * qint64(player->m_renderSize.height())
+                      * (player->hasActiveFocus() ? kFocusWeight : 1);
+        entries.append(entry);
+    }
+    qreal total = 0.0;
+    for (auto &&entry : qAsConst(entries)) {
+        total += entry.cost;
+    }
+    m_demand = qRound64(total);
+    // MDK's hardware decoders neither skip frames nor decode smaller, and
+    // without lowres the scale filter runs after decoding at the full size.
+    const auto expectedCost = [](const MDKPlayer *player, const QualityTier tier) -> qreal {
+        if (!player->m_activeVideoDecoder.startsWith(QStringLiteral("FFmpeg"), Qt::CaseInsensitive)) {
+            return 1.0;
+        }
+        if (tier == QualityTier::ReducedResolution) {
+            const auto vs = player->m_mediaInfo.videoStreams.value(qMax(0, player->m_variantSelector.currentTrack()));
+            return MDKPlayer::hasLowres(vs.codec) ? tierCost(tier) : 1.0;
+        }
+        return tierCost(tier);
+    };
+    // What the player really saves, whatever its tier.
+    const auto actualCost = [](const MDKPlayer *player) -> qreal {
+        qreal cost = 1.0;
+        if (player->m_activeFrameSkip == MDKPlayer::FrameSkip::KeyFrames) {
+            cost = tierCost(QualityTier::KeyFramesOnly);
+        } else if (player->m_activeFrameSkip == MDKPlayer::FrameSkip::NonReference) {
+            cost = tierCost(QualityTier::ReducedFrameRate);
+        }
+        if ((player->m_decodeScale > 1) && !player->m_decodeScaleFiltered) {
+            cost = qMin(cost, tierCost(QualityTier::ReducedResolution));
+        }
+        return cost;
+    };
+    if (m_pixelBudget > 0) {
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+            return (lhs.score < rhs.score);
+        });
+        for (auto &&tier : {QualityTier::ReducedResolution, QualityTier::ReducedFrameRate, QualityTier::KeyFramesOnly}) {
+            for (auto &&entry : entries) {
+                if (total <= m_pixelBudget) {
+                    break;
+                }
+                total -= entry.cost * (expectedCost(entry.player, entry.tier) - expectedCost(entry.player, tier));
+                entry.tier = tier;
+            }
+        }
+    }
+    // Some changes take a moment (or never happen), the load is what the
+    // players report, not what the tiers promise.
+    total = 0.0;
+    for (auto &&entry : qAsConst(entries)) {
+        entry.player->setQualityTier(entry.tier);
+        total += entry.cost * actualCost(entry.player);
+    }
+    m_load = qRound64(total);
+    if (m_frameRateTimer.isValid()) {
+        const qint64 elapsed = m_frameRateTimer.restart();
+        // Players come and go, their counters with them.
+        m_frameRate = ((elapsed > 0) && (renderedFrames >= m_renderedFrames))
+                      ? (qreal(renderedFrames - m_renderedFrames) * 1000.0 / qreal(elapsed)) : 0.0;
+    }
+    m_renderedFrames = renderedFrames;
+    Q_EMIT statisticsChanged();
+}
+
+void DecodeScheduler::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+    m_players.removeAll(nullptr);
+    rebalance();
+}
+
+MDKPLAYER_END_NAMESPACE
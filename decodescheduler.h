@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qelapsedtimer.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class MDKPlayer;
+
+// Shares a decoding budget between all players of the process, e.g. the
+// feeds of a video wall. Every MDKPlayer registers itself. Once a second
+// the demand of the visible players (pixels per second of their video) is
+// compared with pixelBudget and the players are given quality tiers until
+// it fits: the smallest items without focus are reduced first, one tier
+// at a time for everyone before anybody is reduced further. Players that
+// can't be seen cost nothing, see MDKPlayer::hiddenBehavior.
+class MDKPLAYER_API DecodeScheduler : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(DecodeScheduler)
+
+    Q_PROPERTY(qint64 pixelBudget READ pixelBudget WRITE setPixelBudget NOTIFY pixelBudgetChanged)
+    Q_PROPERTY(int playerCount READ playerCount NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 demand READ demand NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 load READ load NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal frameRate READ frameRate NOTIFY statisticsChanged)
+
+public:
+    explicit DecodeScheduler(QObject *parent = nullptr);
+    ~DecodeScheduler() override;
+
+    static DecodeScheduler *instance();
+
+    // Pixels per second all players may decode together, 0 (the default)
+    // means no limit. E.g. 8 1080p30 feeds are 8 * 1920 * 1080 * 30.
+    qint64 pixelBudget() const;
+    void setPixelBudget(const qint64 value);
+
+    int playerCount() const;
+    // Players that are playing right now, visible or not.
+    int playingCount() const;
+    // Pixels per second the visible players would decode at full quality,
+    // and what is left of it with the frame skipping and the decode scale
+    // the players have actually applied.
+    qint64 demand() const;
+    qint64 load() const;
+    // Frames per second rendered by all players together.
+    qreal frameRate() const;
+
+    void registerPlayer(MDKPlayer *player);
+    void unregisterPlayer(MDKPlayer *player);
+
+public Q_SLOTS:
+    void rebalance();
+
+Q_SIGNALS:
+    void pixelBudgetChanged();
+    void statisticsChanged();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    QList<QPointer<MDKPlayer>> m_players = {};
+    qint64 m_pixelBudget = 0;
+    qint64 m_demand = 0;
+    qint64 m_load = 0;
+    qreal m_frameRate = 0.0;
+    quint64 m_renderedFrames = 0;
+    QElapsedTimer m_frameRateTimer;
+    int m_timer = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,483 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dvrbuffer.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qthreadpool.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// MPEG-TS packets are always this long.
+static constexpr const int kPacketSize = 188;
+
+// PTS are 33 bit wide, in 90 kHz.
+static constexpr const qint64 kPtsWrap = Q_INT64_C(1) << 33;
+
+// Audio only streams have no key frames, they are cut at the first audio
+// packet after this long.
+static constexpr const qint64 kAudioSegmentDuration = 2000;
+
+// A stream without video in its first megabyte is treated as audio only.
+static constexpr const qint64 kVideoProbeBytes = 1024 * 1024;
+
+// The recorder doesn't tell us when it's done with a file, a closed file
+// counts as finished once its size stops changing. Checked every 100ms,
+// for two seconds at most.
+static constexpr const int kCloseCheckInterval = 100;
+static constexpr const int kCloseChecks = 20;
+
+DvrBuffer::DvrBuffer() = default;
+
+DvrBuffer::~DvrBuffer() = default;
+
+qint64 DvrBuffer::maxDuration() const
+{
+    return m_maxDuration;
+}
+
+void DvrBuffer::setMaxDuration(const qint64 value)
+{
+    m_maxDuration = qMax(qint64(0), value);
+    evict();
+}
+
+qint64 DvrBuffer::maxBytes() const
+{
+    return m_maxBytes;
+}
+
+void DvrBuffer::setMaxBytes(const qint64 value)
+{
+    m_maxBytes = qMax(qint64(0), value);
+    evict();
+}
+
+void DvrBuffer::append(const Segment &segment)
+{
+    if (segment.data.isEmpty()) {
+        return;
+    }
+    m_segments.append(segment);
+    m_bytes += segment.data.size();
+    evict();
+}
+
+void DvrBuffer::clear()
+{
+    m_segments.clear();
+    m_bytes = 0;
+}
+
+bool DvrBuffer::isEmpty() const
+{
+    return m_segments.isEmpty();
+}
+
+qint64 DvrBuffer::startTime() const
+{
+    return m_segments.isEmpty() ? 0 : m_segments.constFirst().startTime;
+}
+
+qint64 DvrBuffer::endTime() const
+{
+    if (m_segments.isEmpty()) {
+        return 0;
+    }
+    const Segment &last = m_segments.constLast();
+    return (last.startTime + last.duration);
+}
+
+qint64 DvrBuffer::duration() const
+{
+    return (endTime() - startTime());
+}
+
+qint64 DvrBuffer::bytes() const
+{
+    return m_bytes;
+}
+
+qint64 DvrBuffer::write(const QString &filePath, const qint64 from, const qint64 to) const
+{
+    if (m_segments.isEmpty() || filePath.isEmpty() || (to < from)) {
+        return -1;
+    }
+    QSaveFile file(filePath);
+    if (!file.open(QSaveFile::WriteOnly)) {
+        qWarning() << "Failed to open" << filePath << "for writing.";
+        return -1;
+    }
+    qint64 begin = -1;
+    for (auto &&segment : qAsConst(m_segments)) {
+        if ((segment.startTime + segment.duration) < from) {
+            continue;
+        }
+        if (segment.startTime > to) {
+            break;
+        }
+        if (begin < 0) {
+            begin = segment.startTime;
+        }
+        if (file.write(segment.data) != segment.data.size()) {
+            qWarning() << "Failed to write" << filePath;
+            file.cancelWriting();
+            return -1;
+        }
+    }
+    if ((begin < 0) || !file.commit()) {
+        return -1;
+    }
+    return begin;
+}
+
+void DvrBuffer::evict()
+{
+    // Always keep the latest segment, even if it alone exceeds the limits.
+    while ((m_segments.count() > 1) && ((m_bytes > m_maxBytes) || ((endTime() - m_segments.at(1).startTime) >= m_maxDuration))) {
+        m_bytes -= m_segments.constFirst().data.size();
+        m_segments.removeFirst();
+    }
+}
+
+DvrSplitter::DvrSplitter(const qint64 timeBase) : m_timeBase(timeBase)
+{
+}
+
+DvrSplitter::~DvrSplitter() = default;
+
+QList<DvrBuffer::Segment> DvrSplitter::feed(const QByteArray &packets)
+{
+    QList<DvrBuffer::Segment> segments = {};
+    const int count = packets.size() / kPacketSize;
+    for (int i = 0; i != count; ++i) {
+        const char *packet = packets.constData() + (i * kPacketSize);
+        const auto p = reinterpret_cast<const uchar *>(packet);
+        if (p[0] != 0x47) {
+            // Lost sync, can't happen with whole packets from the muxer.
+            continue;
+        }
+        const int pid = ((p[1] & 0x1F) << 8) | p[2];
+        const bool unitStart = ((p[1] & 0x40) != 0);
+        const int adaptation = ((p[3] >> 4) & 0x03);
+        int payload = 4;
+        bool randomAccess = false;
+        if ((adaptation & 0x02) != 0) {
+            randomAccess = ((p[4] > 0) && ((p[5] & 0x40) != 0));
+            payload += (1 + p[4]);
+        }
+        const bool hasPayload = (((adaptation & 0x01) != 0) && (payload < kPacketSize));
+        if ((pid == 0) && unitStart && hasPayload) {
+            parsePat(p + payload, kPacketSize - payload);
+        }
+        int streamId = -1;
+        qint64 pts = -1;
+        if (unitStart && hasPayload && ((kPacketSize - payload) >= 14)) {
+            const uchar *pes = p + payload;
+            if ((pes[0] == 0x00) && (pes[1] == 0x00) && (pes[2] == 0x01)) {
+                streamId = pes[3];
+                if ((pes[7] & 0x80) != 0) {
+                    pts = (qint64(pes[9] & 0x0E) << 29) | (qint64(pes[10]) << 22) | (qint64(pes[11] & 0xFE) << 14)
+                          | (qint64(pes[12]) << 7) | (qint64(pes[13]) >> 1);
+                }
+            }
+        }
+        if (m_mainPid < 0) {
+            m_probed += kPacketSize;
+            if ((streamId >= 0xE0) && (streamId <= 0xEF)) {
+                m_mainPid = pid;
+            } else if ((streamId >= 0xC0) && (streamId <= 0xDF) && (m_probed >= kVideoProbeBytes)) {
+                m_mainPid = pid;
+                m_audioOnly = true;
+            }
+        }
+        bool cut = false;
+        if ((pid == m_mainPid) && (streamId >= 0)) {
+            if (pts >= 0) {
+                pts = unwrap(pts);
+                m_lastPts = pts;
+                m_endPts = qMax(m_endPts, pts);
+                if (m_ptsBase < 0) {
+                    m_ptsBase = pts;
+                }
+            } else {
+                pts = m_lastPts;
+            }
+            if (pts >= 0) {
+                cut = m_audioOnly ? ((m_segmentPts < 0) || ((mediaTime(pts) - mediaTime(m_segmentPts)) >= kAudioSegmentDuration))
+                                  : randomAccess;
+            }
+        }
+        if (cut) {
+            const int at = (m_psiOffset >= 0) ? m_psiOffset : m_pending.size();
+            if (m_segmentPts >= 0) {
+                DvrBuffer::Segment segment = {};
+                segment.startTime = mediaTime(m_segmentPts);
+                segment.duration = mediaTime(pts) - segment.startTime;
+                segment.data = m_pending.left(at);
+                segments.append(segment);
+            }
+            m_pending.remove(0, at);
+            m_segmentPts = pts;
+        }
+        if ((pid == 0) || (pid == m_pmtPid)) {
+            if (m_psiOffset < 0) {
+                m_psiOffset = m_pending.size();
+            }
+        } else {
+            m_psiOffset = -1;
+        }
+        m_pending.append(packet, kPacketSize);
+    }
+    return segments;
+}
+
+QList<DvrBuffer::Segment> DvrSplitter::finish()
+{
+    QList<DvrBuffer::Segment> segments = {};
+    if ((m_segmentPts >= 0) && !m_pending.isEmpty()) {
+        DvrBuffer::Segment segment = {};
+        segment.startTime = mediaTime(m_segmentPts);
+        segment.duration = mediaTime(m_endPts) - segment.startTime;
+        segment.data = m_pending;
+        segments.append(segment);
+    }
+    m_pending.clear();
+    m_segmentPts = -1;
+    m_psiOffset = -1;
+    return segments;
+}
+
+void DvrSplitter::parsePat(const uchar *data, const int size)
+{
+    // pointer_field, then the section: table_id, section_length and five
+    // more bytes of header, followed by the programs and the CRC.
+    const int section = 1 + data[0];
+    if ((section + 8) > size) {
+        return;
+    }
+    const uchar *pat = data + section;
+    const int end = qMin(size, section + 3 + (((pat[1] & 0x0F) << 8) | pat[2]) - 4);
+    for (int i = section + 8; (i + 4) <= end; i += 4) {
+        const int program = (data[i] << 8) | data[i + 1];
+        if (program != 0) {
+            m_pmtPid = ((data[i + 2] & 0x1F) << 8) | data[i + 3];
+            return;
+        }
+    }
+}
+
+qint64 DvrSplitter::unwrap(const qint64 pts)
+{
+    qint64 value = pts + m_ptsOffset;
+    if ((m_lastPts >= 0) && ((m_lastPts - value) > (kPtsWrap / 2))) {
+        m_ptsOffset += kPtsWrap;
+        value += kPtsWrap;
+    }
+    return value;
+}
+
+qint64 DvrSplitter::mediaTime(const qint64 pts) const
+{
+    return (m_timeBase + ((pts - m_ptsBase) / 90));
+}
+
+class DvrIngestTask final : public QRunnable
+{
+    Q_DISABLE_COPY_MOVE(DvrIngestTask)
+
+public:
+    explicit DvrIngestTask(const QSharedPointer<DvrIngest> &ingest) : m_ingest(ingest) {}
+    ~DvrIngestTask() override = default;
+
+    void run() override
+    {
+        m_ingest->run();
+    }
+
+private:
+    QSharedPointer<DvrIngest> m_ingest;
+};
+
+static QThreadPool *dvrIngestPool()
+{
+    // A single thread keeps the runs, and so the segments, in order.
+    static QThreadPool pool;
+    static const bool initialized = [&]() -> bool {
+        pool.setMaxThreadCount(1);
+        return true;
+    }();
+    Q_UNUSED(initialized);
+    return &pool;
+}
+
+// Waits until the recorder has flushed the file.
+static void waitForClose(const QString &filePath)
+{
+    qint64 size = QFileInfo(filePath).size();
+    for (int i = 0; i != kCloseChecks; ++i) {
+        QThread::msleep(kCloseCheckInterval);
+        const qint64 now = QFileInfo(filePath).size();
+        if (now == size) {
+            return;
+        }
+        size = now;
+    }
+    qWarning() << "The recorder is still writing" << filePath;
+}
+
+DvrIngest::DvrIngest(const Callback &callback) : m_callback(callback)
+{
+}
+
+DvrIngest::~DvrIngest() = default;
+
+void DvrIngest::addFile(const QString &filePath, const qint64 timeBase)
+{
+    QMutexLocker locker(&m_mutex);
+    File file = {};
+    file.path = filePath;
+    file.timeBase = timeBase;
+    file.first = m_streamEnded;
+    m_files.append(file);
+    m_streamEnded = false;
+}
+
+void DvrIngest::closeFile(const bool last)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_files.isEmpty() && !m_files.constLast().closed) {
+        m_files.last().closed = true;
+        m_files.last().last = last;
+    }
+    m_streamEnded = (m_streamEnded || last);
+}
+
+void DvrIngest::discard()
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto &&file : m_files) {
+        file.discarded = true;
+    }
+}
+
+void DvrIngest::cancel()
+{
+    QMutexLocker locker(&m_callbackMutex);
+    m_cancelled = true;
+}
+
+void DvrIngest::schedule(const QSharedPointer<DvrIngest> &ingest)
+{
+    if (!ingest) {
+        return;
+    }
+    {
+        QMutexLocker locker(&ingest->m_mutex);
+        // One queued run picks up everything, no need for another one.
+        if (ingest->m_scheduled || ingest->m_files.isEmpty()) {
+            return;
+        }
+        ingest->m_scheduled = true;
+    }
+    dvrIngestPool()->start(new DvrIngestTask(ingest));
+}
+
+void DvrIngest::run()
+{
+    QList<File> files = {};
+    {
+        QMutexLocker locker(&m_mutex);
+        m_scheduled = false;
+        files = m_files;
+    }
+    QList<DvrBuffer::Segment> segments = {};
+    for (auto &&file : qAsConst(files)) {
+        if (file.discarded) {
+            m_splitter.reset();
+            if (file.closed) {
+                waitForClose(file.path);
+                QFile::remove(file.path);
+                update(file.path, 0, true);
+            }
+            continue;
+        }
+        if ((file.first && (file.offset == 0)) || !m_splitter) {
+            m_splitter.reset(new DvrSplitter(file.timeBase));
+        }
+        if (file.closed) {
+            waitForClose(file.path);
+        }
+        qint64 offset = file.offset;
+        QFile f(file.path);
+        if (f.open(QFile::ReadOnly)) {
+            qint64 available = f.size() - offset;
+            // Whole packets only, the rest is still being written. A partial
+            // packet at the end of a closed file is useless anyway.
+            available -= (available % kPacketSize);
+            if ((available > 0) && f.seek(offset)) {
+                const QByteArray data = f.read(available);
+                offset += data.size();
+                segments.append(m_splitter->feed(data));
+            }
+            f.close();
+        }
+        if (file.closed) {
+            if (file.last) {
+                segments.append(m_splitter->finish());
+            }
+            QFile::remove(file.path);
+        }
+        update(file.path, offset, file.closed);
+    }
+    if (segments.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&m_callbackMutex);
+    if (!m_cancelled && m_callback) {
+        m_callback(segments);
+    }
+}
+
+void DvrIngest::update(const QString &filePath, const qint64 offset, const bool done)
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i != m_files.count(); ++i) {
+        if (m_files.at(i).path != filePath) {
+            continue;
+        }
+        if (done) {
+            m_files.removeAt(i);
+        } else {
+            m_files[i].offset = offset;
+        }
+        return;
+    }
+}
+
+MDKPLAYER_END_NAMESPACE
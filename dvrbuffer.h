@@ -0,0 +1,189 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qscopedpointer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qstring.h>
+#include <functional>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Keeps the most recent part of a stream in memory as a list of MPEG-TS
+// segments. The segments are produced by MDK's recorder (stream copy, no
+// re-encoding) and cut by DvrSplitter, so every one of them starts at a key
+// frame and any run of consecutive segments concatenated byte by byte is a
+// valid stream again.
+class MDKPLAYER_API DvrBuffer
+{
+    Q_DISABLE_COPY_MOVE(DvrBuffer)
+
+public:
+    struct Segment
+    {
+        // Media time, in milliseconds.
+        qint64 startTime = 0;
+        qint64 duration = 0;
+        QByteArray data = {};
+    };
+
+    DvrBuffer();
+    ~DvrBuffer();
+
+    qint64 maxDuration() const;
+    void setMaxDuration(const qint64 value);
+
+    qint64 maxBytes() const;
+    void setMaxBytes(const qint64 value);
+
+    // Oldest segments are dropped as soon as one of the limits is exceeded.
+    void append(const Segment &segment);
+    void clear();
+
+    bool isEmpty() const;
+    qint64 startTime() const;
+    qint64 endTime() const;
+    qint64 duration() const;
+    qint64 bytes() const;
+
+    // Writes all segments overlapping [from, to] to the given file. The
+    // actual range starts at the key frame preceding "from". Returns the
+    // media time the written stream starts at, or -1 on failure.
+    qint64 write(const QString &filePath, const qint64 from, const qint64 to) const;
+
+private:
+    void evict();
+
+private:
+    QList<Segment> m_segments = {};
+    qint64 m_bytes = 0;
+    qint64 m_maxDuration = 60000;
+    qint64 m_maxBytes = 256 * 1024 * 1024;
+};
+
+// Cuts an MPEG-TS stream into DvrBuffer segments at the random access points
+// of its video stream. A segment ends right before the PAT/PMT preceding the
+// next key frame (the muxer repeats them there), times are derived from the
+// video PTS. Audio only streams are cut every two seconds instead. Whatever
+// comes before the first key frame can't be decoded and is dropped.
+class MDKPLAYER_API DvrSplitter
+{
+    Q_DISABLE_COPY_MOVE(DvrSplitter)
+
+public:
+    // "timeBase" is the media time of the first frame, in milliseconds.
+    explicit DvrSplitter(const qint64 timeBase = 0);
+    ~DvrSplitter();
+
+    // Takes whole 188 byte packets, returns the segments they completed.
+    QList<DvrBuffer::Segment> feed(const QByteArray &packets);
+    // The stream has ended, returns the rest as the last segment.
+    QList<DvrBuffer::Segment> finish();
+
+private:
+    void parsePat(const uchar *data, const int size);
+    qint64 unwrap(const qint64 pts);
+    qint64 mediaTime(const qint64 pts) const;
+
+private:
+    qint64 m_timeBase = 0;
+    qint64 m_ptsBase = -1;
+    qint64 m_ptsOffset = 0;
+    qint64 m_lastPts = -1;
+    qint64 m_endPts = -1;
+    qint64 m_segmentPts = -1;
+    qint64 m_probed = 0;
+    int m_mainPid = -1;
+    int m_pmtPid = -1;
+    int m_psiOffset = -1;
+    bool m_audioOnly = false;
+    QByteArray m_pending = {};
+};
+
+// Reads the files written by MDK's recorder on a worker thread while they
+// grow, whole packets only, and cuts them with a DvrSplitter. A file is read
+// to the end and deleted only after the recorder has closed it.
+class MDKPLAYER_API DvrIngest
+{
+    Q_DISABLE_COPY_MOVE(DvrIngest)
+
+    friend class DvrIngestTask;
+
+public:
+    // Called on the worker thread with the segments completed by a run.
+    using Callback = std::function<void(const QList<DvrBuffer::Segment> &segments)>;
+
+    explicit DvrIngest(const Callback &callback);
+    ~DvrIngest();
+
+    // The recorder started writing "filePath". "timeBase" is the media time
+    // it started at, only used if a new stream starts with this file.
+    void addFile(const QString &filePath, const qint64 timeBase);
+    // The recorder stopped writing the latest file. If "last", the stream
+    // ends there, otherwise it goes on in the next file.
+    void closeFile(const bool last);
+    // Everything added so far is deleted without being delivered.
+    void discard();
+    // No callback is running or will be started once this returns. The
+    // files are still cleaned up.
+    void cancel();
+
+    // Queues a run on the worker thread, runs never overlap.
+    static void schedule(const QSharedPointer<DvrIngest> &ingest);
+
+private:
+    void run();
+    void update(const QString &filePath, const qint64 offset, const bool done);
+
+private:
+    struct File
+    {
+        QString path = {};
+        qint64 timeBase = 0;
+        qint64 offset = 0;
+        bool first = false;
+        bool closed = false;
+        bool last = false;
+        bool discarded = false;
+    };
+
+    QMutex m_mutex;
+    QList<File> m_files = {};
+    bool m_streamEnded = true;
+    bool m_scheduled = false;
+
+    QMutex m_callbackMutex;
+    Callback m_callback = nullptr;
+    bool m_cancelled = false;
+
+    // Only touched by run().
+    QScopedPointer<DvrSplitter> m_splitter;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,343 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "frameexporter.h"
+#include "imageencoder.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qsavefile.h>
+#include <QtGui/qimage.h>
+#include <mdk/Player.h>
+#include <mdk/VideoFrame.h>
+#include <set>
+
+// A step that hasn't delivered a frame after this long went past the last one.
+static constexpr const qint64 kStepTimeout = 5000;
+
+static inline std::vector<std::string> toStdStringVector(const QStringList &stringList)
+{
+    std::vector<std::string> result = {};
+    for (auto &&string : qAsConst(stringList)) {
+        result.push_back(string.toStdString());
+    }
+    return result;
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+FrameExporter::FrameExporter(QObject *parent) : QObject(parent), m_written(new QAtomicInt(0))
+{
+}
+
+FrameExporter::~FrameExporter()
+{
+    // The images still being encoded only need m_written.
+    cancel();
+}
+
+QUrl FrameExporter::source() const
+{
+    return m_source;
+}
+
+void FrameExporter::setSource(const QUrl &value)
+{
+    if (m_source != value) {
+        m_source = value;
+        Q_EMIT sourceChanged();
+    }
+}
+
+QString FrameExporter::outputDirectory() const
+{
+    return m_outputDirectory;
+}
+
+void FrameExporter::setOutputDirectory(const QString &value)
+{
+    if (m_outputDirectory != value) {
+        m_outputDirectory = value;
+        Q_EMIT outputDirectoryChanged();
+    }
+}
+
+QString FrameExporter::format() const
+{
+    return m_format;
+}
+
+void FrameExporter::setFormat(const QString &value)
+{
+    if (!value.isEmpty() && (m_format != value)) {
+        m_format = value;
+        Q_EMIT formatChanged();
+    }
+}
+
+qint64 FrameExporter::startTime() const
+{
+    return m_startTime;
+}
+
+void FrameExporter::setStartTime(const qint64 value)
+{
+    const qint64 val = qMax(qint64(0), value);
+    if (m_startTime != val) {
+        m_startTime = val;
+        Q_EMIT startTimeChanged();
+    }
+}
+
+qint64 FrameExporter::endTime() const
+{
+    return m_endTime;
+}
+
+void FrameExporter::setEndTime(const qint64 value)
+{
+    if (m_endTime != value) {
+        m_endTime = value;
+        Q_EMIT endTimeChanged();
+    }
+}
+
+int FrameExporter::step() const
+{
+    return m_step;
+}
+
+void FrameExporter::setStep(const int value)
+{
+    const int val = qMax(1, value);
+    if (m_step != val) {
+        m_step = val;
+        Q_EMIT stepChanged();
+    }
+}
+
+QStringList FrameExporter::videoDecoders() const
+{
+    return m_videoDecoders;
+}
+
+void FrameExporter::setVideoDecoders(const QStringList &value)
+{
+    if (m_videoDecoders != value) {
+        m_videoDecoders = value;
+        Q_EMIT videoDecodersChanged();
+    }
+}
+
+bool FrameExporter::running() const
+{
+    return m_running;
+}
+
+qreal FrameExporter::progress() const
+{
+    qint64 end = m_endTime;
+    if ((end < 0) && m_player) {
+        end = m_player->mediaInfo().duration;
+    }
+    if (end <= m_startTime) {
+        return m_running ? 0.0 : 1.0;
+    }
+    const qint64 done = m_lastTimestamp.loadAcquire() - m_startTime;
+    return qBound(0.0, static_cast<qreal>(done) / static_cast<qreal>(end - m_startTime), 1.0);
+}
+
+int FrameExporter::framesWritten() const
+{
+    return m_written->loadAcquire();
+}
+
+qreal FrameExporter::framesPerSecond() const
+{
+    if (!m_elapsed.isValid() || (m_elapsed.elapsed() <= 0)) {
+        return 0.0;
+    }
+    return (m_written->loadAcquire() * 1000.0 / static_cast<qreal>(m_elapsed.elapsed()));
+}
+
+bool FrameExporter::start()
+{
+    if (m_running || !m_source.isValid() || m_outputDirectory.isEmpty()) {
+        return false;
+    }
+    if (!QDir().mkpath(m_outputDirectory)) {
+        qWarning() << "Failed to create the output directory:" << m_outputDirectory;
+        return false;
+    }
+    m_manifest = QByteArrayLiteral("index,timestamp,file\n");
+    m_lastTimestamp.storeRelease(m_startTime);
+    m_lastFrame.storeRelease(-1);
+    m_decoded.storeRelease(0);
+    m_queued.storeRelease(0);
+    // The encoder callbacks of a cancelled run may still be counting.
+    m_written.reset(new QAtomicInt(0));
+    m_framePending.storeRelease(1);
+    m_done.storeRelease(0);
+
+    m_player.reset(new MDK_NS_PREPEND(Player));
+    if (!m_videoDecoders.isEmpty()) {
+        m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, toStdStringVector(m_videoDecoders));
+    }
+    // Video only, nothing is rendered either.
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Audio, std::set<int>{});
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Subtitle, std::set<int>{});
+    m_player->setMedia(qUtf8Printable(m_source.isLocalFile() ? QDir::toNativeSeparators(m_source.toLocalFile())
+                                                             : m_source.url()));
+    m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>([this](MDK_NS_PREPEND(VideoFrame) &frame, int track) {
+        Q_UNUSED(track);
+        if (m_done.loadAcquire()) {
+            return 0;
+        }
+        // An invalid frame means the end of the stream.
+        if (!frame) {
+            m_done.storeRelease(1);
+            return 0;
+        }
+        const qint64 timestamp = qRound64(frame.timestamp() * 1000.0);
+        // Delivered again, the step that asked for it is still pending.
+        if (timestamp <= m_lastFrame.loadAcquire()) {
+            return 0;
+        }
+        m_lastFrame.storeRelease(timestamp);
+        m_framePending.storeRelease(0);
+        if ((m_endTime >= 0) && (timestamp > m_endTime)) {
+            m_done.storeRelease(1);
+            return 0;
+        }
+        if (timestamp >= m_startTime) {
+            m_lastTimestamp.storeRelease(timestamp);
+        }
+        if ((timestamp >= m_startTime) && ((m_decoded.fetchAndAddOrdered(1) % m_step) == 0)) {
+            const auto rgba = frame.to(MDK_NS_PREPEND(PixelFormat)::RGBA);
+            const QImage image(rgba.bufferData(0), rgba.width(), rgba.height(), rgba.bytesPerLine(0), QImage::Format_RGBA8888);
+            handleFrame(image.copy(), timestamp);
+        }
+        // The next frame is only decoded once this one has been handed over.
+        QMetaObject::invokeMethod(this, [this]() {
+            stepFrame();
+        }, Qt::QueuedConnection);
+        return 0;
+    });
+    // Paused, the player decodes the frame at the start time and waits for
+    // the next step.
+    m_player->prepare(m_startTime, nullptr, MDK_NS_PREPEND(SeekFlag)::FromStart);
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Paused);
+
+    m_stepTimer.start();
+    m_elapsed.start();
+    m_timerId = startTimer(100);
+    m_running = true;
+    Q_EMIT runningChanged();
+    Q_EMIT progressChanged();
+    qDebug() << "Exporting frames of" << m_source << "to" << m_outputDirectory;
+    return true;
+}
+
+void FrameExporter::cancel()
+{
+    if (!m_running) {
+        return;
+    }
+    m_done.storeRelease(1);
+    finish(false);
+}
+
+// Called on the decoder thread.
+void FrameExporter::handleFrame(const QImage &image, const qint64 timestamp)
+{
+    const int index = m_queued.fetchAndAddOrdered(1);
+    const QString format = ImageEncoder::normalizedFormat(m_format);
+    const QString name = QStringLiteral("%1.%2").arg(index, 6, 10, QLatin1Char('0')).arg(format);
+    {
+        const QMutexLocker locker(&m_manifestMutex);
+        m_manifest.append(QByteArray::number(index) + ',' + QByteArray::number(timestamp) + ',' + name.toUtf8() + '\n');
+    }
+    const QSharedPointer<QAtomicInt> written = m_written;
+    // Blocks while the encoders are busy, which throttles the decoder.
+    ImageEncoder::instance()->encode(image, QDir(m_outputDirectory).filePath(name), format, -1,
+                                     [written](const bool ok, const qint64 elapsed) {
+        Q_UNUSED(ok);
+        Q_UNUSED(elapsed);
+        written->fetchAndAddOrdered(1);
+    });
+}
+
+void FrameExporter::stepFrame()
+{
+    if (!m_running || m_done.loadAcquire()) {
+        return;
+    }
+    m_framePending.storeRelease(1);
+    m_stepTimer.start();
+    m_player->seek(1, MDK_NS_PREPEND(SeekFlag)::FromNow | MDK_NS_PREPEND(SeekFlag)::Frame, [this](int64_t ret) {
+        // Nothing left to step to.
+        if (ret < 0) {
+            m_done.storeRelease(1);
+        }
+    });
+}
+
+void FrameExporter::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+    Q_EMIT progressChanged();
+    if (m_framePending.loadAcquire() && (m_stepTimer.elapsed() >= kStepTimeout)) {
+        m_done.storeRelease(1);
+    }
+    if (m_done.loadAcquire() && (m_written->loadAcquire() >= m_queued.loadAcquire())) {
+        finish(true);
+    }
+}
+
+void FrameExporter::finish(const bool ok)
+{
+    if (m_timerId != 0) {
+        killTimer(m_timerId);
+        m_timerId = 0;
+    }
+    if (m_player) {
+        m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>(nullptr);
+        m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+        m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    }
+    {
+        const QMutexLocker locker(&m_manifestMutex);
+        QSaveFile manifest(QDir(m_outputDirectory).filePath(QStringLiteral("manifest.csv")));
+        if (!manifest.open(QSaveFile::WriteOnly) || (manifest.write(m_manifest) < 0) || !manifest.commit()) {
+            qWarning() << "Failed to write the manifest to" << m_outputDirectory;
+        }
+    }
+    m_running = false;
+    Q_EMIT runningChanged();
+    Q_EMIT progressChanged();
+    qDebug() << "Frame export" << (ok ? "finished:" : "cancelled:") << framesWritten() << "frames,"
+             << framesPerSecond() << "fps.";
+    Q_EMIT finished(ok);
+}
+
+MDKPLAYER_END_NAMESPACE
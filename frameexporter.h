@@ -0,0 +1,156 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qsharedpointer.h>
+
+namespace mdk
+{
+
+class Player;
+
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Dumps the frames of a time range to a numbered image sequence, without any
+// window or render target involved. The range is decoded once, sequentially,
+// by stepping a paused player one frame at a time: the next frame is only
+// requested after the previous one has been handed to the image encoder
+// pool, so there is no playback clock that could drop frames. When the pool
+// is full the decoder thread waits, so memory usage stays bounded no matter
+// how fast the decoder is. A "manifest.csv" (index, timestamp, file name)
+// is written next to the images.
+class MDKPLAYER_API FrameExporter : public QObject
+{
+    Q_OBJECT
+#ifdef QML_ELEMENT
+    QML_ELEMENT
+#endif
+    Q_DISABLE_COPY_MOVE(FrameExporter)
+
+    Q_PROPERTY(QUrl source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(QString outputDirectory READ outputDirectory WRITE setOutputDirectory NOTIFY outputDirectoryChanged)
+    Q_PROPERTY(QString format READ format WRITE setFormat NOTIFY formatChanged)
+    Q_PROPERTY(qint64 startTime READ startTime WRITE setStartTime NOTIFY startTimeChanged)
+    Q_PROPERTY(qint64 endTime READ endTime WRITE setEndTime NOTIFY endTimeChanged)
+    Q_PROPERTY(int step READ step WRITE setStep NOTIFY stepChanged)
+    Q_PROPERTY(QStringList videoDecoders READ videoDecoders WRITE setVideoDecoders NOTIFY videoDecodersChanged)
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+    Q_PROPERTY(int framesWritten READ framesWritten NOTIFY progressChanged)
+    Q_PROPERTY(qreal framesPerSecond READ framesPerSecond NOTIFY progressChanged)
+
+public:
+    explicit FrameExporter(QObject *parent = nullptr);
+    ~FrameExporter() override;
+
+    QUrl source() const;
+    void setSource(const QUrl &value);
+
+    QString outputDirectory() const;
+    void setOutputDirectory(const QString &value);
+
+    QString format() const;
+    void setFormat(const QString &value);
+
+    qint64 startTime() const;
+    void setStartTime(const qint64 value);
+
+    // A negative value means the end of the media.
+    qint64 endTime() const;
+    void setEndTime(const qint64 value);
+
+    // Export every Nth frame.
+    int step() const;
+    void setStep(const int value);
+
+    QStringList videoDecoders() const;
+    void setVideoDecoders(const QStringList &value);
+
+    bool running() const;
+    qreal progress() const;
+    int framesWritten() const;
+    qreal framesPerSecond() const;
+
+public Q_SLOTS:
+    bool start();
+    void cancel();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void handleFrame(const QImage &image, const qint64 timestamp);
+    void stepFrame();
+    void finish(const bool ok);
+
+Q_SIGNALS:
+    void sourceChanged();
+    void outputDirectoryChanged();
+    void formatChanged();
+    void startTimeChanged();
+    void endTimeChanged();
+    void stepChanged();
+    void videoDecodersChanged();
+    void runningChanged();
+    void progressChanged();
+    void finished(const bool param1);
+
+private:
+    QUrl m_source = {};
+    QString m_outputDirectory = {};
+    QString m_format = QStringLiteral("png");
+    qint64 m_startTime = 0;
+    qint64 m_endTime = -1;
+    int m_step = 1;
+    QStringList m_videoDecoders = {};
+
+    QScopedPointer<mdk::Player> m_player;
+    bool m_running = false;
+    int m_timerId = 0;
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_stepTimer;
+
+    // Shared with the decoder and encoder threads.
+    QMutex m_manifestMutex;
+    QByteArray m_manifest = {};
+    QAtomicInteger<qint64> m_lastTimestamp = 0;
+    QAtomicInteger<qint64> m_lastFrame = -1;
+    QAtomicInt m_decoded = 0;
+    QAtomicInt m_queued = 0;
+    // Owned by the encoder callbacks too, they may outlive us.
+    QSharedPointer<QAtomicInt> m_written;
+    QAtomicInt m_framePending = 0;
+    QAtomicInt m_done = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
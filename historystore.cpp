@@ -0,0 +1,335 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "historystore.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qcoreapplication.h>
+#include <utility>
+#ifdef Q_OS_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Write everything that piled up within this interval in one go.
+static constexpr const int kBatchInterval = 1000;
+// But don't let the queue grow too long.
+static constexpr const int kMaxBatch = 512;
+// Rewrite the log once it has this many more records than entries.
+static constexpr const int kCompactSlack = 4096;
+
+static inline QByteArray urlToKey(const QUrl &value)
+{
+    // Fully encoded urls never contain tabs or line breaks.
+    return value.toEncoded();
+}
+
+static inline QByteArray makeRecord(const QByteArray &key, const qint64 value)
+{
+    return QByteArray::number(value) + '\t' + key + '\n';
+}
+
+static inline bool syncToDisk(QFileDevice &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WINDOWS
+    return (_commit(file.handle()) == 0);
+#else
+    return (::fsync(file.handle()) == 0);
+#endif
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+HistoryStore::HistoryStore(const QString &filePath) : m_filePath(filePath)
+{
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    load();
+    m_thread = QThread::create([this](){ run(); });
+    m_thread->setObjectName(QStringLiteral("MDKPlayerHistoryWriter"));
+    m_thread->start(QThread::LowPriority);
+}
+
+HistoryStore::~HistoryStore()
+{
+    shutdown();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+HistoryStore *HistoryStore::instance()
+{
+    static HistoryStore store(QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+                                  .filePath(QStringLiteral("mdkplayer_history.log")));
+    static QBasicAtomicInt shutdownConnected = Q_BASIC_ATOMIC_INITIALIZER(0);
+    QCoreApplication *app = QCoreApplication::instance();
+    if (app && shutdownConnected.testAndSetOrdered(0, 1)) {
+        QObject::connect(app, &QCoreApplication::aboutToQuit, app, [](){
+            store.shutdown();
+        });
+    }
+    return &store;
+}
+
+QString HistoryStore::filePath() const
+{
+    return m_filePath;
+}
+
+qint64 HistoryStore::position(const QUrl &url) const
+{
+    if (!url.isValid()) {
+        return -1;
+    }
+    const QMutexLocker locker(&m_mutex);
+    return m_index.value(urlToKey(url), -1);
+}
+
+void HistoryStore::setPosition(const QUrl &url, const qint64 value)
+{
+    if (!url.isValid() || (value < 0)) {
+        return;
+    }
+    enqueue(urlToKey(url), value);
+}
+
+void HistoryStore::remove(const QUrl &url)
+{
+    if (!url.isValid()) {
+        return;
+    }
+    enqueue(urlToKey(url), -1);
+}
+
+int HistoryStore::count() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_index.count();
+}
+
+void HistoryStore::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    const quint64 target = m_queued;
+    ++m_flushing;
+    m_wakeWriter.wakeAll();
+    while (m_committed < target) {
+        m_written.wait(&m_mutex);
+    }
+    --m_flushing;
+}
+
+void HistoryStore::shutdown()
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        if (m_quit) {
+            return;
+        }
+        m_quit = true;
+        m_wakeWriter.wakeAll();
+    }
+    m_thread->wait();
+    // Nothing else would retry a failed write.
+    writePending();
+}
+
+void HistoryStore::enqueue(const QByteArray &key, const qint64 value)
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        const auto it = m_index.constFind(key);
+        if (value < 0) {
+            if (it == m_index.constEnd()) {
+                return;
+            }
+            m_index.erase(it);
+        } else {
+            if ((it != m_index.constEnd()) && (it.value() == value)) {
+                return;
+            }
+            m_index.insert(key, value);
+        }
+        m_pending.append(makeRecord(key, value));
+        ++m_queued;
+        if (!m_quit) {
+            m_wakeWriter.wakeAll();
+            return;
+        }
+    }
+    // The writer has been shut down.
+    writePending();
+}
+
+void HistoryStore::load()
+{
+    QFile file(m_filePath);
+    if (!file.exists()) {
+        return;
+    }
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open the history file:" << m_filePath;
+        return;
+    }
+    // The end of the last complete record.
+    qint64 validSize = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine();
+        // An unterminated record is a write that was interrupted, drop it.
+        if (!line.endsWith('\n')) {
+            break;
+        }
+        validSize = file.pos();
+        const int tab = line.indexOf('\t');
+        if (tab <= 0) {
+            continue;
+        }
+        bool ok = false;
+        const qint64 value = line.left(tab).toLongLong(&ok);
+        if (!ok) {
+            continue;
+        }
+        const QByteArray key = line.mid(tab + 1).chopped(1);
+        if (key.isEmpty()) {
+            continue;
+        }
+        if (value < 0) {
+            m_index.remove(key);
+        } else {
+            m_index.insert(key, value);
+        }
+        ++m_logRecords;
+    }
+    const qint64 fileSize = file.size();
+    file.close();
+    // New records are appended, they must not be glued to the torn one.
+    if ((validSize < fileSize) && !QFile::resize(m_filePath, validSize)) {
+        qWarning() << "Failed to truncate the history file:" << m_filePath;
+    }
+    qDebug() << "History loaded:" << m_index.count() << "entries from" << m_logRecords << "records.";
+}
+
+void HistoryStore::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        while (m_pending.isEmpty() && !m_quit) {
+            m_wakeWriter.wait(&m_mutex);
+        }
+        // Let more changes pile up so that they share a single sync.
+        const QDeadlineTimer deadline(kBatchInterval);
+        while (!m_quit && (m_flushing <= 0) && (m_pending.count() < kMaxBatch) && !deadline.hasExpired()) {
+            m_wakeWriter.wait(&m_mutex, deadline);
+        }
+        if (m_pending.isEmpty() && m_quit) {
+            break;
+        }
+        locker.unlock();
+        writePending();
+        locker.relock();
+    }
+}
+
+void HistoryStore::writePending()
+{
+    const QMutexLocker writeLocker(&m_writeMutex);
+    QMutexLocker locker(&m_mutex);
+    if (m_pending.isEmpty() && !m_logStale) {
+        return;
+    }
+    const QList<QByteArray> records = std::exchange(m_pending, {});
+    const quint64 target = m_queued;
+    // After a failed write only a rewrite brings the log up to date again.
+    const bool shouldCompact = m_logStale || ((m_logRecords + records.count()) > ((2 * m_index.count()) + kCompactSlack));
+    const QHash<QByteArray, qint64> snapshot = shouldCompact ? m_index : QHash<QByteArray, qint64>{};
+    locker.unlock();
+    // The snapshot already contains the effect of the pending records.
+    const bool ok = shouldCompact ? compact(snapshot) : append(records);
+    locker.relock();
+    if (ok) {
+        m_logRecords = shouldCompact ? snapshot.count() : (m_logRecords + records.count());
+        m_logStale = false;
+    } else {
+        // The index keeps the changes, the next write rewrites the log from it.
+        m_logStale = true;
+        qWarning() << "Failed to save" << records.count() << "history changes, they are kept in memory until the next write.";
+    }
+    m_committed = target;
+    m_written.wakeAll();
+}
+
+bool HistoryStore::append(const QList<QByteArray> &records)
+{
+    QFile file(m_filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Append)) {
+        qWarning() << "Failed to open the history file:" << m_filePath;
+        return false;
+    }
+    for (auto &&record : qAsConst(records)) {
+        if (file.write(record) != record.size()) {
+            qWarning() << "Failed to write the history file:" << m_filePath;
+            return false;
+        }
+    }
+    if (!syncToDisk(file)) {
+        qWarning() << "Failed to write the history file:" << m_filePath;
+        return false;
+    }
+    return true;
+}
+
+bool HistoryStore::compact(const QHash<QByteArray, qint64> &snapshot)
+{
+    // QSaveFile replaces the old log atomically, a crash in between leaves
+    // the previous log untouched.
+    QSaveFile file(m_filePath);
+    if (!file.open(QFile::WriteOnly)) {
+        qWarning() << "Failed to compact the history file:" << m_filePath;
+        return false;
+    }
+    for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+        const QByteArray record = makeRecord(it.key(), it.value());
+        if (file.write(record) != record.size()) {
+            qWarning() << "Failed to compact the history file:" << m_filePath;
+            return false;
+        }
+    }
+    if (!syncToDisk(file) || !file.commit()) {
+        qWarning() << "Failed to compact the history file:" << m_filePath;
+        return false;
+    }
+    return true;
+}
+
+MDKPLAYER_END_NAMESPACE
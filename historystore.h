@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QThread)
+QT_FORWARD_DECLARE_CLASS(QUrl)
+QT_END_NAMESPACE
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Remembers the last playback position of every media.
+// Lookups are served from an in-memory hash, changes are appended to a log
+// file by a background thread which batches them and syncs them to disk in
+// one go, so the gui thread never waits for the disk. The log is rewritten
+// from the hash once it has grown much larger than the number of entries.
+// A record that was cut off by a crash is simply ignored on the next load.
+class MDKPLAYER_API HistoryStore
+{
+    Q_DISABLE_COPY_MOVE(HistoryStore)
+
+public:
+    explicit HistoryStore(const QString &filePath);
+    ~HistoryStore();
+
+    static HistoryStore *instance();
+
+    QString filePath() const;
+
+    // Returns -1 if there is no record for the given url.
+    qint64 position(const QUrl &url) const;
+    void setPosition(const QUrl &url, const qint64 value);
+    void remove(const QUrl &url);
+
+    int count() const;
+
+    // Blocks until everything queued so far has been written.
+    void flush();
+
+    // Stops the background writer once everything queued has been written,
+    // later changes are written right away by the calling thread. The store
+    // returned by instance() does this when the application is about to
+    // quit, its thread must not outlive QCoreApplication.
+    void shutdown();
+
+private:
+    void load();
+    void run();
+    void writePending();
+    bool append(const QList<QByteArray> &records);
+    bool compact(const QHash<QByteArray, qint64> &snapshot);
+    void enqueue(const QByteArray &key, const qint64 value);
+
+private:
+    QString m_filePath = {};
+    mutable QMutex m_mutex;
+    // Taken before m_mutex, keeps the batches in the order they were queued.
+    QMutex m_writeMutex;
+    QWaitCondition m_wakeWriter;
+    QWaitCondition m_written;
+    QHash<QByteArray, qint64> m_index = {};
+    QList<QByteArray> m_pending = {};
+    qint64 m_logRecords = 0;
+    quint64 m_queued = 0;
+    quint64 m_committed = 0;
+    int m_flushing = 0;
+    // A write failed, the log lacks changes the index has.
+    bool m_logStale = false;
+    bool m_quit = false;
+    QThread *m_thread = nullptr;
+};
+
+MDKPLAYER_END_NAMESPACE
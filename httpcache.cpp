@@ -0,0 +1,718 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "httpcache.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qdiriterator.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qcryptographichash.h>
+#include <QtCore/qregularexpression.h>
+#include <QtNetwork/qnetworkaccessmanager.h>
+#include <QtNetwork/qnetworkrequest.h>
+#include <QtNetwork/qnetworkreply.h>
+#include <algorithm>
+
+// What is requested and stored at once.
+static constexpr const qint64 kBlockSize = 1024 * 1024;
+// Blocks fetched ahead of the one being read.
+static constexpr const qint64 kReadAheadBlocks = 2;
+// Eviction stops once the cache is this much below its limit (percent),
+// so that it doesn't run for every block.
+static constexpr const qint64 kEvictTarget = 90;
+// A server that ignores range requests sends the whole resource for every
+// block, give up on it rather than downloading a whole movie each time.
+static constexpr const qint64 kMaxUnrangedSize = 64 * 1024 * 1024;
+// How long read() waits for a block that was evicted under its feet.
+static constexpr const qint64 kRefetchTimeout = 10000;
+static constexpr const char kSizeFileName[] = "size";
+static constexpr const char kCachePathPrefix[] = "cache";
+
+static inline bool isHttp(const QUrl &value)
+{
+    const QString scheme = value.scheme().toLower();
+    return ((scheme == QStringLiteral("http")) || (scheme == QStringLiteral("https")));
+}
+
+// Playlist entries become "cache/<url>/<file name>", relative to the
+// playlist on the media server, so that FFmpeg requests them from the
+// server as well and still sees the original file name.
+static inline QByteArray cacheReference(const QUrl &base, const QByteArray &reference, const bool cache)
+{
+    const QUrl url = base.resolved(QUrl::fromEncoded(reference.trimmed()));
+    if (!cache || !isHttp(url)) {
+        return url.toEncoded();
+    }
+    const QString fileName = url.fileName();
+    return QByteArray(kCachePathPrefix) + '/' + QUrl::toPercentEncoding(QString::fromUtf8(url.toEncoded())) + '/'
+           + QUrl::toPercentEncoding(fileName.isEmpty() ? QStringLiteral("media") : fileName);
+}
+
+// If-Range only takes strong ETags, Last-Modified otherwise.
+static inline QByteArray replyValidator(const QNetworkReply *reply)
+{
+    const QByteArray etag = reply->rawHeader("ETag").trimmed();
+    if (!etag.isEmpty() && !etag.startsWith("W/")) {
+        return etag;
+    }
+    return reply->rawHeader("Last-Modified").trimmed();
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+HttpCache::HttpCache(const QString &directory, QObject *parent) : QObject(parent), m_directory(directory)
+{
+    QDir().mkpath(m_directory);
+    load();
+}
+
+HttpCache::~HttpCache()
+{
+    if (!m_thread) {
+        return;
+    }
+    // Pending replies are children of the manager.
+    QMetaObject::invokeMethod(m_worker, [this]() {
+        delete m_network;
+        m_network = nullptr;
+    }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_worker;
+    delete m_thread;
+}
+
+HttpCache *HttpCache::instance()
+{
+    static HttpCache cache(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+                               .filePath(QStringLiteral("mdkplayer_http")));
+    return &cache;
+}
+
+QString HttpCache::directory() const
+{
+    return m_directory;
+}
+
+qint64 HttpCache::maxSize() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_maxSize;
+}
+
+void HttpCache::setMaxSize(const qint64 value)
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        if (m_maxSize == qMax(qint64(0), value)) {
+            return;
+        }
+        m_maxSize = qMax(qint64(0), value);
+        evict();
+    }
+    Q_EMIT maxSizeChanged();
+    Q_EMIT statisticsChanged();
+}
+
+qint64 HttpCache::size() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_size;
+}
+
+qint64 HttpCache::bytesFromCache() const
+{
+    return m_bytesFromCache.loadAcquire();
+}
+
+qint64 HttpCache::bytesFromNetwork() const
+{
+    return m_bytesFromNetwork.loadAcquire();
+}
+
+QSharedPointer<MediaSource> HttpCache::source(const QUrl &url)
+{
+    const QMutexLocker locker(&m_mutex);
+    QSharedPointer<MediaSource> result = m_sources.value(url).toStrongRef();
+    if (result) {
+        return result;
+    }
+    for (auto it = m_sources.begin(); it != m_sources.end();) {
+        if (it.value().isNull()) {
+            it = m_sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    result = QSharedPointer<HttpCacheSource>::create(url);
+    m_sources.insert(url, result.toWeakRef());
+    return result;
+}
+
+void HttpCache::fetch(const QUrl &url, const qint64 from, const qint64 to, const QByteArray &ifRange,
+                      const FetchCallback &callback)
+{
+    ensureStarted();
+    QMetaObject::invokeMethod(m_worker, [this, url, from, to, ifRange, callback]() {
+        if (!m_network) {
+            m_network = new QNetworkAccessManager;
+        }
+        QNetworkRequest request(url);
+        request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+        if (from >= 0) {
+            request.setRawHeader("Range", "bytes=" + QByteArray::number(from) + '-'
+                                              + ((to < 0) ? QByteArray{} : QByteArray::number(to)));
+            if (!ifRange.isEmpty()) {
+                request.setRawHeader("If-Range", ifRange);
+            }
+        }
+        QNetworkReply *reply = m_network->get(request);
+        connect(reply, &QNetworkReply::metaDataChanged, reply, [reply, from, ifRange]() {
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if ((from >= 0) && !ifRange.isEmpty() && (status == 200)) {
+                // The whole new resource is coming, none of it fits the
+                // cached blocks. The caller starts over.
+                reply->setProperty("changed", true);
+                reply->abort();
+                return;
+            }
+            if ((from > 0) && (status == 200)
+                    && (reply->header(QNetworkRequest::ContentLengthHeader).toLongLong() > kMaxUnrangedSize)) {
+                qWarning() << "HTTP cache:" << reply->url() << "doesn't support range requests.";
+                reply->abort();
+            }
+        });
+        connect(reply, &QNetworkReply::finished, reply, [reply, callback]() {
+            reply->deleteLater();
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const QByteArray validator = replyValidator(reply);
+            if (reply->property("changed").toBool()) {
+                callback({}, 0, -1, validator, false);
+                return;
+            }
+            if ((reply->error() != QNetworkReply::NoError) || ((status != 200) && (status != 206))) {
+                qWarning() << "HTTP cache: failed to fetch" << reply->url() << ':' << reply->errorString();
+                callback({}, 0, -1, validator, false);
+                return;
+            }
+            const QByteArray data = reply->readAll();
+            if (status == 200) {
+                callback(data, 0, data.size(), validator, true);
+                return;
+            }
+            // bytes <first>-<last>/<total or *>
+            const QByteArray range = reply->rawHeader("Content-Range").trimmed();
+            const int dash = range.indexOf('-');
+            const int slash = range.indexOf('/');
+            if ((dash < 0) || (slash < 0)) {
+                callback({}, 0, -1, validator, false);
+                return;
+            }
+            const qint64 offset = range.mid(6, dash - 6).trimmed().toLongLong();
+            const QByteArray total = range.mid(slash + 1).trimmed();
+            callback(data, offset, (total == "*") ? -1 : total.toLongLong(), validator, true);
+        });
+    }, Qt::QueuedConnection);
+}
+
+QString HttpCache::entryPath(const QString &key) const
+{
+    return QDir(m_directory).filePath(key);
+}
+
+bool HttpCache::store(const QString &filePath, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QSaveFile file(filePath);
+    if (!file.open(QFile::WriteOnly) || (file.write(data) != data.size()) || !file.commit()) {
+        qWarning() << "HTTP cache: failed to write" << filePath << ':' << file.errorString();
+        return false;
+    }
+    {
+        const QMutexLocker locker(&m_mutex);
+        Block &block = m_blocks[filePath];
+        m_size += (data.size() - block.size);
+        block.size = data.size();
+        block.lastUsed = ++m_useCounter;
+        evict();
+    }
+    QMetaObject::invokeMethod(this, [this]() {
+        Q_EMIT statisticsChanged();
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+void HttpCache::touch(const QString &filePath)
+{
+    const QMutexLocker locker(&m_mutex);
+    const auto it = m_blocks.find(filePath);
+    if (it != m_blocks.end()) {
+        it.value().lastUsed = ++m_useCounter;
+    }
+}
+
+void HttpCache::remove(const QString &key)
+{
+    const QString dirPath = entryPath(key);
+    const QString prefix = dirPath + QLatin1Char('/');
+    {
+        const QMutexLocker locker(&m_mutex);
+        for (auto it = m_blocks.begin(); it != m_blocks.end();) {
+            if (it.key().startsWith(prefix)) {
+                m_size -= it.value().size;
+                it = m_blocks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        QDir(dirPath).removeRecursively();
+    }
+    QMetaObject::invokeMethod(this, [this]() {
+        Q_EMIT statisticsChanged();
+    }, Qt::QueuedConnection);
+}
+
+void HttpCache::countServed(const qint64 fromCache, const qint64 fromNetwork)
+{
+    m_bytesFromCache.fetchAndAddOrdered(fromCache);
+    m_bytesFromNetwork.fetchAndAddOrdered(fromNetwork);
+    QMetaObject::invokeMethod(this, [this]() {
+        Q_EMIT statisticsChanged();
+    }, Qt::QueuedConnection);
+}
+
+void HttpCache::clear()
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        QDir(m_directory).removeRecursively();
+        QDir().mkpath(m_directory);
+        m_blocks.clear();
+        m_size = 0;
+    }
+    Q_EMIT statisticsChanged();
+}
+
+void HttpCache::ensureStarted()
+{
+    const QMutexLocker locker(&m_mutex);
+    if (m_thread) {
+        return;
+    }
+    m_thread = new QThread;
+    m_thread->setObjectName(QStringLiteral("HttpCache"));
+    m_worker = new QObject;
+    m_worker->moveToThread(m_thread);
+    m_thread->start();
+}
+
+void HttpCache::load()
+{
+    // Blocks are touched when they are read, their age is the order of use.
+    QList<QPair<QDateTime, QString>> files = {};
+    QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (info.fileName() == QLatin1String(kSizeFileName)) {
+            continue;
+        }
+        files.append({info.lastModified(), info.filePath()});
+        m_blocks.insert(info.filePath(), {info.size(), 0});
+        m_size += info.size();
+    }
+    std::sort(files.begin(), files.end());
+    for (auto &&file : qAsConst(files)) {
+        m_blocks[file.second].lastUsed = ++m_useCounter;
+    }
+    evict();
+}
+
+void HttpCache::evict()
+{
+    if (m_size <= m_maxSize) {
+        return;
+    }
+    QList<QPair<quint64, QString>> blocks = {};
+    blocks.reserve(m_blocks.size());
+    for (auto it = m_blocks.constBegin(); it != m_blocks.constEnd(); ++it) {
+        blocks.append({it.value().lastUsed, it.key()});
+    }
+    std::sort(blocks.begin(), blocks.end());
+    const qint64 target = m_maxSize / 100 * kEvictTarget;
+    for (auto &&block : qAsConst(blocks)) {
+        if (m_size <= target) {
+            break;
+        }
+        // A source may be reading it right now, it has it in memory then
+        // and fetches it again otherwise.
+        QFile::remove(block.second);
+        m_size -= m_blocks.take(block.second).size;
+    }
+}
+
+HttpCacheSource::HttpCacheSource(const QUrl &url)
+    : MediaSource(url.fileName().isEmpty() ? QStringLiteral("media") : url.fileName()), m_url(url)
+{
+    m_key = QString::fromLatin1(QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex());
+    const QString suffix = QFileInfo(url.path()).suffix().toLower();
+    m_cacheable = ((suffix != QStringLiteral("m3u8")) && (suffix != QStringLiteral("m3u")));
+    if (!m_cacheable) {
+        return;
+    }
+    // The size, optionally followed by the validator on the next line.
+    QFile file(QDir(HttpCache::instance()->entryPath(m_key)).filePath(QLatin1String(kSizeFileName)));
+    if (file.open(QFile::ReadOnly)) {
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        const qint64 value = lines.constFirst().trimmed().toLongLong();
+        m_size = (value > 0) ? value : -1;
+        m_validator = (lines.size() > 1) ? lines.at(1).trimmed() : QByteArray{};
+        // Without a validator there is nothing to compare with.
+        m_validated = ((m_size < 0) || m_validator.isEmpty());
+    }
+}
+
+HttpCacheSource::~HttpCacheSource() = default;
+
+qint64 HttpCacheSource::size() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_size;
+}
+
+QByteArray HttpCacheSource::read(const qint64 offset, const qint64 maxSize)
+{
+    const QMutexLocker locker(&m_mutex);
+    if ((offset < 0) || (maxSize <= 0) || (m_size < 0) || (offset >= m_size)) {
+        return {};
+    }
+    if (!m_cacheable) {
+        const qint64 length = qMin(maxSize, m_size - offset);
+        if ((offset + length) >= m_size) {
+            m_stale = true;
+        }
+        HttpCache::instance()->countServed(0, length);
+        return m_data.mid(offset, length);
+    }
+    const qint64 index = offset / kBlockSize;
+    if ((index != m_blockIndex) && !loadBlock(index)) {
+        // Evicted since isReady() said yes, fetch it again and wait for it.
+        if (!m_inFlight.contains(index)) {
+            fetchBlock(index);
+        }
+        m_awaitedBlock = index;
+        const QDeadlineTimer deadline(kRefetchTimeout);
+        while (m_inFlight.contains(index) && !deadline.hasExpired()) {
+            m_blockArrived.wait(&m_mutex, deadline);
+        }
+        m_awaitedBlock = -1;
+        // handleBlock() keeps the awaited block in memory.
+        if ((index != m_blockIndex) && !loadBlock(index)) {
+            return {};
+        }
+    }
+    const qint64 start = offset - (index * kBlockSize);
+    if (start >= m_block.size()) {
+        return {};
+    }
+    const qint64 length = qMin(maxSize, m_block.size() - start);
+    // The first read of a block we downloaded is what came from the network.
+    qint64 fromNetwork = 0;
+    const auto it = m_unservedNetworkBytes.find(index);
+    if (it != m_unservedNetworkBytes.end()) {
+        fromNetwork = qMin(length, it.value());
+        it.value() -= fromNetwork;
+        if (it.value() <= 0) {
+            m_unservedNetworkBytes.erase(it);
+        }
+    }
+    HttpCache::instance()->countServed(length - fromNetwork, fromNetwork);
+    return m_block.mid(start, length);
+}
+
+bool HttpCacheSource::isReady(const qint64 offset)
+{
+    const QMutexLocker locker(&m_mutex);
+    if (m_failed) {
+        // Reported once, the next request tries again.
+        m_failed = false;
+        return true;
+    }
+    if (!m_cacheable) {
+        if ((m_size >= 0) && !(m_stale && (offset == 0))) {
+            return true;
+        }
+        if (!m_inFlight.contains(0)) {
+            fetchAll();
+        }
+        return false;
+    }
+    if (!m_validated) {
+        if (!m_validating) {
+            revalidate();
+        }
+        return false;
+    }
+    const qint64 index = offset / kBlockSize;
+    if (m_size < 0) {
+        // The first block tells the size.
+        if (!m_inFlight.contains(index)) {
+            fetchBlock(index);
+        }
+        return false;
+    }
+    if (offset >= m_size) {
+        return true;
+    }
+    // Loaded right away, so that eviction can't take it away before read().
+    const bool ready = ((index == m_blockIndex) || loadBlock(index));
+    for (qint64 i = index; (i <= (index + kReadAheadBlocks)) && ((i * kBlockSize) < m_size); ++i) {
+        if (!m_inFlight.contains(i) && ((i != index) || !ready) && !QFileInfo::exists(blockPath(i))) {
+            fetchBlock(i);
+        }
+    }
+    return ready;
+}
+
+QSharedPointer<MediaSource> HttpCacheSource::resolve(const QString &path)
+{
+    const QStringList sections = path.split(QLatin1Char('/'));
+    QUrl url = {};
+    if ((sections.size() >= 3) && (sections.at(sections.size() - 3) == QLatin1String(kCachePathPrefix))) {
+        url = QUrl::fromEncoded(QByteArray::fromPercentEncoding(sections.at(sections.size() - 2).toUtf8()));
+    } else {
+        url = m_url.resolved(QUrl::fromEncoded(path.toUtf8()));
+    }
+    if (!isHttp(url)) {
+        return {};
+    }
+    return HttpCache::instance()->source(url);
+}
+
+QString HttpCacheSource::blockPath(const qint64 index) const
+{
+    return QDir(HttpCache::instance()->entryPath(m_key)).filePath(QString::number(index));
+}
+
+void HttpCacheSource::setSize(const qint64 value, const QByteArray &validator)
+{
+    m_size = value;
+    m_validator = validator;
+    const QString dirPath = HttpCache::instance()->entryPath(m_key);
+    QDir().mkpath(dirPath);
+    QSaveFile file(QDir(dirPath).filePath(QLatin1String(kSizeFileName)));
+    if (file.open(QFile::WriteOnly)) {
+        file.write(QByteArray::number(value) + '\n' + validator);
+        file.commit();
+    }
+}
+
+bool HttpCacheSource::loadBlock(const qint64 index)
+{
+    QFile file(blockPath(index));
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    m_block = file.readAll();
+    m_blockIndex = index;
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    HttpCache::instance()->touch(file.fileName());
+    return true;
+}
+
+bool HttpCacheSource::hasChanged(const QByteArray &validator) const
+{
+    return (!validator.isEmpty() && !m_validator.isEmpty() && (validator != m_validator));
+}
+
+void HttpCacheSource::invalidate(const QByteArray &validator)
+{
+    qWarning() << "HTTP cache:" << m_url << "has changed on the server, the cached blocks are dropped.";
+    HttpCache::instance()->remove(m_key);
+    // The next block tells the new size.
+    m_size = -1;
+    m_validator = validator;
+    m_blockIndex = -1;
+    m_block.clear();
+    m_unservedNetworkBytes.clear();
+}
+
+void HttpCacheSource::fetchBlock(const qint64 index)
+{
+    m_inFlight.insert(index);
+    const QWeakPointer<HttpCacheSource> self = sharedFromThis().toWeakRef();
+    HttpCache::instance()->fetch(m_url, index * kBlockSize, ((index + 1) * kBlockSize) - 1, m_validator,
+        [self, index](const QByteArray &data, const qint64 offset, const qint64 total, const QByteArray &validator,
+                      const bool ok) {
+            if (const QSharedPointer<HttpCacheSource> source = self.toStrongRef()) {
+                source->handleBlock(index, data, offset, total, validator, ok);
+            }
+        });
+}
+
+void HttpCacheSource::fetchAll()
+{
+    m_inFlight.insert(0);
+    const QWeakPointer<HttpCacheSource> self = sharedFromThis().toWeakRef();
+    HttpCache::instance()->fetch(m_url, -1, -1, {},
+        [self](const QByteArray &data, const qint64 offset, const qint64 total, const QByteArray &validator,
+               const bool ok) {
+            Q_UNUSED(offset);
+            Q_UNUSED(total);
+            Q_UNUSED(validator);
+            if (const QSharedPointer<HttpCacheSource> source = self.toStrongRef()) {
+                source->handlePlaylist(data, ok);
+            }
+        });
+}
+
+void HttpCacheSource::revalidate()
+{
+    // A single byte, If-Range turns it into the whole resource if it has
+    // changed, and that reply is aborted right away.
+    m_validating = true;
+    const QWeakPointer<HttpCacheSource> self = sharedFromThis().toWeakRef();
+    HttpCache::instance()->fetch(m_url, 0, 0, m_validator,
+        [self](const QByteArray &data, const qint64 offset, const qint64 total, const QByteArray &validator,
+               const bool ok) {
+            Q_UNUSED(data);
+            Q_UNUSED(offset);
+            if (const QSharedPointer<HttpCacheSource> source = self.toStrongRef()) {
+                source->handleValidation(total, validator, ok);
+            }
+        });
+}
+
+void HttpCacheSource::handleValidation(const qint64 total, const QByteArray &validator, const bool ok)
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_validating = false;
+        m_validated = true;
+        if (hasChanged(validator) || (ok && (total > 0) && (total != m_size))) {
+            invalidate(validator);
+        } else if (!ok) {
+            // Offline, the cached blocks are all we have.
+            qDebug() << "HTTP cache: can't revalidate" << m_url << ", using the cached blocks.";
+        }
+    }
+    notifyReady();
+}
+
+void HttpCacheSource::handleBlock(const qint64 index, const QByteArray &data, const qint64 offset,
+                                  const qint64 total, const QByteArray &validator, const bool ok)
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_inFlight.remove(index);
+        m_blockArrived.wakeAll();
+        if (hasChanged(validator)) {
+            invalidate(validator);
+        } else if (!ok || (total <= 0)) {
+            if (ok) {
+                qWarning() << "HTTP cache: the size of" << m_url << "is unknown, it can't be cached.";
+            }
+            m_failed = true;
+        } else {
+            if ((m_size != total) || (m_validator != validator)) {
+                setSize(total, validator);
+            }
+            // Usually exactly the block, the whole resource if the server
+            // ignored the range. Only complete blocks are kept.
+            for (qint64 position = offset - (offset % kBlockSize); position < (offset + data.size()); position += kBlockSize) {
+                const qint64 blockEnd = qMin(position + kBlockSize, total);
+                if ((position < offset) || (blockEnd > (offset + data.size()))) {
+                    continue;
+                }
+                const qint64 blockIndex = position / kBlockSize;
+                const QByteArray block = data.mid(position - offset, blockEnd - position);
+                if (HttpCache::instance()->store(blockPath(blockIndex), block)) {
+                    m_unservedNetworkBytes.insert(blockIndex, blockEnd - position);
+                    if (blockIndex == m_awaitedBlock) {
+                        m_block = block;
+                        m_blockIndex = blockIndex;
+                    } else if (blockIndex == m_blockIndex) {
+                        m_blockIndex = -1;
+                    }
+                } else {
+                    m_failed = true;
+                }
+            }
+        }
+    }
+    notifyReady();
+}
+
+void HttpCacheSource::handlePlaylist(const QByteArray &data, const bool ok)
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_inFlight.remove(0);
+        if (ok) {
+            m_data = rewritePlaylist(data);
+            m_size = m_data.size();
+            m_stale = false;
+        } else {
+            m_failed = true;
+        }
+    }
+    notifyReady();
+}
+
+QByteArray HttpCacheSource::rewritePlaylist(const QByteArray &data) const
+{
+    static const QRegularExpression uriAttribute(QStringLiteral("URI=\"([^\"]*)\""));
+    QList<QByteArray> lines = data.split('\n');
+    for (auto &&line : lines) {
+        const QByteArray trimmed = line.trimmed();
+        if (trimmed.isEmpty()) {
+            continue;
+        }
+        if (!trimmed.startsWith('#')) {
+            line = cacheReference(m_url, trimmed, true);
+            continue;
+        }
+        // Keys are never written to disk.
+        const bool cache = !trimmed.startsWith("#EXT-X-KEY") && !trimmed.startsWith("#EXT-X-SESSION-KEY");
+        QString tag = QString::fromUtf8(trimmed);
+        QRegularExpressionMatch match = uriAttribute.match(tag);
+        while (match.hasMatch()) {
+            const QString uri = QStringLiteral("URI=\"")
+                                + QString::fromUtf8(cacheReference(m_url, match.captured(1).toUtf8(), cache))
+                                + QLatin1Char('"');
+            tag.replace(match.capturedStart(), match.capturedLength(), uri);
+            match = uriAttribute.match(tag, match.capturedStart() + uri.size());
+        }
+        line = tag.toUtf8();
+    }
+    return lines.join('\n');
+}
+
+MDKPLAYER_END_NAMESPACE
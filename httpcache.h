@@ -0,0 +1,197 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include "mediasource.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qset.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qsharedpointer.h>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QThread)
+QT_FORWARD_DECLARE_CLASS(QNetworkAccessManager)
+QT_END_NAMESPACE
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class HttpCacheSource;
+
+// A disk cache for HTTP(S) media. Resources are fetched in blocks with
+// range requests and every block is kept on disk, so seeking back and
+// playing again read the disk instead of the network. The least recently
+// used blocks are removed once the cache grows beyond maxSize. All requests
+// go through one QNetworkAccessManager on its own thread, so its
+// persistent connections are shared by all media and playlist items.
+class MDKPLAYER_API HttpCache : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(HttpCache)
+
+    Q_PROPERTY(QString directory READ directory CONSTANT)
+    Q_PROPERTY(qint64 maxSize READ maxSize WRITE setMaxSize NOTIFY maxSizeChanged)
+    Q_PROPERTY(qint64 size READ size NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 bytesFromCache READ bytesFromCache NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 bytesFromNetwork READ bytesFromNetwork NOTIFY statisticsChanged)
+
+public:
+    // "validator" is the ETag (strong ones only) or Last-Modified of the
+    // reply, empty if there was none.
+    using FetchCallback = std::function<void(const QByteArray &data, const qint64 offset, const qint64 total,
+                                             const QByteArray &validator, const bool ok)>;
+
+    explicit HttpCache(const QString &directory, QObject *parent = nullptr);
+    ~HttpCache() override;
+
+    static HttpCache *instance();
+
+    QString directory() const;
+
+    qint64 maxSize() const;
+    void setMaxSize(const qint64 value);
+
+    qint64 size() const;
+    qint64 bytesFromCache() const;
+    qint64 bytesFromNetwork() const;
+
+    // Reuses the source of a url that is still in use.
+    QSharedPointer<MediaSource> source(const QUrl &url);
+
+    // [from, to], to < 0 means until the end, from < 0 the whole resource
+    // without a range request. With "ifRange", a resource that doesn't match
+    // that validator anymore fails right away (its new validator is still
+    // reported). The callback is invoked on the network thread.
+    void fetch(const QUrl &url, const qint64 from, const qint64 to, const QByteArray &ifRange,
+               const FetchCallback &callback);
+
+    QString entryPath(const QString &key) const;
+    // Blocks only, they are what is limited by maxSize.
+    bool store(const QString &filePath, const QByteArray &data);
+    void touch(const QString &filePath);
+    // Removes all blocks of an entry.
+    void remove(const QString &key);
+    void countServed(const qint64 fromCache, const qint64 fromNetwork);
+
+public Q_SLOTS:
+    void clear();
+
+Q_SIGNALS:
+    void maxSizeChanged();
+    void statisticsChanged();
+
+private:
+    void ensureStarted();
+    void load();
+    // Expects m_mutex to be locked.
+    void evict();
+
+private:
+    struct Block
+    {
+        qint64 size = 0;
+        quint64 lastUsed = 0;
+    };
+
+    QString m_directory = {};
+    mutable QMutex m_mutex;
+    QHash<QString, Block> m_blocks = {};
+    QHash<QUrl, QWeakPointer<MediaSource>> m_sources = {};
+    qint64 m_size = 0;
+    qint64 m_maxSize = qint64(1024) * 1024 * 1024;
+    quint64 m_useCounter = 0;
+    QAtomicInteger<qint64> m_bytesFromCache = 0;
+    QAtomicInteger<qint64> m_bytesFromNetwork = 0;
+    QThread *m_thread = nullptr;
+    QObject *m_worker = nullptr;
+    QNetworkAccessManager *m_network = nullptr;
+};
+
+// One HTTP(S) resource, cached block by block. The validator of the
+// resource is kept next to its size: cached blocks are revalidated once per
+// source and every block is requested with If-Range, so a resource that
+// changed on the server never mixes old and new blocks. Playlists (.m3u8) aren't
+// cached, a live playlist changes all the time, they are fetched again
+// whenever they are read from the start. Their segments are resolved
+// relative to them and cached like any other media.
+class MDKPLAYER_API HttpCacheSource : public MediaSource, public QEnableSharedFromThis<HttpCacheSource>
+{
+    Q_DISABLE_COPY_MOVE(HttpCacheSource)
+
+public:
+    explicit HttpCacheSource(const QUrl &url);
+    ~HttpCacheSource() override;
+
+    qint64 size() const override;
+    QByteArray read(const qint64 offset, const qint64 maxSize) override;
+    bool isReady(const qint64 offset) override;
+    QSharedPointer<MediaSource> resolve(const QString &path) override;
+
+private:
+    QString blockPath(const qint64 index) const;
+    // All of these expect m_mutex to be locked.
+    void setSize(const qint64 value, const QByteArray &validator);
+    bool loadBlock(const qint64 index);
+    bool hasChanged(const QByteArray &validator) const;
+    void invalidate(const QByteArray &validator);
+    void fetchBlock(const qint64 index);
+    void fetchAll();
+    void revalidate();
+    void handleBlock(const qint64 index, const QByteArray &data, const qint64 offset, const qint64 total,
+                     const QByteArray &validator, const bool ok);
+    void handleValidation(const qint64 total, const QByteArray &validator, const bool ok);
+    void handlePlaylist(const QByteArray &data, const bool ok);
+    QByteArray rewritePlaylist(const QByteArray &data) const;
+
+private:
+    QUrl m_url = {};
+    QString m_key = {};
+    bool m_cacheable = true;
+    mutable QMutex m_mutex;
+    qint64 m_size = -1;
+    QByteArray m_validator = {};
+    // Blocks cached by an earlier session are checked against the server first.
+    bool m_validated = true;
+    bool m_validating = false;
+    bool m_failed = false;
+    QSet<qint64> m_inFlight = {};
+    // read() waits here for a block that was evicted after isReady().
+    QWaitCondition m_blockArrived;
+    qint64 m_awaitedBlock = -1;
+    // Bytes of the blocks downloaded by this source that haven't been served yet.
+    QHash<qint64, qint64> m_unservedNetworkBytes = {};
+    qint64 m_blockIndex = -1;
+    QByteArray m_block = {};
+    // Playlists are kept in memory, m_stale once they were read to the end.
+    QByteArray m_data = {};
+    bool m_stale = false;
+};
+
+MDKPLAYER_END_NAMESPACE
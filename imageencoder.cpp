@@ -0,0 +1,176 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "imageencoder.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qthread.h>
+#include <QtGui/qimagewriter.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class ImageEncoderTask final : public QRunnable
+{
+    Q_DISABLE_COPY_MOVE(ImageEncoderTask)
+
+public:
+    explicit ImageEncoderTask(QSemaphore *slots, const QImage &image, const QString &filePath,
+                              const QString &format, const int quality, const ImageEncoder::Callback &callback)
+        : m_slots(slots), m_image(image), m_filePath(filePath), m_format(format), m_quality(quality), m_callback(callback)
+    {
+        m_timer.start();
+    }
+
+    ~ImageEncoderTask() override = default;
+
+    void run() override
+    {
+        QImageWriter writer(m_filePath, m_format.toLatin1());
+        if (m_quality >= 0) {
+            writer.setQuality(m_quality);
+        }
+        const bool ok = writer.write(m_image);
+        if (!ok) {
+            qWarning() << "Failed to write" << m_filePath << ':' << writer.errorString();
+        }
+        // Release the memory before the slot, the slot limits memory usage.
+        m_image = {};
+        m_slots->release();
+        if (m_callback) {
+            m_callback(ok, m_timer.elapsed());
+        }
+    }
+
+private:
+    QSemaphore *m_slots = nullptr;
+    QImage m_image = {};
+    QString m_filePath = {};
+    QString m_format = {};
+    int m_quality = -1;
+    ImageEncoder::Callback m_callback = nullptr;
+    QElapsedTimer m_timer;
+};
+
+ImageEncoder::ImageEncoder(const int maxThreads, const int maxPending)
+    : m_slots(qMax(1, maxPending)), m_maxPending(qMax(1, maxPending))
+{
+    m_pool.setMaxThreadCount(qMax(1, maxThreads));
+}
+
+ImageEncoder::~ImageEncoder()
+{
+    waitForDone();
+}
+
+ImageEncoder *ImageEncoder::instance()
+{
+    // Leave some cores for decoding and rendering.
+    static ImageEncoder encoder(qBound(1, QThread::idealThreadCount() / 2, 4), 32);
+    return &encoder;
+}
+
+QString ImageEncoder::normalizedFormat(const QString &format)
+{
+    const QByteArray fmt = format.toLower().toLatin1();
+    if (fmt.isEmpty() || !QImageWriter::supportedImageFormats().contains(fmt)) {
+        if (!fmt.isEmpty()) {
+            qWarning() << "Unsupported image format:" << format << ", falling back to PNG.";
+        }
+        return QStringLiteral("png");
+    }
+    return QString::fromLatin1(fmt);
+}
+
+bool ImageEncoder::tryEncode(const QImage &image, const QString &filePath, const QString &format,
+                             const int quality, const Callback &callback)
+{
+    if (!m_slots.tryAcquire()) {
+        return false;
+    }
+    start(image, filePath, format, quality, callback);
+    return true;
+}
+
+void ImageEncoder::encode(const QImage &image, const QString &filePath, const QString &format,
+                          const int quality, const Callback &callback)
+{
+    m_slots.acquire();
+    start(image, filePath, format, quality, callback);
+}
+
+int ImageEncoder::pending() const
+{
+    return (m_maxPending - m_slots.available());
+}
+
+int ImageEncoder::maxPending() const
+{
+    return m_maxPending;
+}
+
+void ImageEncoder::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+void ImageEncoder::start(const QImage &image, const QString &filePath, const QString &format,
+                         const int quality, const Callback &callback)
+{
+    const auto task = new ImageEncoderTask(&m_slots, image, filePath, normalizedFormat(format), quality, callback);
+    task->setAutoDelete(true);
+    m_pool.start(task);
+}
+
+FrameGrabResult::FrameGrabResult(QObject *parent) : QObject(parent)
+{
+}
+
+FrameGrabResult::~FrameGrabResult() = default;
+
+QImage FrameGrabResult::image() const
+{
+    return m_image;
+}
+
+qreal FrameGrabResult::frameTime() const
+{
+    return m_frameTime;
+}
+
+bool FrameGrabResult::saveToFile(const QString &fileName) const
+{
+    if (m_image.isNull() || fileName.isEmpty()) {
+        return false;
+    }
+    return m_image.save(fileName);
+}
+
+void FrameGrabResult::setResult(const QImage &image, const qreal frameTime)
+{
+    m_image = image;
+    m_frameTime = frameTime;
+    Q_EMIT ready();
+}
+
+MDKPLAYER_END_NAMESPACE
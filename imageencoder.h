@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qthreadpool.h>
+#include <QtGui/qimage.h>
+#include <functional>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// A small pool of threads that write images to disk, so that snapshots and
+// frame exports never wait for the (slow) image encoders on the thread that
+// produced the frame. The number of queued images is bounded: tryEncode()
+// gives up when the queue is full, encode() waits for a free slot instead.
+class MDKPLAYER_API ImageEncoder
+{
+    Q_DISABLE_COPY_MOVE(ImageEncoder)
+
+public:
+    // Called on a pool thread once the image has been written.
+    using Callback = std::function<void(bool ok, qint64 elapsed)>;
+
+    explicit ImageEncoder(const int maxThreads, const int maxPending);
+    ~ImageEncoder();
+
+    static ImageEncoder *instance();
+
+    // An empty or unsupported format falls back to "png".
+    static QString normalizedFormat(const QString &format);
+
+    bool tryEncode(const QImage &image, const QString &filePath, const QString &format,
+                   const int quality = -1, const Callback &callback = nullptr);
+    void encode(const QImage &image, const QString &filePath, const QString &format,
+                const int quality = -1, const Callback &callback = nullptr);
+
+    int pending() const;
+    int maxPending() const;
+
+    void waitForDone();
+
+private:
+    void start(const QImage &image, const QString &filePath, const QString &format,
+               const int quality, const Callback &callback);
+
+private:
+    QThreadPool m_pool;
+    QSemaphore m_slots;
+    const int m_maxPending = 0;
+};
+
+// The result of MDKPlayer::grabFrame(), similar to QQuickItemGrabResult.
+// "image" becomes available once "ready" has been emitted.
+class MDKPLAYER_API FrameGrabResult : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(FrameGrabResult)
+    Q_PROPERTY(QImage image READ image NOTIFY ready)
+    Q_PROPERTY(qreal frameTime READ frameTime NOTIFY ready)
+
+    friend class MDKPlayer;
+
+public:
+    explicit FrameGrabResult(QObject *parent = nullptr);
+    ~FrameGrabResult() override;
+
+    QImage image() const;
+    // In seconds, as reported by MDK.
+    qreal frameTime() const;
+
+    Q_INVOKABLE bool saveToFile(const QString &fileName) const;
+
+private:
+    void setResult(const QImage &image, const qreal frameTime);
+
+Q_SIGNALS:
+    void ready();
+
+private:
+    QImage m_image = {};
+    qreal m_frameTime = 0.0;
+};
+
+MDKPLAYER_END_NAMESPACE
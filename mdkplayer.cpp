@@ -24,14 +24,29 @@
 
 #include "mdkplayer.h"
 #include "videotexturenode.h"
+#include "historystore.h"
+#include "imageencoder.h"
+#include "dvrbuffer.h"
+#include "clipexporter.h"
+#include "decoderprobe.h"
+#include "decoderpolicy.h"
+#include "playerwarmup.h"
+#include "pipelinecache.h"
+#include "mediaserver.h"
+#include "mediasource.h"
+#include "httpcache.h"
+#include "decodescheduler.h"
 #include <QtCore/qdebug.h>
 #include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
 #include <QtCore/qfileinfo.h>
 #include <QtCore/qmimedatabase.h>
 #include <QtCore/qmimetype.h>
 #include <QtCore/qstandardpaths.h>
 #include <QtCore/qdatetime.h>
 #include <QtCore/qmath.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qfilesystemwatcher.h>
 #include <QtQuick/qquickwindow.h>
 #include <mdk/Player.h>
 
@@ -98,11 +113,118 @@ static inline QString urlToString(const QUrl &value, const bool display = false)
                                 : (display ? value.toDisplayString() : value.url()));
 }
 
+// How often the playback position is written to the history store.
+static constexpr const qint64 kHistoryInterval = 5000;
+
+// How often the growing DVR file is read. The segments themselves are as
+// long as the GOPs of the stream.
+static constexpr const qint64 kDvrPollInterval = 1000;
+
+// The recorder starts a new file this often, so that the disk usage stays
+// bounded. The stream goes on seamlessly in the next file.
+static constexpr const qint64 kDvrFileDuration = 30000;
+
+// The window the dropped frames are counted in. Long enough to ride out
+// a single stall, e.g. a network hiccup or a seek.
+static constexpr const qint64 kDecoderHealthInterval = 3000;
+
+// How often the buffer is sampled for the adaptive buffering.
+static constexpr const qint64 kBufferSampleInterval = 1000;
+
+// MDK's maximum buffer duration if only the minimum is set.
+static constexpr const qint64 kDefaultBufferLimit = 4000;
+
+// inotify doesn't work on network file systems, growing files are polled
+// as well.
+static constexpr const qint64 kTailPollInterval = 500;
+
+// How often the visibility of the item is checked, the window's exposure
+// and the ancestors' clipping have no change signals we could use.
+static constexpr const qint64 kVisibilityCheckInterval = 200;
+
+// The smallest decode scale is 1/8, FFmpeg's lowres goes no further.
+static constexpr const int kMaxDecodeScale = 8;
+// An item has to keep its size this long before the resolution is lowered,
+// or raised again through lowres, so that animations don't recreate the
+// decoder all the time.
+static constexpr const qint64 kDecodeScaleDelay = 1000;
+
+// Playback rates from which decoding every frame is a waste.
+static constexpr const qreal kSkipNonReferenceRate = 4.0;
+static constexpr const qreal kSkipToKeyFramesRate = 8.0;
+// Items smaller than this (device pixels) skip non-reference frames in
+// the Auto mode, nobody can follow the motion in them anyway.
+static constexpr const int kSkipNonReferenceArea = 240 * 135;
+
+// Live mode plays this much faster than the user's rate to catch up,
+// barely noticeable.
+static constexpr const qreal kCatchUpRate = 1.1;
+
+static inline QString expandSnapshotTemplate(const QString &value, const QString &fileName,
+                                             const qreal frameTime, const int counter)
+{
+    const qint64 ms = qRound64(frameTime * 1000.0);
+    if (value.isEmpty()) {
+        return QStringLiteral("%1_%2").arg(fileName, QString::number(ms));
+    }
+    QString result = value;
+    result.replace(QStringLiteral("${filename}"), fileName);
+    result.replace(QStringLiteral("${basename}"), QFileInfo(fileName).completeBaseName());
+    result.replace(QStringLiteral("${position}"), QString::number(ms));
+    result.replace(QStringLiteral("${time}"), QTime(0, 0).addMSecs(ms).toString(QStringLiteral("hh-mm-ss-zzz")));
+    result.replace(QStringLiteral("${datetime}"), QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-hhmmss-zzz")));
+    result.replace(QStringLiteral("${counter}"), QStringLiteral("%1").arg(counter, 4, 10, QLatin1Char('0')));
+    return result;
+}
+
 static inline MDK_NS_PREPEND(LogLevel) _MDKPlayer_MDK_LogLevel()
 {
     return static_cast<MDK_NS_PREPEND(LogLevel)>(MDK_logLevel());
 }
 
+// The largest power of two the video can be divided by and still fill
+// the view.
+static inline int decodeScaleFor(const QSize &video, const QSize &view, const bool cover)
+{
+    if (video.isEmpty() || view.isEmpty()) {
+        return 1;
+    }
+    int scale = 1;
+    while (scale < kMaxDecodeScale) {
+        const int next = scale * 2;
+        const bool wide = ((video.width() / next) >= view.width());
+        const bool tall = ((video.height() / next) >= view.height());
+        if (cover ? !(wide && tall) : !(wide || tall)) {
+            break;
+        }
+        scale = next;
+    }
+    return scale;
+}
+
+// Sets an option of the FFmpeg entries of a decoder chain, an empty value
+// removes it.
+static inline QStringList decodersWithOption(const QStringList &decoders, const QString &key, const QString &value)
+{
+    const QString prefix = key + QLatin1Char('=');
+    QStringList result = {};
+    for (auto &&decoder : qAsConst(decoders)) {
+        QStringList parts = decoder.split(QLatin1Char(':'));
+        if (parts.constFirst().compare(QStringLiteral("FFmpeg"), Qt::CaseInsensitive) == 0) {
+            for (int i = parts.size() - 1; i > 0; --i) {
+                if (parts.at(i).startsWith(prefix)) {
+                    parts.removeAt(i);
+                }
+            }
+            if (!value.isEmpty()) {
+                parts.append(prefix + value);
+            }
+        }
+        result.append(parts.join(QLatin1Char(':')));
+    }
+    return result;
+}
+
 MDKPLAYER_BEGIN_NAMESPACE
 
 VideoTextureNode *createNodePublic(MDKPlayer *item);
@@ -120,23 +242,46 @@ MDKPlayer::MDKPlayer(QQuickItem *parent) : QQuickItem(parent)
     qRegisterMetaType<AudioStreams>();
     qRegisterMetaType<MediaInfo>();
     m_player.reset(new MDK_NS_PREPEND(Player));
+    m_dvr.reset(new DvrBuffer);
+    m_dvrIngest.reset(new DvrIngest([this](const QList<DvrBuffer::Segment> &segments) {
+        // The destructor cancels the ingest, "this" is alive while we are here.
+        QMetaObject::invokeMethod(this, [this, segments]() {
+            for (auto &&segment : qAsConst(segments)) {
+                m_dvr->append(segment);
+            }
+            Q_EMIT dvrChanged();
+        }, Qt::QueuedConnection);
+    }));
     if (!m_livePreview) {
         qDebug() << "Player created.";
     }
     m_player->setRenderCallback([this](void *){
-        QMetaObject::invokeMethod(this, "update");
+        QMetaObject::invokeMethod(this, "handleNewFrame");
     });
     m_snapshotDirectory = QDir::toNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation));
     connect(this, &MDKPlayer::urlChanged, this, &MDKPlayer::fileNameChanged);
     connect(this, &MDKPlayer::urlChanged, this, &MDKPlayer::filePathChanged);
     connect(this, &MDKPlayer::positionChanged, this, &MDKPlayer::positionTextChanged);
     connect(this, &MDKPlayer::durationChanged, this, &MDKPlayer::durationTextChanged);
+    connect(this, &MDKPlayer::visibleChanged, this, &MDKPlayer::updateVisibility);
+    connect(this, &MDKPlayer::opacityChanged, this, &MDKPlayer::updateVisibility);
     initMdkHandlers();
     startTimer(50);
+    DecodeScheduler::instance()->registerPlayer(this);
 }
 
 MDKPlayer::~MDKPlayer()
 {
+    DecodeScheduler::instance()->unregisterPlayer(this);
+    if (m_syncGroup) {
+        m_syncGroup->detach(this);
+    }
+    savePosition();
+    stopDvr();
+    // The files are still cleaned up on the worker thread.
+    m_dvrIngest->cancel();
+    // Connections being served keep their sources alive.
+    unpublishMedia();
     if (!m_livePreview) {
         qDebug() << "Player destroyed.";
     }
@@ -157,6 +302,49 @@ void MDKPlayer::releaseResources()
     m_node = nullptr;
 }
 
+// Called on the gui thread whenever MDK has a new frame ready to be rendered.
+void MDKPlayer::handleNewFrame()
+{
+    if (m_hiddenState == HiddenBehavior::KeepDecoding) {
+        // The first frame after showing the item again.
+        m_skipRendering.storeRelease(0);
+    }
+    ++m_renderedFrames;
+    ++m_totalRenderedFrames;
+    if (m_decoderSwitchTimer.isValid()) {
+        m_decoderSwitchLatency = m_decoderSwitchTimer.elapsed();
+        m_decoderSwitchTimer.invalidate();
+        Q_EMIT decoderSwitchLatencyChanged();
+        if (!m_livePreview) {
+            qDebug() << "Decoder switch latency -->" << m_decoderSwitchLatency << "ms @" << m_player->position();
+        }
+    }
+    if (m_seekTimer.isValid()) {
+        m_seekLatency = m_seekTimer.elapsed();
+        m_seekTimer.invalidate();
+        Q_EMIT seekLatencyChanged();
+        if (!m_livePreview) {
+            qDebug() << "Seek latency -->" << m_seekLatency << "ms @" << m_player->position();
+        }
+    }
+    if (m_openTimer.isValid() && !m_startSeekPending) {
+        if (m_latencyMode == LatencyMode::Live) {
+            // Everything later is measured against the stream's own clock.
+            int64_t bytes = 0;
+            m_liveAnchorLatency = m_player->buffered(&bytes);
+            m_liveAnchorPosition = m_player->position();
+            m_liveClock.start();
+        }
+        m_firstFrameLatency = m_openTimer.elapsed();
+        m_openTimer.invalidate();
+        Q_EMIT firstFrameLatencyChanged();
+        if (!m_livePreview) {
+            qDebug() << "First frame -->" << m_firstFrameLatency << "ms @" << m_player->position();
+        }
+    }
+    update();
+}
+
 QSGNode *MDKPlayer::updatePaintNode(QSGNode *node, UpdatePaintNodeData *data)
 {
     Q_UNUSED(data);
@@ -175,6 +363,15 @@ QSGNode *MDKPlayer::updatePaintNode(QSGNode *node, UpdatePaintNodeData *data)
     return n;
 }
 
+void MDKPlayer::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    // Has to happen before the window's scene graph is initialized.
+    if ((change == ItemSceneChange) && value.window) {
+        PipelineCache::instance()->attach(value.window);
+    }
+}
+
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
 void MDKPlayer::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
 #else
@@ -197,17 +394,42 @@ QUrl MDKPlayer::url() const
     if (!m_player->url()) {
         return {};
     }
-    return QUrl::fromUserInput(QString::fromUtf8(m_player->url()),
-                               QCoreApplication::applicationDirPath(),
-                               QUrl::AssumeLocalFile);
+    const QUrl location = QUrl::fromUserInput(QString::fromUtf8(m_player->url()),
+                                              QCoreApplication::applicationDirPath(),
+                                              QUrl::AssumeLocalFile);
+    // Served by us, report what the user opened.
+    return m_publishedMedia.isEmpty() ? location : MediaServer::instance()->originalUrl(location);
 }
 
 void MDKPlayer::setUrl(const QUrl &value)
+{
+    qint64 startPos = m_startPosition;
+    if ((startPos <= 0) && m_rememberPosition && value.isValid() && (value != url())) {
+        startPos = qMax(qint64(0), HistoryStore::instance()->position(value));
+    }
+    // Keep the start position for the next attempt if nothing was opened.
+    if (openMedia(value, startPos, false) && (m_startPosition != 0)) {
+        m_startPosition = 0;
+        Q_EMIT startPositionChanged();
+    }
+}
+
+bool MDKPlayer::openMedia(const QUrl &value, const qint64 startPosition, const bool keyFrame,
+                          const bool reopen, const bool paused)
 {
     const QUrl now = url();
     if (now.isValid() && (value != now)) {
+        savePosition();
         Q_EMIT newHistory(now, position());
     }
+    // The buffer belongs to the media it was recorded from.
+    stopDvr();
+    if (!m_dvrKeepBuffer) {
+        m_dvrIngest->discard();
+        m_dvr->clear();
+        m_dvrLiveUrl.clear();
+        Q_EMIT dvrChanged();
+    }
     const auto realStop = [this]() -> void {
         m_player->setNextMedia(nullptr);
         m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
@@ -215,21 +437,119 @@ void MDKPlayer::setUrl(const QUrl &value)
     };
     if (value.isEmpty()) {
         realStop();
-        return;
+        unpublishMedia();
+        return false;
     }
-    if (!value.isValid() || (value == url())) {
-        return;
+    if (!value.isValid() || (!reopen && (value == url()))) {
+        return false;
     }
     realStop();
     //advance(value);
     // The first url may be the same as current url.
     m_player->setMedia(nullptr);
-    m_player->setMedia(qUtf8Printable(urlToString(value)));
+    // Everything published for the previous media goes, except "value"
+    // itself if it has just been published by openDevice() or openData().
+    for (auto it = m_publishedMedia.begin(); it != m_publishedMedia.end();) {
+        if (it.key() != value) {
+            MediaServer::instance()->unpublish(it.key());
+            it = m_publishedMedia.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    updateDecoderSelection();
+    m_player->setMedia(qUtf8Printable(mediaLocation(value)));
     Q_EMIT urlChanged();
-    m_player->prepare();
-    if (autoStart() && !livePreview()) {
+    m_openTimer.start();
+    m_startSeekPending = false;
+    ++m_openCount;
+    m_historyTimer.start();
+    m_decoderHealthTimer.start();
+    m_renderedFrames = 0;
+    m_decodeErrors = 0;
+    if (m_hiddenState != HiddenBehavior::KeepDecoding) {
+        // The active tracks are a setting of the player, not of the media.
+        m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Video, std::set<int>{0});
+        m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Audio, std::set<int>{0});
+        m_hiddenDuration += m_hiddenTimer.elapsed();
+        m_hiddenTimer.invalidate();
+        m_hiddenState = HiddenBehavior::KeepDecoding;
+        m_skipRendering.storeRelease(0);
+    }
+    if (m_decodeScaleFiltered) {
+        m_player->setProperty("video.avfilter", "");
+        m_decodeScaleFiltered = false;
+    }
+    // lowres and skip_frame are options of the decoder chain, the new media
+    // must not inherit them.
+    const bool chainOptions = ((m_decodeScale != 1) || (m_activeFrameSkip != FrameSkip::None));
+    if (m_decodeScale != 1) {
+        m_decodeScale = 1;
+        Q_EMIT decodeScaleChanged();
+    }
+    m_requestedDecodeScale = 1;
+    m_decodeScaleTimer.invalidate();
+    if (m_activeFrameSkip != FrameSkip::None) {
+        m_activeFrameSkip = FrameSkip::None;
+        Q_EMIT activeFrameSkipChanged();
+    }
+    if (chainOptions) {
+        const QStringList decoders = videoDecoderChain(plainVideoDecoders());
+        m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, qStringListToStdStringVector(decoders));
+        if (!m_selectedVideoDecoders.isEmpty() && (m_selectedVideoDecoders != decoders)) {
+            m_selectedVideoDecoders = decoders;
+            Q_EMIT selectedVideoDecodersChanged();
+        }
+    }
+    m_bufferController.reset();
+    m_bufferPosition = -1;
+    m_variantSelector.setVariants({}, 0);
+    m_stallCount = 0;
+    m_stallDuration = 0;
+    m_stallTimer.invalidate();
+    m_bufferTimer.start();
+    applyBufferRange();
+    m_liveClock.invalidate();
+    m_measuredLatency = 0;
+    setCatchingUp(false);
+    const MDK_NS_PREPEND(SeekFlag) seekFlag = keyFrame ? MDK_NS_PREPEND(SeekFlag)::Default : MDK_NS_PREPEND(SeekFlag)::FromStart;
+    if (m_seekAfterOpen && (startPosition > 0)) {
+        // The two-step path, only kept for comparison.
+        m_startSeekPending = true;
+        const quint64 openCount = m_openCount;
+        m_player->prepare(0, [this, openCount, startPosition, seekFlag](int64_t pos, bool *) -> bool {
+            if (pos < 0) {
+                return true;
+            }
+            QMetaObject::invokeMethod(this, [this, openCount, startPosition, seekFlag]() {
+                if (openCount != m_openCount) {
+                    return;
+                }
+                m_player->seek(startPosition, seekFlag, [this, openCount](int64_t) {
+                    QMetaObject::invokeMethod(this, [this, openCount]() {
+                        if (openCount == m_openCount) {
+                            m_startSeekPending = false;
+                        }
+                    }, Qt::QueuedConnection);
+                });
+            }, Qt::QueuedConnection);
+            return true;
+        });
+    } else {
+        // Let the decoder start from the requested position directly, seeking
+        // after prepare() would decode (and maybe show) the first frames in vain.
+        m_player->prepare(qMax(qint64(0), startPosition), nullptr, seekFlag);
+    }
+    if (paused) {
+        // Decodes and renders the first frame, nothing more.
+        m_player->setState(MDK_NS_PREPEND(PlaybackState)::Paused);
+    } else if (autoStart() && !livePreview()) {
         m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
     }
+    if (!m_livePreview && (startPosition > 0)) {
+        qDebug() << "Start position -->" << startPosition;
+    }
+    return true;
 }
 
 void MDKPlayer::setUrls(const QList<QUrl> &value)
@@ -301,7 +621,16 @@ QString MDKPlayer::filePath() const
 
 qint64 MDKPlayer::position() const
 {
-    return isStopped() ? 0 : m_player->position();
+    if (isStopped()) {
+        return 0;
+    }
+    if (m_hiddenState == HiddenBehavior::Suspend) {
+        // Nothing is decoded, the clock is ours.
+        const qint64 value = m_suspendedPosition
+                             + (m_suspendedPlaying ? qRound64(m_hiddenTimer.elapsed() * playbackRate()) : 0);
+        return (duration() > 0) ? qMin(value, duration()) : value;
+    }
+    return m_player->position();
 }
 
 void MDKPlayer::setPosition(const qint64 value)
@@ -487,7 +816,7 @@ void MDKPlayer::setLogLevel(const MDKPlayer::LogLevel value)
 
 qreal MDKPlayer::playbackRate() const
 {
-    return static_cast<qreal>(m_player->playbackRate());
+    return (static_cast<qreal>(m_player->playbackRate()) / rateFactor());
 }
 
 void MDKPlayer::setPlaybackRate(const qreal value)
@@ -495,11 +824,12 @@ void MDKPlayer::setPlaybackRate(const qreal value)
     if (isStopped() || (value == playbackRate())) {
         return;
     }
-    m_player->setPlaybackRate(value);
+    m_player->setPlaybackRate(value * rateFactor());
     Q_EMIT playbackRateChanged();
     if (!m_livePreview) {
         qDebug() << "Playback rate -->" << value;
     }
+    updateFrameSkip();
 }
 
 qreal MDKPlayer::aspectRatio() const
@@ -575,6 +905,73 @@ void MDKPlayer::setSnapshotTemplate(const QString &value)
     }
 }
 
+qint64 MDKPlayer::snapshotLatency() const
+{
+    return m_snapshotLatency;
+}
+
+qint64 MDKPlayer::dvrWindow() const
+{
+    return m_dvrWindow;
+}
+
+void MDKPlayer::setDvrWindow(const qint64 value)
+{
+    const qint64 val = qMax(qint64(0), value);
+    if (m_dvrWindow != val) {
+        m_dvrWindow = val;
+        // The buffer only drops a segment if the rest still covers the window.
+        m_dvr->setMaxDuration(m_dvrWindow);
+        if (m_dvrWindow <= 0) {
+            stopDvr();
+            m_dvrIngest->discard();
+            m_dvr->clear();
+        }
+        Q_EMIT dvrWindowChanged();
+        Q_EMIT dvrChanged();
+        if (!m_livePreview) {
+            qDebug() << "DVR window -->" << m_dvrWindow;
+        }
+    }
+}
+
+qint64 MDKPlayer::dvrMemoryLimit() const
+{
+    return m_dvr->maxBytes();
+}
+
+void MDKPlayer::setDvrMemoryLimit(const qint64 value)
+{
+    if (value != m_dvr->maxBytes()) {
+        m_dvr->setMaxBytes(value);
+        Q_EMIT dvrMemoryLimitChanged();
+        Q_EMIT dvrChanged();
+        if (!m_livePreview) {
+            qDebug() << "DVR memory limit -->" << m_dvr->maxBytes();
+        }
+    }
+}
+
+qint64 MDKPlayer::dvrDuration() const
+{
+    return m_dvr->duration();
+}
+
+qint64 MDKPlayer::dvrMemoryUsage() const
+{
+    return m_dvr->bytes();
+}
+
+qint64 MDKPlayer::dvrFlushLatency() const
+{
+    return m_dvrFlushLatency;
+}
+
+bool MDKPlayer::timeShifted() const
+{
+    return m_dvrLiveUrl.isValid();
+}
+
 QStringList MDKPlayer::videoMimeTypes()
 {
     return suffixesToMimeTypes(videoSuffixes());
@@ -625,7 +1022,9 @@ void MDKPlayer::setVideoDecoders(const QStringList &value)
 {
     if (m_videoDecoders != value) {
         m_videoDecoders = value.isEmpty() ? QStringList{QStringLiteral("FFmpeg")} : value;
-        m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, qStringListToStdStringVector(m_videoDecoders));
+        updateDecoderSelection();
+        // Applied in place, no need to wait for the next media.
+        switchVideoDecoders(m_videoDecoders);
         Q_EMIT videoDecodersChanged();
         if (!m_livePreview) {
             qDebug() << "Video decoders -->" << m_videoDecoders;
@@ -706,10 +1105,11 @@ void MDKPlayer::setLivePreview(const bool value)
             // And don't forget to use accurate seek.
         } else {
             // Restore everything to default.
-            m_player->setBufferRange(1000);
+            applyBufferRange();
             m_player->setMute(m_mute);
             m_player->setProperty("continue_at_end", "0");
         }
+        updateDecoderSelection();
         Q_EMIT livePreviewChanged();
     }
 }
@@ -746,187 +1146,1803 @@ MDKPlayer::MediaInfo MDKPlayer::mediaInfo() const
     return m_mediaInfo;
 }
 
-void MDKPlayer::open(const QUrl &value)
+qint64 MDKPlayer::startPosition() const
 {
-    if (!value.isValid()) {
-        return;
-    }
-    if (value != url()) {
-        setUrl(value);
-    }
-    if (!isPlaying()) {
-        play();
-    }
+    return m_startPosition;
 }
 
-void MDKPlayer::play()
+void MDKPlayer::setStartPosition(const qint64 value)
 {
-    if (!isPaused() || !url().isValid()) {
-        return;
+    const qint64 val = qMax(qint64(0), value);
+    if (m_startPosition != val) {
+        m_startPosition = val;
+        Q_EMIT startPositionChanged();
+        if (!m_livePreview) {
+            qDebug() << "Start position -->" << m_startPosition;
+        }
     }
-    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
 }
 
-void MDKPlayer::play(const QUrl &value)
+qint64 MDKPlayer::firstFrameLatency() const
 {
-    if (!value.isValid()) {
-        return;
-    }
-    const QUrl source = url();
-    if ((value == source) && !isPlaying()) {
-        play();
-    }
-    if (value != source) {
-        open(value);
-    }
+    return m_firstFrameLatency;
 }
 
-void MDKPlayer::pause()
+bool MDKPlayer::seekAfterOpen() const
 {
-    if (!isPlaying()) {
-        return;
-    }
-    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Paused);
+    return m_seekAfterOpen;
 }
 
-void MDKPlayer::stop()
+void MDKPlayer::setSeekAfterOpen(const bool value)
 {
-    if (isStopped()) {
-        return;
+    if (m_seekAfterOpen != value) {
+        m_seekAfterOpen = value;
+        Q_EMIT seekAfterOpenChanged();
     }
-    m_player->setNextMedia(nullptr);
-    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
-    m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
 }
 
-void MDKPlayer::seek(const qint64 value, const bool keyFrame)
+void MDKPlayer::warmUp(const QUrl &sample, const QStringList &decoders)
 {
-    if (isStopped() || (value == position())) {
-        return;
-    }
-    // We have to seek accurately when we are in live preview mode.
-    m_player->seek(qBound(qint64(0), value, duration()),
-                   (!keyFrame || m_livePreview) ? MDK_NS_PREPEND(SeekFlag)::FromStart
-                                                : MDK_NS_PREPEND(SeekFlag)::Default);
-    if (!m_livePreview) {
-        qDebug()
-            << "Seek -->" << value << '='
-            << qRound((static_cast<qreal>(value) / static_cast<qreal>(duration())) * 100) << '%';
-    }
+    PlayerWarmUp::instance()->start(sample, decoders);
 }
 
-void MDKPlayer::rotateImage(const int value)
+void MDKPlayer::openDevice(QIODevice *device, const QString &name, const qint64 startPosition)
 {
-    if (isStopped()) {
+    if (!device) {
         return;
     }
-    m_player->rotate(value);
-    if (!m_livePreview) {
-        qDebug() << "Rotate -->" << value;
+    const QUrl published = publishMedia(QSharedPointer<DeviceSource>::create(device, name));
+    if (published.isValid()) {
+        openMedia(published, startPosition, false);
     }
 }
 
-void MDKPlayer::scaleImage(const qreal x, const qreal y)
+void MDKPlayer::openData(const QByteArray &data, const QString &name, const qint64 startPosition)
 {
-    if (isStopped()) {
-        return;
-    }
-    m_player->scale(x, y);
-    if (!m_livePreview) {
-        qDebug() << "Scale -->" << QSizeF{x, y};
+    const QUrl published = publishMedia(QSharedPointer<BufferSource>::create(data, name));
+    if (published.isValid()) {
+        openMedia(published, startPosition, false);
     }
 }
 
-void MDKPlayer::snapshot()
+bool MDKPlayer::mappedFileIO() const
 {
-    if (isStopped()) {
-        return;
-    }
-    MDK_NS_PREPEND(Player)::SnapshotRequest snapshotRequest = {};
-    m_player->snapshot(&snapshotRequest, [this](MDK_NS_PREPEND(Player)::SnapshotRequest *ret, qreal frameTime) {
-        Q_UNUSED(ret);
-        const QString path = QStringLiteral("%1%2%3_%4.%5").arg(
-                snapshotDirectory(), QDir::separator(), fileName(), QString::number(frameTime), snapshotFormat());
+    return m_mappedFileIO;
+}
+
+void MDKPlayer::setMappedFileIO(const bool value)
+{
+    if (m_mappedFileIO != value) {
+        m_mappedFileIO = value;
+        Q_EMIT mappedFileIOChanged();
         if (!m_livePreview) {
-            qDebug() << "Taking snapshot -->" << path;
+            qDebug() << "Mapped file I/O -->" << m_mappedFileIO;
         }
-        return path.toStdString();
-    });
+    }
 }
 
-void MDKPlayer::seekBackward(const int value)
+qint64 MDKPlayer::ioWaitTime() const
 {
-    if (isStopped()) {
-        return;
-    }
-    seek(position() - qAbs(value), false);
+    const auto source = currentMediaSource();
+    return source ? source->readTime() : 0;
 }
 
-void MDKPlayer::seekForward(const int value)
+bool MDKPlayer::httpCache() const
 {
-    if (isStopped()) {
-        return;
-    }
-    seek(position() + qAbs(value), false);
+    return m_httpCache;
 }
 
-void MDKPlayer::playPrevious()
+void MDKPlayer::setHttpCache(const bool value)
 {
-    if (isStopped() || (m_urls.count() < 2)) {
-        return;
-    }
-    auto it = std::find(m_urls.cbegin(), m_urls.cend(), url());
-    if (it == m_urls.cbegin()) {
-        it = m_urls.cend();
+    if (m_httpCache != value) {
+        m_httpCache = value;
+        Q_EMIT httpCacheChanged();
+        if (!m_livePreview) {
+            qDebug() << "HTTP cache -->" << m_httpCache;
+        }
     }
-    --it;
-    play(*it);
 }
 
-void MDKPlayer::playNext()
+qint64 MDKPlayer::seekLatency() const
 {
-    if (isStopped() || (m_urls.count() < 2)) {
-        return;
-    }
-    auto it = std::find(m_urls.cbegin(), m_urls.cend(), url());
-    if (it != m_urls.cend()) {
-        ++it;
-    }
-    if (it == m_urls.cend()) {
-        it = m_urls.cbegin();
-    }
-    play(*it);
+    return m_seekLatency;
 }
 
-void MDKPlayer::startRecording(const QUrl &value, const QString &format)
+bool MDKPlayer::adaptiveBitrate() const
 {
-    if (value.isValid() && value.isLocalFile()) {
-        // If media is not loaded, recorder will start when playback starts.
-        const QString path = urlToString(value);
-        m_player->record(qUtf8Printable(path), format.isEmpty() ? nullptr : qUtf8Printable(format));
+    return m_adaptiveBitrate;
+}
+
+void MDKPlayer::setAdaptiveBitrate(const bool value)
+{
+    if (m_adaptiveBitrate != value) {
+        m_adaptiveBitrate = value;
+        selectVariant();
+        Q_EMIT adaptiveBitrateChanged();
         if (!m_livePreview) {
-            qDebug() << "Start recording -->" << path;
+            qDebug() << "Adaptive bitrate -->" << m_adaptiveBitrate;
         }
     }
 }
 
-void MDKPlayer::stopRecording()
+int MDKPlayer::currentVariant() const
 {
-    m_player->record();
-    if (!m_livePreview) {
-        qDebug() << "Recording stopped.";
+    return m_variantSelector.isAdaptive() ? m_variantSelector.currentTrack() : -1;
+}
+
+qint64 MDKPlayer::variantBitRate() const
+{
+    return m_variantSelector.currentBitRate();
+}
+
+int MDKPlayer::variantSwitchCount() const
+{
+    return m_variantSelector.switchCount();
+}
+
+qint64 MDKPlayer::estimatedThroughput() const
+{
+    return m_variantSelector.throughput();
+}
+
+// What MDK is given for "value": the url itself if MDK can open it,
+// otherwise a url of the media server.
+QString MDKPlayer::mediaLocation(const QUrl &value)
+{
+    if (m_tailMode && value.isLocalFile() && !m_livePreview) {
+        const auto source = QSharedPointer<GrowingFileSource>::create(value.toLocalFile());
+        const QUrl published = source->isValid() ? publishMedia(source, value) : QUrl{};
+        if (published.isValid()) {
+            // inotify on Linux.
+            if (!m_tailWatcher) {
+                m_tailWatcher = new QFileSystemWatcher(this);
+                connect(m_tailWatcher, &QFileSystemWatcher::fileChanged, this, [this](const QString &path) {
+                    refreshTail(path);
+                });
+            }
+            m_tailWatcher->addPath(source->filePath());
+            return published.toString();
+        }
+    }
+    if (m_mappedFileIO && value.isLocalFile() && !m_livePreview) {
+        const auto source = QSharedPointer<MappedFileSource>::create(value.toLocalFile());
+        const QUrl published = source->isValid() ? publishMedia(source, value) : QUrl{};
+        if (published.isValid()) {
+            return published.toString();
+        }
+    }
+    const QString scheme = value.scheme().toLower();
+    if (m_httpCache && ((scheme == QStringLiteral("http")) || (scheme == QStringLiteral("https")))
+            && (m_latencyMode != LatencyMode::Live) && !m_livePreview) {
+        const QUrl published = publishMedia(HttpCache::instance()->source(value), value);
+        if (published.isValid()) {
+            return published.toString();
+        }
+    }
+    if (scheme == QStringLiteral("qrc")) {
+        const QUrl published = publishMedia(QSharedPointer<DeviceSource>::create(
+            new QFile(QLatin1Char(':') + value.path()), value.fileName(), true), value);
+        if (published.isValid()) {
+            return published.toString();
+        }
     }
+    return urlToString(value);
 }
 
-void MDKPlayer::timerEvent(QTimerEvent *event)
+QUrl MDKPlayer::publishMedia(const QSharedPointer<MediaSource> &source, const QUrl &originalUrl)
 {
-    QQuickItem::timerEvent(event);
-    if (!isStopped()) {
-        Q_EMIT positionChanged();
+    const QUrl published = MediaServer::instance()->publish(source, originalUrl);
+    if (published.isValid()) {
+        m_publishedMedia.insert(published, source);
     }
+    return published;
 }
 
-void MDKPlayer::initMdkHandlers()
+QSharedPointer<MediaSource> MDKPlayer::currentMediaSource() const
+{
+    if (m_publishedMedia.isEmpty() || !m_player->url()) {
+        return {};
+    }
+    return m_publishedMedia.value(QUrl(QString::fromUtf8(m_player->url())));
+}
+
+void MDKPlayer::unpublishMedia()
+{
+    for (auto it = m_publishedMedia.cbegin(); it != m_publishedMedia.cend(); ++it) {
+        MediaServer::instance()->unpublish(it.key());
+    }
+    m_publishedMedia.clear();
+    if (m_tailWatcher && !m_tailWatcher->files().isEmpty()) {
+        m_tailWatcher->removePaths(m_tailWatcher->files());
+    }
+}
+
+bool MDKPlayer::rememberPosition() const
+{
+    return m_rememberPosition;
+}
+
+void MDKPlayer::setRememberPosition(const bool value)
+{
+    if (m_rememberPosition != value) {
+        m_rememberPosition = value;
+        Q_EMIT rememberPositionChanged();
+        if (!m_livePreview) {
+            qDebug() << "Remember position -->" << m_rememberPosition;
+        }
+    }
+}
+
+bool MDKPlayer::autoSelectDecoders() const
+{
+    return m_autoSelectDecoders;
+}
+
+void MDKPlayer::setAutoSelectDecoders(const bool value)
+{
+    if (m_autoSelectDecoders != value) {
+        m_autoSelectDecoders = value;
+        updateDecoderSelection();
+        Q_EMIT autoSelectDecodersChanged();
+        if (!m_livePreview) {
+            qDebug() << "Auto select decoders -->" << m_autoSelectDecoders;
+        }
+    }
+}
+
+QVariantList MDKPlayer::decoderPolicy() const
+{
+    return m_decoderPolicy;
+}
+
+void MDKPlayer::setDecoderPolicy(const QVariantList &value)
+{
+    if (m_decoderPolicy != value) {
+        m_decoderPolicy = value;
+        // Parsed once here, not for every media.
+        m_parsedDecoderPolicy.reset(new DecoderPolicy(DecoderPolicy::fromVariant(m_decoderPolicy)));
+        updateDecoderSelection();
+        Q_EMIT decoderPolicyChanged();
+        if (!m_livePreview) {
+            qDebug() << "Decoder policy -->" << m_decoderPolicy;
+        }
+    }
+}
+
+QStringList MDKPlayer::selectedVideoDecoders() const
+{
+    return m_selectedVideoDecoders;
+}
+
+QString MDKPlayer::activeVideoDecoder() const
+{
+    return m_activeVideoDecoder;
+}
+
+bool MDKPlayer::autoDecoderFallback() const
+{
+    return m_autoDecoderFallback;
+}
+
+void MDKPlayer::setAutoDecoderFallback(const bool value)
+{
+    if (m_autoDecoderFallback != value) {
+        m_autoDecoderFallback = value;
+        m_decodeErrors = 0;
+        m_renderedFrames = 0;
+        m_decoderHealthTimer.start();
+        Q_EMIT autoDecoderFallbackChanged();
+        if (!m_livePreview) {
+            qDebug() << "Auto decoder fallback -->" << m_autoDecoderFallback;
+        }
+    }
+}
+
+int MDKPlayer::maxDecodeErrors() const
+{
+    return m_maxDecodeErrors;
+}
+
+void MDKPlayer::setMaxDecodeErrors(const int value)
+{
+    if (m_maxDecodeErrors != value) {
+        m_maxDecodeErrors = qMax(value, 0);
+        Q_EMIT maxDecodeErrorsChanged();
+        if (!m_livePreview) {
+            qDebug() << "Max decode errors -->" << m_maxDecodeErrors;
+        }
+    }
+}
+
+qreal MDKPlayer::maxDroppedFrameRatio() const
+{
+    return m_maxDroppedFrameRatio;
+}
+
+void MDKPlayer::setMaxDroppedFrameRatio(const qreal value)
+{
+    if (!qFuzzyCompare(m_maxDroppedFrameRatio, value)) {
+        m_maxDroppedFrameRatio = qBound(0.0, value, 1.0);
+        Q_EMIT maxDroppedFrameRatioChanged();
+        if (!m_livePreview) {
+            qDebug() << "Max dropped frame ratio -->" << m_maxDroppedFrameRatio;
+        }
+    }
+}
+
+qint64 MDKPlayer::decoderSwitchLatency() const
+{
+    return m_decoderSwitchLatency;
+}
+
+void MDKPlayer::switchVideoDecoders(const QStringList &value)
+{
+    m_plainVideoDecoders = value.isEmpty() ? QStringList{QStringLiteral("FFmpeg")} : value;
+    const QStringList decoders = videoDecoderChain(m_plainVideoDecoders);
+    m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, qStringListToStdStringVector(decoders));
+    // A hidden item gets the new decoders when the video track is back.
+    if (isStopped() || !m_hasVideo || (m_hiddenState != HiddenBehavior::KeepDecoding)) {
+        return;
+    }
+    // Deselecting and reselecting the track tears the old decoder down and
+    // creates a new one from the chain, the key frame seek flushes the
+    // queued packets so the new decoder starts from a clean reference.
+    const qint64 pos = position();
+    m_decodeErrors = 0;
+    m_renderedFrames = 0;
+    m_decoderHealthTimer.start();
+    m_decoderSwitchTimer.start();
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Video, std::set<int>{});
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Video,
+                              std::set<int>{qMax(0, m_variantSelector.currentTrack())});
+    m_player->seek(pos, MDK_NS_PREPEND(SeekFlag)::Default);
+    if (m_selectedVideoDecoders != decoders) {
+        m_selectedVideoDecoders = decoders;
+        Q_EMIT selectedVideoDecodersChanged();
+    }
+    if (!m_livePreview) {
+        qDebug() << "Video decoders switched -->" << decoders << '@' << pos;
+    }
+}
+
+QStringList MDKPlayer::plainVideoDecoders() const
+{
+    if (!m_plainVideoDecoders.isEmpty()) {
+        return m_plainVideoDecoders;
+    }
+    return m_videoDecoders.isEmpty() ? defaultVideoDecoders() : m_videoDecoders;
+}
+
+// The only place the options the player manages are added to a chain:
+// lowres for the decode scale and skip_frame for the frame skip mode. Both
+// are read by FFmpeg when the decoder is opened.
+QStringList MDKPlayer::videoDecoderChain(const QStringList &value) const
+{
+    QStringList decoders = value.isEmpty() ? QStringList{QStringLiteral("FFmpeg")} : value;
+    if ((m_decodeScale > 1) && !m_decodeScaleFiltered) {
+        int level = 0;
+        while ((1 << level) < m_decodeScale) {
+            ++level;
+        }
+        decoders = decodersWithOption(decoders, QStringLiteral("lowres"), QString::number(level));
+    }
+    switch (m_activeFrameSkip) {
+    case FrameSkip::NonReference:
+        decoders = decodersWithOption(decoders, QStringLiteral("skip_frame"), QStringLiteral("noref"));
+        break;
+    case FrameSkip::KeyFrames:
+        decoders = decodersWithOption(decoders, QStringLiteral("skip_frame"), QStringLiteral("nokey"));
+        break;
+    default:
+        break;
+    }
+    return decoders;
+}
+
+void MDKPlayer::handleDecoderEvent(const QString &decoder, const bool failed)
+{
+    if (!failed) {
+        if (m_activeVideoDecoder != decoder) {
+            m_activeVideoDecoder = decoder;
+            // Let updateDecodeScale() try again with the new decoder.
+            m_requestedDecodeScale = m_decodeScale;
+            Q_EMIT activeVideoDecoderChanged();
+        }
+        return;
+    }
+    ++m_decodeErrors;
+    if (!m_livePreview) {
+        qDebug() << "Video decoder error" << m_decodeErrors << "-->" << decoder;
+    }
+    if (m_autoDecoderFallback && (m_maxDecodeErrors > 0) && (m_decodeErrors >= m_maxDecodeErrors)) {
+        fallbackVideoDecoder(QStringLiteral("%1 decode errors").arg(m_decodeErrors));
+    }
+}
+
+// Compares the frames we got with the frames the stream should have
+// delivered since the last check.
+void MDKPlayer::checkDecoderHealth()
+{
+    if (!m_decoderHealthTimer.isValid() || !m_decoderHealthTimer.hasExpired(kDecoderHealthInterval)) {
+        return;
+    }
+    const qint64 elapsed = m_decoderHealthTimer.restart();
+    const qint64 rendered = m_renderedFrames;
+    m_renderedFrames = 0;
+    if (!m_autoDecoderFallback || (m_maxDroppedFrameRatio <= 0.0) || !isPlaying() || !m_hasVideo
+            || m_decoderSwitchTimer.isValid() || m_mediaInfo.videoStreams.isEmpty()
+            || (m_hiddenState != HiddenBehavior::KeepDecoding) || (m_activeFrameSkip != FrameSkip::None)) {
+        return;
+    }
+    const qreal frameRate = m_mediaInfo.videoStreams.constFirst().frameRate;
+    if (frameRate <= 0.0) {
+        return;
+    }
+    const qreal expected = frameRate * playbackRate() * static_cast<qreal>(elapsed) / 1000.0;
+    const qreal dropped = qMax(0.0, expected - static_cast<qreal>(rendered)) / expected;
+    if (dropped > m_maxDroppedFrameRatio) {
+        fallbackVideoDecoder(QStringLiteral("%1% frames dropped").arg(qRound(dropped * 100)));
+    }
+}
+
+void MDKPlayer::fallbackVideoDecoder(const QString &reason)
+{
+    const QStringList chain = plainVideoDecoders();
+    // Drop everything up to and including the failing decoder, the options
+    // after the name don't matter.
+    const QString failing = m_activeVideoDecoder.isEmpty() ? chain.constFirst() : m_activeVideoDecoder;
+    const QString failingName = failing.section(QLatin1Char(':'), 0, 0);
+    QStringList next = chain;
+    for (int i = 0; i != chain.size(); ++i) {
+        if (chain.at(i).section(QLatin1Char(':'), 0, 0).compare(failingName, Qt::CaseInsensitive) == 0) {
+            next = chain.mid(i + 1);
+            break;
+        }
+    }
+    if (next.isEmpty() && (failingName.compare(QStringLiteral("FFmpeg"), Qt::CaseInsensitive) != 0)) {
+        // Software decoding is the last resort.
+        next.append(QStringLiteral("FFmpeg"));
+    }
+    if (next.isEmpty()) {
+        if (!m_livePreview) {
+            qWarning() << "No video decoder left to fall back to, giving up on" << failing << '(' << reason << ')';
+        }
+        return;
+    }
+    if (!m_livePreview) {
+        qDebug() << "Video decoder fallback:" << failing << '(' << reason << ") -->" << next;
+    }
+    Q_EMIT decoderFallback(failing, reason);
+    switchVideoDecoders(next);
+}
+
+bool MDKPlayer::adaptiveBuffering() const
+{
+    return m_adaptiveBuffering;
+}
+
+void MDKPlayer::setAdaptiveBuffering(const bool value)
+{
+    if (m_adaptiveBuffering != value) {
+        m_adaptiveBuffering = value;
+        m_bufferController.reset();
+        applyBufferRange();
+        Q_EMIT adaptiveBufferingChanged();
+        if (!m_livePreview) {
+            qDebug() << "Adaptive buffering -->" << m_adaptiveBuffering;
+        }
+    }
+}
+
+qint64 MDKPlayer::minBufferDuration() const
+{
+    return m_bufferController.settings().minDuration;
+}
+
+void MDKPlayer::setMinBufferDuration(const qint64 value)
+{
+    auto settings = m_bufferController.settings();
+    if (settings.minDuration != value) {
+        settings.minDuration = value;
+        m_bufferController.setSettings(settings);
+        applyBufferRange();
+        Q_EMIT minBufferDurationChanged();
+        if (!m_livePreview) {
+            qDebug() << "Min buffer duration -->" << value;
+        }
+    }
+}
+
+qint64 MDKPlayer::maxBufferDuration() const
+{
+    return m_bufferController.settings().maxDuration;
+}
+
+void MDKPlayer::setMaxBufferDuration(const qint64 value)
+{
+    auto settings = m_bufferController.settings();
+    if (settings.maxDuration != value) {
+        settings.maxDuration = value;
+        m_bufferController.setSettings(settings);
+        applyBufferRange();
+        Q_EMIT maxBufferDurationChanged();
+        if (!m_livePreview) {
+            qDebug() << "Max buffer duration -->" << value;
+        }
+    }
+}
+
+qint64 MDKPlayer::maxBufferBytes() const
+{
+    return m_bufferController.settings().maxBytes;
+}
+
+void MDKPlayer::setMaxBufferBytes(const qint64 value)
+{
+    auto settings = m_bufferController.settings();
+    if (settings.maxBytes != value) {
+        settings.maxBytes = value;
+        m_bufferController.setSettings(settings);
+        applyBufferRange();
+        Q_EMIT maxBufferBytesChanged();
+        if (!m_livePreview) {
+            qDebug() << "Max buffer bytes -->" << value;
+        }
+    }
+}
+
+qint64 MDKPlayer::bufferTarget() const
+{
+    return m_adaptiveBuffering ? m_bufferController.target() : 1000;
+}
+
+qint64 MDKPlayer::bufferedDuration() const
+{
+    return m_bufferedDuration;
+}
+
+qint64 MDKPlayer::bufferedBytes() const
+{
+    return m_bufferedBytes;
+}
+
+int MDKPlayer::stallCount() const
+{
+    return m_stallCount;
+}
+
+qint64 MDKPlayer::stallDuration() const
+{
+    return m_stallDuration;
+}
+
+void MDKPlayer::applyBufferRange()
+{
+    if (m_livePreview) {
+        return;
+    }
+    if (m_latencyMode == LatencyMode::Live) {
+        // Start as soon as something arrives and drop whatever is older than
+        // the target instead of queueing it.
+        m_player->setBufferRange(0, m_latencyTarget, true);
+    } else if (m_tailMode) {
+        // Start with whatever has been written, nothing is ever dropped.
+        m_player->setBufferRange(0, qMax(m_tailDistance * 4, kDefaultBufferLimit));
+    } else if (m_adaptiveBuffering) {
+        m_player->setBufferRange(m_bufferController.target(), m_bufferController.limit());
+    } else {
+        m_player->setBufferRange(1000);
+    }
+}
+
+void MDKPlayer::sampleBuffer()
+{
+    if (!m_bufferTimer.isValid() || !m_bufferTimer.hasExpired(kBufferSampleInterval)) {
+        return;
+    }
+    const qint64 elapsed = m_bufferTimer.restart();
+    int64_t bytes = 0;
+    m_bufferedDuration = m_player->buffered(&bytes);
+    m_bufferedBytes = bytes;
+    const qint64 pos = position();
+    // A seek or a pause isn't playback.
+    qint64 played = (m_bufferPosition < 0) ? 0 : (pos - m_bufferPosition);
+    if (!isPlaying() || (played < 0) || (played > (elapsed * qMax(playbackRate(), 1.0) * 2))) {
+        played = 0;
+    }
+    m_bufferPosition = pos;
+    if (m_adaptiveBuffering && m_bufferController.update({elapsed, m_bufferedDuration, m_bufferedBytes, played})) {
+        applyBufferRange();
+    }
+    if (isPlaying()) {
+        m_variantSelector.update({elapsed, m_bufferedDuration, m_bufferedBytes, bufferLimit(), played});
+        selectVariant();
+    }
+    Q_EMIT bufferStatisticsChanged();
+}
+
+MDKPlayer::HiddenBehavior MDKPlayer::hiddenBehavior() const
+{
+    return m_hiddenBehavior;
+}
+
+void MDKPlayer::setHiddenBehavior(const MDKPlayer::HiddenBehavior value)
+{
+    if (m_hiddenBehavior != value) {
+        m_hiddenBehavior = value;
+        updateVisibility();
+        Q_EMIT hiddenBehaviorChanged();
+        if (!m_livePreview) {
+            qDebug() << "Hidden behavior -->" << m_hiddenBehavior;
+        }
+    }
+}
+
+bool MDKPlayer::effectivelyVisible() const
+{
+    return m_effectivelyVisible;
+}
+
+qint64 MDKPlayer::hiddenDuration() const
+{
+    return m_hiddenDuration + (m_hiddenTimer.isValid() ? m_hiddenTimer.elapsed() : 0);
+}
+
+qint64 MDKPlayer::skippedRenders() const
+{
+    return m_skippedRenders.loadAcquire();
+}
+
+qint64 MDKPlayer::savedRenderTime() const
+{
+    const qint64 count = m_renderCount.loadAcquire();
+    if (count <= 0) {
+        return 0;
+    }
+    // Nanoseconds per render.
+    const qreal average = static_cast<qreal>(m_renderTime.loadAcquire()) / static_cast<qreal>(count);
+    return qRound64(m_skippedRenders.loadAcquire() * average / 1000000.0);
+}
+
+bool MDKPlayer::isEffectivelyVisible() const
+{
+    const QQuickWindow *win = window();
+    // isVisible() includes the ancestors.
+    if (!win || !win->isVisible() || !win->isExposed() || (win->visibility() == QWindow::Minimized) || !isVisible()) {
+        return false;
+    }
+    QRectF rect = mapRectToScene(boundingRect());
+    for (const QQuickItem *item = this; item; item = item->parentItem()) {
+        if (item->opacity() <= 0.0) {
+            return false;
+        }
+        if ((item != this) && item->clip()) {
+            rect &= item->mapRectToScene(item->boundingRect());
+        }
+    }
+    rect &= QRectF(QPointF(0.0, 0.0), QSizeF(win->size()));
+    return !rect.isEmpty();
+}
+
+void MDKPlayer::updateVisibility()
+{
+    const bool visible = isEffectivelyVisible();
+    if (m_effectivelyVisible != visible) {
+        m_effectivelyVisible = visible;
+        Q_EMIT effectivelyVisibleChanged();
+        if (!m_livePreview) {
+            qDebug() << "Effectively visible -->" << m_effectivelyVisible;
+        }
+    }
+    const bool hidden = !m_effectivelyVisible && !m_livePreview && !isStopped() && m_hasVideo;
+    setHiddenState(hidden ? m_hiddenBehavior : HiddenBehavior::KeepDecoding);
+    if (m_hiddenState != HiddenBehavior::KeepDecoding) {
+        Q_EMIT hiddenStatisticsChanged();
+    }
+}
+
+void MDKPlayer::setHiddenState(const MDKPlayer::HiddenBehavior value)
+{
+    if (m_hiddenState == value) {
+        return;
+    }
+    const HiddenBehavior previous = m_hiddenState;
+    // The counted one if suspended.
+    const qint64 pos = position();
+    if (previous != HiddenBehavior::KeepDecoding) {
+        m_hiddenDuration += m_hiddenTimer.elapsed();
+        m_hiddenTimer.invalidate();
+    }
+    m_hiddenState = value;
+    const std::set<int> videoTracks = {qMax(0, m_variantSelector.currentTrack())};
+    if (value == HiddenBehavior::KeepDecoding) {
+        m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Video, videoTracks);
+        if (previous == HiddenBehavior::Suspend) {
+            m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Audio, std::set<int>{0});
+        }
+        if (isStopped()) {
+            m_skipRendering.storeRelease(0);
+        } else {
+            // Accurately, so that the video continues with the frame of the
+            // position. Rendering resumes with that frame, see handleNewFrame().
+            m_player->seek(pos, MDK_NS_PREPEND(SeekFlag)::FromStart);
+        }
+        m_renderedFrames = 0;
+        m_decoderHealthTimer.start();
+    } else {
+        m_skipRendering.storeRelease(1);
+        m_hiddenTimer.start();
+        if (previous == HiddenBehavior::KeepDecoding) {
+            m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Video, std::set<int>{});
+        }
+        if (value == HiddenBehavior::Suspend) {
+            m_suspendedPosition = pos;
+            m_suspendedPlaying = isPlaying();
+            m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Audio, std::set<int>{});
+        } else if (previous == HiddenBehavior::Suspend) {
+            // The audio continues where the clock is.
+            m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Audio, std::set<int>{0});
+            m_player->seek(pos, MDK_NS_PREPEND(SeekFlag)::FromStart);
+        }
+    }
+    Q_EMIT hiddenStatisticsChanged();
+    if (!m_livePreview) {
+        qDebug() << "Hidden state -->" << m_hiddenState << '@' << pos;
+    }
+}
+
+bool MDKPlayer::adaptiveDecodeResolution() const
+{
+    return m_adaptiveDecodeResolution;
+}
+
+void MDKPlayer::setAdaptiveDecodeResolution(const bool value)
+{
+    if (m_adaptiveDecodeResolution != value) {
+        m_adaptiveDecodeResolution = value;
+        updateDecodeScale();
+        Q_EMIT adaptiveDecodeResolutionChanged();
+        if (!m_livePreview) {
+            qDebug() << "Adaptive decode resolution -->" << m_adaptiveDecodeResolution;
+        }
+    }
+}
+
+int MDKPlayer::decodeScale() const
+{
+    return m_decodeScale;
+}
+
+qint64 MDKPlayer::savedPixelRate() const
+{
+    // The scale filter runs after decoding at the full size, it only saves
+    // on the upload and the rendering.
+    if ((m_decodeScale <= 1) || m_decodeScaleFiltered || m_mediaInfo.videoStreams.isEmpty()) {
+        return 0;
+    }
+    const auto vs = m_mediaInfo.videoStreams.value(qMax(0, m_variantSelector.currentTrack()));
+    const qint64 pixels = qint64(vs.width) * qint64(vs.height);
+    return qRound64((pixels - (pixels / (m_decodeScale * m_decodeScale))) * vs.frameRate);
+}
+
+void MDKPlayer::updateDecodeScale()
+{
+    if (m_livePreview || isStopped() || !m_hasVideo || m_mediaInfo.videoStreams.isEmpty()
+            || (m_hiddenState != HiddenBehavior::KeepDecoding) || m_decoderSwitchTimer.isValid()) {
+        return;
+    }
+    int wanted = 1;
+    if (m_adaptiveDecodeResolution) {
+        const auto vs = m_mediaInfo.videoStreams.value(qMax(0, m_variantSelector.currentTrack()));
+        wanted = decodeScaleFor({vs.width, vs.height}, m_renderSize, (m_fillMode != FillMode::PreserveAspectFit));
+    }
+    if (m_qualityTier != QualityTier::Full) {
+        wanted = qMax(wanted, 2);
+    }
+    if (wanted == m_requestedDecodeScale) {
+        m_decodeScaleTimer.invalidate();
+        return;
+    }
+    // lowres recreates the decoder and resumes from a key frame, a resize
+    // animation would stutter all the way through. The filter is cheap to
+    // change.
+    const auto vs = m_mediaInfo.videoStreams.value(qMax(0, m_variantSelector.currentTrack()));
+    if ((wanted < m_requestedDecodeScale) && !hasLowres(vs.codec)) {
+        // Grown, don't let it look blurry.
+        m_decodeScaleTimer.invalidate();
+        applyDecodeScale(wanted);
+        return;
+    }
+    if (!m_decodeScaleTimer.isValid() || (m_pendingDecodeScale != wanted)) {
+        m_pendingDecodeScale = wanted;
+        m_decodeScaleTimer.start();
+    } else if (m_decodeScaleTimer.hasExpired(kDecodeScaleDelay)) {
+        m_decodeScaleTimer.invalidate();
+        applyDecodeScale(wanted);
+    }
+}
+
+bool MDKPlayer::hasLowres(const QString &codec)
+{
+    static const QStringList lowresCodecs = {QStringLiteral("mjpeg"), QStringLiteral("mpeg1video"),
+        QStringLiteral("mpeg2video"), QStringLiteral("dvvideo"), QStringLiteral("jpeg2000")};
+    return lowresCodecs.contains(codec);
+}
+
+void MDKPlayer::applyDecodeScale(const int requested)
+{
+    m_requestedDecodeScale = requested;
+    // Hardware decoders output at the coded size and their frames stay on
+    // the GPU, scaling them in software would cost more than it saves.
+    const bool software = m_activeVideoDecoder.startsWith(QStringLiteral("FFmpeg"), Qt::CaseInsensitive);
+    const int value = software ? requested : 1;
+    if (value == m_decodeScale) {
+        return;
+    }
+    const auto vs = m_mediaInfo.videoStreams.value(qMax(0, m_variantSelector.currentTrack()));
+    if (hasLowres(vs.codec)) {
+        // lowres is only read when the decoder is opened.
+        m_decodeScale = value;
+        switchVideoDecoders(plainVideoDecoders());
+    } else {
+        // The filter graph is rebuilt on the fly.
+        m_decodeScaleFiltered = (value > 1);
+        m_player->setProperty("video.avfilter", m_decodeScaleFiltered
+            ? QStringLiteral("scale=w=iw/%1:h=ih/%1").arg(value).toStdString() : std::string{});
+    }
+    m_decodeScale = value;
+    Q_EMIT decodeScaleChanged();
+    if (!m_livePreview) {
+        qDebug() << "Decode scale --> 1 /" << m_decodeScale << ", view" << m_renderSize;
+    }
+}
+
+MDKPlayer::FrameSkip MDKPlayer::frameSkip() const
+{
+    return m_frameSkip;
+}
+
+void MDKPlayer::setFrameSkip(const MDKPlayer::FrameSkip value)
+{
+    if (m_frameSkip != value) {
+        m_frameSkip = value;
+        updateFrameSkip();
+        Q_EMIT frameSkipChanged();
+        if (!m_livePreview) {
+            qDebug() << "Frame skip -->" << m_frameSkip;
+        }
+    }
+}
+
+MDKPlayer::FrameSkip MDKPlayer::activeFrameSkip() const
+{
+    return m_activeFrameSkip;
+}
+
+MDKPlayer::QualityTier MDKPlayer::qualityTier() const
+{
+    return m_qualityTier;
+}
+
+bool MDKPlayer::textureAtlas() const
+{
+    return m_textureAtlas;
+}
+
+void MDKPlayer::setTextureAtlas(const bool value)
+{
+    if (m_textureAtlas != value) {
+        m_textureAtlas = value;
+        // The node picks it up on the next sync.
+        update();
+        Q_EMIT textureAtlasChanged();
+        if (!m_livePreview) {
+            qDebug() << "Texture atlas -->" << m_textureAtlas;
+        }
+    }
+}
+
+int MDKPlayer::atlasPage() const
+{
+    return m_atlasPage;
+}
+
+SyncGroup *MDKPlayer::syncGroup() const
+{
+    return m_syncGroup;
+}
+
+void MDKPlayer::setSyncGroup(SyncGroup *value)
+{
+    if (m_syncGroup != value) {
+        if (m_syncGroup) {
+            m_syncGroup->detach(this);
+        }
+        m_syncGroup = value;
+        if (m_syncGroup) {
+            m_syncGroup->attach(this);
+        }
+        Q_EMIT syncGroupChanged();
+        if (!m_livePreview) {
+            qDebug() << "Sync group -->" << m_syncGroup;
+        }
+    }
+}
+
+void MDKPlayer::setRateTrim(const qreal value)
+{
+    if (qFuzzyCompare(m_rateTrim, value)) {
+        return;
+    }
+    const qreal rate = playbackRate();
+    m_rateTrim = value;
+    if (!isStopped()) {
+        m_player->setPlaybackRate(rate * rateFactor());
+    }
+}
+
+// The sync group trim and the live catch-up scale the user's rate, they
+// never replace it.
+qreal MDKPlayer::rateFactor() const
+{
+    return (m_rateTrim * (m_catchingUp ? kCatchUpRate : 1.0));
+}
+
+void MDKPlayer::setCatchingUp(const bool value)
+{
+    if (m_catchingUp == value) {
+        return;
+    }
+    const qreal rate = playbackRate();
+    m_catchingUp = value;
+    // Even when stopped, or the user's rate would be off by the factor.
+    m_player->setPlaybackRate(rate * rateFactor());
+}
+
+void MDKPlayer::setQualityTier(const MDKPlayer::QualityTier value)
+{
+    if (m_qualityTier != value) {
+        m_qualityTier = value;
+        updateDecodeScale();
+        updateFrameSkip();
+        Q_EMIT qualityTierChanged();
+        if (!m_livePreview) {
+            qDebug() << "Quality tier -->" << m_qualityTier;
+        }
+    }
+}
+
+void MDKPlayer::updateFrameSkip()
+{
+    if (m_livePreview || isStopped() || !m_hasVideo || (m_hiddenState != HiddenBehavior::KeepDecoding)
+            || m_decoderSwitchTimer.isValid()) {
+        return;
+    }
+    FrameSkip wanted = m_frameSkip;
+    if (wanted == FrameSkip::Auto) {
+        const qreal rate = qAbs(playbackRate());
+        if (rate >= kSkipToKeyFramesRate) {
+            wanted = FrameSkip::KeyFrames;
+        } else if ((rate >= kSkipNonReferenceRate)
+                   || (!m_renderSize.isEmpty() && ((m_renderSize.width() * m_renderSize.height()) < kSkipNonReferenceArea))) {
+            wanted = FrameSkip::NonReference;
+        } else {
+            wanted = FrameSkip::None;
+        }
+    }
+    // The values are ordered from skipping nothing to skipping the most.
+    if ((m_qualityTier == QualityTier::KeyFramesOnly) && (wanted < FrameSkip::KeyFrames)) {
+        wanted = FrameSkip::KeyFrames;
+    } else if ((m_qualityTier == QualityTier::ReducedFrameRate) && (wanted < FrameSkip::NonReference)) {
+        wanted = FrameSkip::NonReference;
+    }
+    // MDK's hardware decoders have no such option.
+    if ((wanted != FrameSkip::None) && !m_activeVideoDecoder.startsWith(QStringLiteral("FFmpeg"), Qt::CaseInsensitive)) {
+        wanted = FrameSkip::None;
+    }
+    if (wanted == m_activeFrameSkip) {
+        return;
+    }
+    m_activeFrameSkip = wanted;
+    // Reopening costs a key frame seek, only pay it when the decoders
+    // really get different options.
+    if (videoDecoderChain(plainVideoDecoders()) != m_selectedVideoDecoders) {
+        switchVideoDecoders(plainVideoDecoders());
+    }
+    Q_EMIT activeFrameSkipChanged();
+    if (!m_livePreview) {
+        qDebug() << "Active frame skip -->" << m_activeFrameSkip;
+    }
+}
+
+qint64 MDKPlayer::bufferLimit() const
+{
+    if (m_latencyMode == LatencyMode::Live) {
+        return m_latencyTarget;
+    }
+    if (m_tailMode) {
+        return qMax(m_tailDistance * 4, kDefaultBufferLimit);
+    }
+    return m_adaptiveBuffering ? m_bufferController.limit() : kDefaultBufferLimit;
+}
+
+// Switches the variant of an adaptive stream if VariantSelector says so.
+// FFmpeg starts downloading the new variant with its next segment and the
+// old one plays until then, so there's no gap.
+void MDKPlayer::selectVariant()
+{
+    if (!m_adaptiveBitrate || m_livePreview || isStopped() || !m_variantSelector.isAdaptive()
+            || (m_hiddenState != HiddenBehavior::KeepDecoding)) {
+        return;
+    }
+    const int from = m_variantSelector.currentTrack();
+    const int to = m_variantSelector.select(m_renderSize, (m_fillMode != FillMode::PreserveAspectFit));
+    if ((to < 0) || (to == from)) {
+        return;
+    }
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Video, std::set<int>{to});
+    m_variantSelector.switched(to);
+    Q_EMIT variantChanged();
+    qDebug() << "Variant -->" << from << "->" << to << '@' << m_variantSelector.currentBitRate() << "bps, view"
+             << m_renderSize << ", throughput" << m_variantSelector.throughput() << "bps, buffered"
+             << m_bufferedDuration << "ms";
+}
+
+// Called when MDK starts and finishes buffering in the middle of playback.
+void MDKPlayer::handleStall(const bool begin)
+{
+    if (begin) {
+        if (m_stallTimer.isValid()) {
+            return;
+        }
+        m_stallTimer.start();
+        ++m_stallCount;
+        int64_t bytes = 0;
+        const qint64 buffered = m_player->buffered(&bytes);
+        if (m_adaptiveBuffering && m_bufferController.stalled(buffered)) {
+            applyBufferRange();
+        }
+        if (!m_livePreview) {
+            qDebug() << "Stalled" << m_stallCount << "times, buffered" << buffered << "ms.";
+        }
+    } else {
+        if (!m_stallTimer.isValid()) {
+            return;
+        }
+        m_stallDuration += m_stallTimer.elapsed();
+        m_stallTimer.invalidate();
+    }
+    Q_EMIT bufferStatisticsChanged();
+}
+
+MDKPlayer::LatencyMode MDKPlayer::latencyMode() const
+{
+    return m_latencyMode;
+}
+
+void MDKPlayer::setLatencyMode(const MDKPlayer::LatencyMode value)
+{
+    if (m_latencyMode != value) {
+        m_latencyMode = value;
+        applyLatencyMode();
+        Q_EMIT latencyModeChanged();
+        if (!m_livePreview) {
+            qDebug() << "Latency mode -->" << m_latencyMode;
+        }
+    }
+}
+
+qint64 MDKPlayer::latencyTarget() const
+{
+    return m_latencyTarget;
+}
+
+void MDKPlayer::setLatencyTarget(const qint64 value)
+{
+    if (m_latencyTarget != value) {
+        m_latencyTarget = qMax(value, qint64(0));
+        applyBufferRange();
+        Q_EMIT latencyTargetChanged();
+        if (!m_livePreview) {
+            qDebug() << "Latency target -->" << m_latencyTarget;
+        }
+    }
+}
+
+qint64 MDKPlayer::maxLatency() const
+{
+    return m_maxLatency;
+}
+
+void MDKPlayer::setMaxLatency(const qint64 value)
+{
+    if (m_maxLatency != value) {
+        m_maxLatency = qMax(value, qint64(0));
+        Q_EMIT maxLatencyChanged();
+        if (!m_livePreview) {
+            qDebug() << "Max latency -->" << m_maxLatency;
+        }
+    }
+}
+
+qint64 MDKPlayer::measuredLatency() const
+{
+    return m_measuredLatency;
+}
+
+int MDKPlayer::catchUpCount() const
+{
+    return m_catchUpCount;
+}
+
+int MDKPlayer::liveResetCount() const
+{
+    return m_liveResetCount;
+}
+
+void MDKPlayer::applyLatencyMode()
+{
+    // A growing file is read like a live stream.
+    const bool live = ((m_latencyMode == LatencyMode::Live) || m_tailMode);
+    // FFmpeg demuxer options, used by the next media. MDK can't unset a
+    // property, leaving live mode writes FFmpeg's defaults back instead.
+    if (live != m_liveDemuxerOptions) {
+        m_liveDemuxerOptions = live;
+        m_player->setProperty("avformat.fflags", live ? "+nobuffer" : "autobsf");
+        m_player->setProperty("avformat.probesize", live ? "32768" : "5000000");
+        m_player->setProperty("avformat.analyzeduration", live ? "100000" : "0");
+        m_player->setProperty("avformat.max_delay", live ? "0" : "-1");
+    }
+    if (!live) {
+        setCatchingUp(false);
+    }
+    m_liveClock.invalidate();
+    applyBufferRange();
+}
+
+void MDKPlayer::checkLiveLatency()
+{
+    if ((m_latencyMode != LatencyMode::Live) || !m_liveClock.isValid() || !isPlaying()) {
+        return;
+    }
+    const qint64 behind = m_liveClock.elapsed() - (position() - m_liveAnchorPosition);
+    const qint64 latency = qMax(qint64(0), m_liveAnchorLatency + behind);
+    if (latency != m_measuredLatency) {
+        m_measuredLatency = latency;
+        Q_EMIT liveStatisticsChanged();
+    }
+    if ((m_maxLatency > 0) && (latency > m_maxLatency)) {
+        // Too far behind to catch up in reasonable time, start over from the live edge.
+        ++m_liveResetCount;
+        setCatchingUp(false);
+        m_liveClock.invalidate();
+        m_openTimer.start();
+        m_player->prepare();
+        m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
+        Q_EMIT liveReset(latency);
+        Q_EMIT liveStatisticsChanged();
+        if (!m_livePreview) {
+            qDebug() << "Live latency" << latency << "ms exceeds" << m_maxLatency << "ms, reset.";
+        }
+        return;
+    }
+    catchUpTo(latency, m_latencyTarget);
+}
+
+void MDKPlayer::checkTailLatency()
+{
+    if (!m_tailMode) {
+        return;
+    }
+    if (!m_tailPollTimer.isValid() || m_tailPollTimer.hasExpired(kTailPollInterval)) {
+        m_tailPollTimer.start();
+        refreshTail({});
+    }
+    const auto source = currentMediaSource().dynamicCast<GrowingFileSource>();
+    if (!source || !isPlaying()) {
+        return;
+    }
+    int64_t bytes = 0;
+    const qint64 latency = m_player->buffered(&bytes) + source->backlog();
+    // The end of the file is as far as the media goes for now.
+    const qint64 head = position() + latency;
+    if (head > m_mediaInfo.duration) {
+        m_mediaInfo.duration = head;
+        Q_EMIT durationChanged();
+    }
+    if (latency != m_measuredLatency) {
+        m_measuredLatency = latency;
+        Q_EMIT liveStatisticsChanged();
+    }
+    catchUpTo(latency, m_tailDistance);
+}
+
+void MDKPlayer::catchUpTo(const qint64 latency, const qint64 target)
+{
+    // Some hysteresis, or we would toggle the rate all the time.
+    if (!m_catchingUp && (latency > (target + target / 2))) {
+        setCatchingUp(true);
+        ++m_catchUpCount;
+        Q_EMIT catchUp(latency);
+        Q_EMIT liveStatisticsChanged();
+        if (!m_livePreview) {
+            qDebug() << "Latency" << latency << "ms, catching up.";
+        }
+    } else if (m_catchingUp && (latency <= target)) {
+        setCatchingUp(false);
+        if (!m_livePreview) {
+            qDebug() << "Latency" << latency << "ms, caught up.";
+        }
+    }
+}
+
+// An empty path refreshes all growing files.
+void MDKPlayer::refreshTail(const QString &filePath)
+{
+    for (auto it = m_publishedMedia.cbegin(); it != m_publishedMedia.cend(); ++it) {
+        const auto source = it.value().dynamicCast<GrowingFileSource>();
+        if (source && (filePath.isEmpty() || (source->filePath() == filePath))) {
+            source->refresh();
+        }
+    }
+}
+
+bool MDKPlayer::tailMode() const
+{
+    return m_tailMode;
+}
+
+void MDKPlayer::setTailMode(const bool value)
+{
+    if (m_tailMode != value) {
+        m_tailMode = value;
+        applyLatencyMode();
+        Q_EMIT tailModeChanged();
+        if (!m_livePreview) {
+            qDebug() << "Tail mode -->" << m_tailMode;
+        }
+    }
+}
+
+qint64 MDKPlayer::tailDistance() const
+{
+    return m_tailDistance;
+}
+
+void MDKPlayer::setTailDistance(const qint64 value)
+{
+    if (m_tailDistance != value) {
+        m_tailDistance = value;
+        applyBufferRange();
+        Q_EMIT tailDistanceChanged();
+        if (!m_livePreview) {
+            qDebug() << "Tail distance -->" << m_tailDistance;
+        }
+    }
+}
+
+// Called on the gui thread whenever an input of selectVideoDecoders() changes.
+void MDKPlayer::updateDecoderSelection()
+{
+    DecoderSelection selection = {};
+    selection.configured = m_videoDecoders.isEmpty() ? defaultVideoDecoders() : m_videoDecoders;
+    selection.policy = m_parsedDecoderPolicy;
+    selection.autoSelect = m_autoSelectDecoders;
+    selection.livePreview = m_livePreview;
+    const QMutexLocker locker(&m_decoderSelectionMutex);
+    m_decoderSelection = selection;
+}
+
+// Called from MDK's thread once the media info is available.
+void MDKPlayer::selectVideoDecoders()
+{
+    if (m_mediaInfo.videoStreams.isEmpty()) {
+        return;
+    }
+    DecoderSelection selection = {};
+    {
+        const QMutexLocker locker(&m_decoderSelectionMutex);
+        selection = m_decoderSelection;
+    }
+    const QStringList configured = selection.configured.isEmpty() ? defaultVideoDecoders() : selection.configured;
+    const auto &vs = m_mediaInfo.videoStreams.constFirst();
+    QStringList decoders = {};
+    QString reason = {};
+    const int rule = selection.policy ? selection.policy->match(vs) : -1;
+    if (rule >= 0) {
+        decoders = selection.policy->decoders(rule);
+        reason = QStringLiteral("policy rule #%1").arg(rule);
+    } else if (selection.autoSelect) {
+        const QString key = DecoderProbe::streamKey(vs.codec, vs.profile, vs.bitDepth);
+        const QStringList ranked = DecoderProbe::instance()->rankedDecoders(key);
+        if (ranked.isEmpty()) {
+            // Measure it for the next time, a sample of the real media is the
+            // best test clip. MDK's url, url() belongs to the gui thread.
+            const QUrl source = QUrl::fromUserInput(QString::fromUtf8(m_player->url()),
+                                                    QCoreApplication::applicationDirPath(),
+                                                    QUrl::AssumeLocalFile);
+            if (source.isLocalFile()) {
+                QMetaObject::invokeMethod(DecoderProbe::instance(), [source, configured]() {
+                    DecoderProbe::instance()->probe({source}, configured);
+                }, Qt::QueuedConnection);
+            }
+        } else {
+            // Only the decoders the user allowed, the unmeasured ones are kept as fallbacks.
+            for (auto &&decoder : qAsConst(ranked)) {
+                if (configured.contains(decoder)) {
+                    decoders.append(decoder);
+                }
+            }
+            for (auto &&decoder : qAsConst(configured)) {
+                if (!decoders.contains(decoder)) {
+                    decoders.append(decoder);
+                }
+            }
+            reason = QStringLiteral("measured %1").arg(key);
+        }
+    }
+    if (decoders.isEmpty()) {
+        decoders = configured;
+        reason = QStringLiteral("configured");
+    }
+    // Always, the chain of the previous media may still be set.
+    m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video, qStringListToStdStringVector(decoders));
+    QMetaObject::invokeMethod(this, [this, decoders]() {
+        // Nothing is added to a new media's chain yet.
+        m_plainVideoDecoders = decoders;
+        if (m_selectedVideoDecoders != decoders) {
+            m_selectedVideoDecoders = decoders;
+            Q_EMIT selectedVideoDecodersChanged();
+        }
+    }, Qt::QueuedConnection);
+    if (!selection.livePreview) {
+        qDebug() << "Video decoders for" << vs.codec << vs.width << 'x' << vs.height << '@' << vs.frameRate
+                 << "fps (" << reason << ") -->" << decoders;
+    }
+}
+
+qint64 MDKPlayer::savedPosition(const QUrl &value) const
+{
+    return HistoryStore::instance()->position(value);
+}
+
+void MDKPlayer::savePosition()
+{
+    if (!m_rememberPosition || m_livePreview || isStopped()) {
+        return;
+    }
+    // The end handler has removed it, stop() or the destructor must not
+    // bring it back.
+    if (MDK_NS_PREPEND(test_flag)(static_cast<MDK_NS_PREPEND(MediaStatus)>(m_mediaStatus) & MDK_NS_PREPEND(MediaStatus)::End)) {
+        return;
+    }
+    const QUrl now = url();
+    if (!now.isValid()) {
+        return;
+    }
+    HistoryStore::instance()->setPosition(now, position());
+    m_historyTimer.start();
+}
+
+void MDKPlayer::open(const QUrl &value)
+{
+    if (!value.isValid()) {
+        return;
+    }
+    if (value != url()) {
+        setUrl(value);
+    }
+    if (!isPlaying()) {
+        play();
+    }
+}
+
+void MDKPlayer::open(const QUrl &value, const qint64 startPosition, const bool keyFrame)
+{
+    if (!value.isValid()) {
+        return;
+    }
+    if (value != url()) {
+        openMedia(value, startPosition, keyFrame);
+    } else {
+        seek(startPosition, keyFrame);
+    }
+    if (!isPlaying()) {
+        play();
+    }
+}
+
+void MDKPlayer::preload(const QUrl &value)
+{
+    if (!value.isValid()) {
+        return;
+    }
+    const qint64 startPos = m_rememberPosition ? qMax(qint64(0), HistoryStore::instance()->position(value)) : 0;
+    openMedia(value, startPos, false, true, true);
+    if (!m_livePreview) {
+        qDebug() << "Preload -->" << value;
+    }
+}
+
+void MDKPlayer::play()
+{
+    if (!isPaused() || !url().isValid()) {
+        return;
+    }
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
+}
+
+void MDKPlayer::play(const QUrl &value)
+{
+    if (!value.isValid()) {
+        return;
+    }
+    const QUrl source = url();
+    if ((value == source) && !isPlaying()) {
+        play();
+    }
+    if (value != source) {
+        open(value);
+    }
+}
+
+void MDKPlayer::pause()
+{
+    if (!isPlaying()) {
+        return;
+    }
+    savePosition();
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Paused);
+}
+
+void MDKPlayer::stop()
+{
+    if (isStopped()) {
+        return;
+    }
+    savePosition();
+    stopDvr();
+    m_player->setNextMedia(nullptr);
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+}
+
+void MDKPlayer::seek(const qint64 value, const bool keyFrame)
+{
+    if (isStopped() || (value == position())) {
+        return;
+    }
+    m_seekTimer.start();
+    // We have to seek accurately when we are in live preview mode.
+    m_player->seek(qBound(qint64(0), value, duration()),
+                   (!keyFrame || m_livePreview) ? MDK_NS_PREPEND(SeekFlag)::FromStart
+                                                : MDK_NS_PREPEND(SeekFlag)::Default);
+    if (!m_livePreview) {
+        qDebug()
+            << "Seek -->" << value << '='
+            << qRound((static_cast<qreal>(value) / static_cast<qreal>(duration())) * 100) << '%';
+    }
+}
+
+void MDKPlayer::rotateImage(const int value)
+{
+    if (isStopped()) {
+        return;
+    }
+    m_player->rotate(value);
+    if (!m_livePreview) {
+        qDebug() << "Rotate -->" << value;
+    }
+}
+
+void MDKPlayer::scaleImage(const qreal x, const qreal y)
+{
+    if (isStopped()) {
+        return;
+    }
+    m_player->scale(x, y);
+    if (!m_livePreview) {
+        qDebug() << "Scale -->" << QSizeF{x, y};
+    }
+}
+
+void MDKPlayer::snapshot()
+{
+    if (isStopped()) {
+        return;
+    }
+    const QPointer<MDKPlayer> guard(this);
+    const QString directory = snapshotDirectory();
+    const QString format = ImageEncoder::normalizedFormat(m_snapshotFormat);
+    const QString nameTemplate = m_snapshotTemplate;
+    const QString name = fileName();
+    const int counter = ++m_snapshotCounter;
+    const bool verbose = !m_livePreview;
+    requestFrame([=](const QImage &image, const qreal frameTime) {
+        if (image.isNull()) {
+            qWarning() << "Failed to take snapshot.";
+            return;
+        }
+        const QString path = QStringLiteral("%1%2%3.%4").arg(directory, QDir::separator(),
+                expandSnapshotTemplate(nameTemplate, name, frameTime, counter), format);
+        if (verbose) {
+            qDebug() << "Taking snapshot -->" << path;
+        }
+        const bool queued = ImageEncoder::instance()->tryEncode(image, path, format, -1, [guard, path](const bool ok, const qint64 elapsed) {
+            if (!ok) {
+                return;
+            }
+            const auto player = guard.data();
+            if (!player) {
+                return;
+            }
+            QMetaObject::invokeMethod(player, [guard, path, elapsed]() {
+                if (guard) {
+                    guard->handleSnapshotTaken(path, elapsed);
+                }
+            }, Qt::QueuedConnection);
+        });
+        if (!queued) {
+            qWarning() << "Too many snapshots are pending, dropping" << path;
+        }
+    });
+}
+
+FrameGrabResult *MDKPlayer::grabFrame()
+{
+    if (isStopped()) {
+        return nullptr;
+    }
+    const auto result = new FrameGrabResult;
+    const QPointer<FrameGrabResult> guard(result);
+    requestFrame([guard](const QImage &image, const qreal frameTime) {
+        const auto r = guard.data();
+        if (!r) {
+            return;
+        }
+        QMetaObject::invokeMethod(r, [guard, image, frameTime]() {
+            if (guard) {
+                guard->setResult(image, frameTime);
+            }
+        }, Qt::QueuedConnection);
+    });
+    return result;
+}
+
+void MDKPlayer::requestFrame(const std::function<void(const QImage &, const qreal)> &callback)
+{
+    MDK_NS_PREPEND(Player)::SnapshotRequest snapshotRequest = {};
+    m_player->snapshot(&snapshotRequest, [callback](MDK_NS_PREPEND(Player)::SnapshotRequest *ret, qreal frameTime) {
+        // We are on the render thread here: copy the pixels and get out of the
+        // way, encoding is done by the encoder pool.
+        if (ret && ret->data && (ret->width > 0) && (ret->height > 0)) {
+            const int stride = (ret->stride > 0) ? ret->stride : (ret->width * 4);
+            const QImage image(ret->data, ret->width, ret->height, stride, QImage::Format_RGBA8888);
+            callback(image.copy(), frameTime);
+        } else {
+            callback({}, frameTime);
+        }
+        // An empty path tells MDK not to save the image itself.
+        return std::string{};
+    });
+}
+
+void MDKPlayer::handleSnapshotTaken(const QString &filePath, const qint64 latency)
+{
+    m_snapshotLatency = latency;
+    Q_EMIT snapshotLatencyChanged();
+    Q_EMIT snapshotTaken(filePath);
+    if (!m_livePreview) {
+        qDebug() << "Snapshot saved -->" << filePath << "in" << latency << "ms";
+    }
+}
+
+void MDKPlayer::seekBackward(const int value)
+{
+    if (isStopped()) {
+        return;
+    }
+    seek(position() - qAbs(value), false);
+}
+
+void MDKPlayer::seekForward(const int value)
+{
+    if (isStopped()) {
+        return;
+    }
+    seek(position() + qAbs(value), false);
+}
+
+void MDKPlayer::playPrevious()
+{
+    if (isStopped() || (m_urls.count() < 2)) {
+        return;
+    }
+    auto it = std::find(m_urls.cbegin(), m_urls.cend(), url());
+    if (it == m_urls.cbegin()) {
+        it = m_urls.cend();
+    }
+    --it;
+    play(*it);
+}
+
+void MDKPlayer::playNext()
+{
+    if (isStopped() || (m_urls.count() < 2)) {
+        return;
+    }
+    auto it = std::find(m_urls.cbegin(), m_urls.cend(), url());
+    if (it != m_urls.cend()) {
+        ++it;
+    }
+    if (it == m_urls.cend()) {
+        it = m_urls.cbegin();
+    }
+    play(*it);
+}
+
+void MDKPlayer::startRecording(const QUrl &value, const QString &format)
+{
+    if (value.isValid() && value.isLocalFile()) {
+        // There's only one recorder, the DVR buffer pauses until we are done.
+        stopDvr();
+        m_recording = true;
+        // If media is not loaded, recorder will start when playback starts.
+        const QString path = urlToString(value);
+        m_player->record(qUtf8Printable(path), format.isEmpty() ? nullptr : qUtf8Printable(format));
+        if (!m_livePreview) {
+            qDebug() << "Start recording -->" << path;
+        }
+    }
+}
+
+void MDKPlayer::stopRecording()
+{
+    m_recording = false;
+    m_player->record();
+    if (!m_livePreview) {
+        qDebug() << "Recording stopped.";
+    }
+}
+
+void MDKPlayer::timerEvent(QTimerEvent *event)
+{
+    QQuickItem::timerEvent(event);
+    if (!isStopped()) {
+        Q_EMIT positionChanged();
+        if (isPlaying() && m_historyTimer.isValid() && m_historyTimer.hasExpired(kHistoryInterval)) {
+            savePosition();
+        }
+    }
+    updateDvr();
+    checkDecoderHealth();
+    if (!isStopped()) {
+        sampleBuffer();
+        checkLiveLatency();
+        checkTailLatency();
+    }
+    if (!m_visibilityTimer.isValid() || m_visibilityTimer.hasExpired(kVisibilityCheckInterval)) {
+        m_visibilityTimer.start();
+        updateVisibility();
+    }
+    updateDecodeScale();
+    updateFrameSkip();
+}
+
+bool MDKPlayer::saveReplay(const QUrl &value, const qint64 duration)
+{
+    if (!value.isValid() || !value.isLocalFile()) {
+        return false;
+    }
+    // Whatever the worker has delivered so far: the open GOP and up to
+    // kDvrPollInterval of data are not in the buffer yet.
+    if (m_dvr->isEmpty()) {
+        return false;
+    }
+    const qint64 to = m_dvr->endTime();
+    const qint64 from = (duration < 0) ? m_dvr->startTime() : (to - duration);
+    const QString path = urlToString(value);
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = (m_dvr->write(path, from, to) >= 0);
+    m_dvrFlushLatency = timer.elapsed();
+    Q_EMIT dvrChanged();
+    if (!m_livePreview) {
+        qDebug() << "Save replay -->" << path << (ok ? "done in" : "failed after") << m_dvrFlushLatency << "ms";
+    }
+    return ok;
+}
+
+bool MDKPlayer::replay(const qint64 offset)
+{
+    if (m_dvr->isEmpty()) {
+        return false;
+    }
+    const QString path = QDir::temp().filePath(QStringLiteral("mdkplayer_replay_%1.ts").arg(QString::number(quintptr(this), 16)));
+    const qint64 target = qMax(m_dvr->startTime(), m_dvr->endTime() - qAbs(offset));
+    const qint64 begin = m_dvr->write(path, m_dvr->startTime(), m_dvr->endTime());
+    if (begin < 0) {
+        return false;
+    }
+    if (!m_dvrLiveUrl.isValid()) {
+        m_dvrLiveUrl = url();
+    }
+    const QUrl replayUrl = QUrl::fromLocalFile(path);
+    // Reopen even if we are replaying already, the file has changed.
+    m_dvrKeepBuffer = true;
+    if (replayUrl == url()) {
+        stop();
+    }
+    openMedia(replayUrl, target - begin, false);
+    m_dvrKeepBuffer = false;
+    Q_EMIT dvrChanged();
+    if (!m_livePreview) {
+        qDebug() << "Replay -->" << offset << "ms before live";
+    }
+    return true;
+}
+
+ClipExportJob *MDKPlayer::exportClip(const QUrl &source, const qint64 start, const qint64 end,
+                                     const QUrl &destination, const QString &format)
+{
+    return ClipExporter::instance()->exportClip(source.isValid() ? source : url(), start, end, destination, format);
+}
+
+void MDKPlayer::returnToLive()
+{
+    if (!m_dvrLiveUrl.isValid()) {
+        return;
+    }
+    const QUrl live = m_dvrLiveUrl;
+    m_dvrLiveUrl.clear();
+    openMedia(live, 0, false);
+    Q_EMIT dvrChanged();
+}
+
+void MDKPlayer::updateDvr()
+{
+    if (!m_dvrPollTimer.isValid() || m_dvrPollTimer.hasExpired(kDvrPollInterval)) {
+        m_dvrPollTimer.start();
+        DvrIngest::schedule(m_dvrIngest);
+    }
+    // Never record the replay itself.
+    if ((m_dvrWindow <= 0) || m_recording || m_dvrLiveUrl.isValid() || !isPlaying()) {
+        return;
+    }
+    if (m_dvrFile.isEmpty() || m_dvrTimer.hasExpired(kDvrFileDuration)) {
+        rotateDvrFile();
+    }
+}
+
+void MDKPlayer::rotateDvrFile()
+{
+    if (!m_dvrFile.isEmpty()) {
+        m_player->record();
+        // The worker reads the rest once the recorder has flushed it.
+        m_dvrIngest->closeFile(false);
+    }
+    // MPEG-TS files can be concatenated byte by byte, the worker cuts them
+    // into segments at the key frames.
+    m_dvrFile = QDir::temp().filePath(QStringLiteral("mdkplayer_dvr_%1_%2.ts").arg(
+        QString::number(quintptr(this), 16), QString::number(++m_dvrCounter)));
+    m_dvrIngest->addFile(m_dvrFile, position());
+    m_player->record(qUtf8Printable(m_dvrFile), "mpegts");
+    m_dvrTimer.start();
+}
+
+void MDKPlayer::stopDvr()
+{
+    if (m_dvrFile.isEmpty()) {
+        return;
+    }
+    m_player->record();
+    m_dvrIngest->closeFile(true);
+    DvrIngest::schedule(m_dvrIngest);
+    m_dvrFile.clear();
+    m_dvrTimer.invalidate();
+}
+
+void MDKPlayer::initMdkHandlers()
 {
     MDK_NS_PREPEND(setLogHandler)([this](MDK_NS_PREPEND(LogLevel) level, const char *msg) {
         const QString prefix = (m_livePreview ? QStringLiteral("[PREVIEW]") : QStringLiteral("[MAIN]")) + objectName();
@@ -983,6 +2999,8 @@ void MDKPlayer::initMdkHandlers()
                     vsinfo.format = QString::fromUtf8(codec.format_name);
                     vsinfo.width = codec.width;
                     vsinfo.height = codec.height;
+                    vsinfo.profile = codec.profile;
+                    vsinfo.bitDepth = DecoderProbe::bitDepth(vsinfo.format);
                     const auto &metaData = vsi.metadata;
                     if (!metaData.empty()) {
                         for (auto &&data : qAsConst(metaData)) {
@@ -993,6 +3011,29 @@ void MDKPlayer::initMdkHandlers()
                     m_mediaInfo.videoStreams.append(vsinfo);
                 }
                 Q_EMIT videoSizeChanged();
+                // Every variant of an HLS/DASH stream is a video track,
+                // FFmpeg only downloads the segments of the active ones.
+                VariantSelector::Variants variants = {};
+                for (int i = 0; i < m_mediaInfo.videoStreams.size(); ++i) {
+                    const auto &stream = m_mediaInfo.videoStreams.at(i);
+                    const qint64 bandwidth = stream.metaData.value(QStringLiteral("variant_bitrate")).toLongLong();
+                    if (bandwidth > 0) {
+                        variants.append({i, stream.width, stream.height, bandwidth});
+                    }
+                }
+                const qint64 bitRate = info.bit_rate;
+                QMetaObject::invokeMethod(this, [this, bitRate, variants]() {
+                    // Size the read-ahead of a mapped file.
+                    if (const auto source = currentMediaSource().dynamicCast<MappedFileSource>()) {
+                        source->setBitRate(bitRate);
+                    }
+                    // MDK starts with the first track.
+                    m_variantSelector.setVariants(variants, 0);
+                    Q_EMIT variantChanged();
+                    selectVariant();
+                }, Qt::QueuedConnection);
+                // The decoders are created once we return.
+                selectVideoDecoders();
             }
             m_hasAudio = !info.audio.empty();
             if (m_hasAudio) {
@@ -1047,6 +3088,31 @@ void MDKPlayer::initMdkHandlers()
                 qDebug() << "Media loaded.";
             }
         }
+        const bool seeking = MDK_NS_PREPEND(test_flag)(ms & MDK_NS_PREPEND(MediaStatus)::Seeking);
+        if (!seeking && (m_player->state() == MDK_NS_PREPEND(PlaybackState)::Playing)
+                && (MDK_NS_PREPEND(flags_added)(static_cast<MDK_NS_PREPEND(MediaStatus)>(m_mediaStatus), ms, MDK_NS_PREPEND(MediaStatus)::Buffering)
+                    || MDK_NS_PREPEND(flags_added)(static_cast<MDK_NS_PREPEND(MediaStatus)>(m_mediaStatus), ms, MDK_NS_PREPEND(MediaStatus)::Stalled))) {
+            QMetaObject::invokeMethod(this, [this]() {
+                // The initial buffering isn't a stall.
+                if (!m_openTimer.isValid()) {
+                    handleStall(true);
+                }
+            }, Qt::QueuedConnection);
+        }
+        if (MDK_NS_PREPEND(flags_added)(static_cast<MDK_NS_PREPEND(MediaStatus)>(m_mediaStatus), ms, MDK_NS_PREPEND(MediaStatus)::Buffered)) {
+            QMetaObject::invokeMethod(this, [this]() {
+                handleStall(false);
+            }, Qt::QueuedConnection);
+        }
+        if (m_rememberPosition && MDK_NS_PREPEND(flags_added)(static_cast<MDK_NS_PREPEND(MediaStatus)>(m_mediaStatus), ms, MDK_NS_PREPEND(MediaStatus)::End)) {
+            QMetaObject::invokeMethod(this, [this]() {
+                // Finished media should start from the beginning next time.
+                // Nothing to do if other media has been opened meanwhile.
+                if (MDK_NS_PREPEND(test_flag)(static_cast<MDK_NS_PREPEND(MediaStatus)>(m_mediaStatus) & MDK_NS_PREPEND(MediaStatus)::End)) {
+                    HistoryStore::instance()->remove(url());
+                }
+            }, Qt::QueuedConnection);
+        }
         m_mediaStatus = static_cast<int>(ms);
         Q_EMIT mediaStatusChanged();
         return true;
@@ -1055,6 +3121,13 @@ void MDKPlayer::initMdkHandlers()
         if (!m_livePreview) {
             qDebug() << "MDK event:" << me.category.data() << me.detail.data();
         }
+        if (me.category == "decoder.video") {
+            const QString decoder = QString::fromStdString(me.detail);
+            const bool failed = (me.error < 0);
+            QMetaObject::invokeMethod(this, [this, decoder, failed]() {
+                handleDecoderEvent(decoder, failed);
+            }, Qt::QueuedConnection);
+        }
         return false;
     });
     m_player->onLoop([this](int count) {
@@ -1111,6 +3184,10 @@ void MDKPlayer::resetInternalData()
     //m_loop = false;
     m_mediaInfo = {};
     m_mediaStatus = static_cast<int>(MDK_NS_PREPEND(MediaStatus)::NoMedia);
+    m_openTimer.invalidate();
+    m_decoderSwitchTimer.invalidate();
+    m_decoderHealthTimer.invalidate();
+    m_decodeErrors = 0;
     Q_EMIT urlChanged();
     Q_EMIT positionChanged();
     Q_EMIT durationChanged();
@@ -1149,7 +3226,7 @@ void MDKPlayer::advance(const QUrl &value)
     }
     const QUrl nextUrl = *m_next_it;
     if (nextUrl.isValid()) {
-        m_player->setNextMedia(qUtf8Printable(urlToString(nextUrl)));
+        m_player->setNextMedia(qUtf8Printable(mediaLocation(nextUrl)));
     }
     advance();
 }
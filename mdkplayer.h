@@ -25,8 +25,23 @@
 #pragma once
 
 #include "mdkplayer_global.h"
+#include "buffercontroller.h"
+#include "variantselector.h"
+#include "syncgroup.h"
 #include <QtCore/qurl.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qsharedpointer.h>
 #include <QtQuick/qquickitem.h>
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QImage)
+QT_FORWARD_DECLARE_CLASS(QIODevice)
+QT_FORWARD_DECLARE_CLASS(QFileSystemWatcher)
+QT_END_NAMESPACE
 
 namespace mdk
 {
@@ -38,6 +53,12 @@ class Player;
 MDKPLAYER_BEGIN_NAMESPACE
 
 class VideoTextureNode;
+class FrameGrabResult;
+class DvrBuffer;
+class DvrIngest;
+class ClipExportJob;
+class MediaSource;
+class DecoderPolicy;
 
 class MDKPLAYER_API MDKPlayer : public QQuickItem
 {
@@ -66,6 +87,13 @@ class MDKPLAYER_API MDKPlayer : public QQuickItem
     Q_PROPERTY(QString snapshotDirectory READ snapshotDirectory WRITE setSnapshotDirectory NOTIFY snapshotDirectoryChanged)
     Q_PROPERTY(QString snapshotFormat READ snapshotFormat WRITE setSnapshotFormat NOTIFY snapshotFormatChanged)
     Q_PROPERTY(QString snapshotTemplate READ snapshotTemplate WRITE setSnapshotTemplate NOTIFY snapshotTemplateChanged)
+    Q_PROPERTY(qint64 snapshotLatency READ snapshotLatency NOTIFY snapshotLatencyChanged)
+    Q_PROPERTY(qint64 dvrWindow READ dvrWindow WRITE setDvrWindow NOTIFY dvrWindowChanged)
+    Q_PROPERTY(qint64 dvrMemoryLimit READ dvrMemoryLimit WRITE setDvrMemoryLimit NOTIFY dvrMemoryLimitChanged)
+    Q_PROPERTY(qint64 dvrDuration READ dvrDuration NOTIFY dvrChanged)
+    Q_PROPERTY(qint64 dvrMemoryUsage READ dvrMemoryUsage NOTIFY dvrChanged)
+    Q_PROPERTY(qint64 dvrFlushLatency READ dvrFlushLatency NOTIFY dvrChanged)
+    Q_PROPERTY(bool timeShifted READ timeShifted NOTIFY dvrChanged)
     Q_PROPERTY(QStringList videoSuffixes READ videoSuffixes CONSTANT)
     Q_PROPERTY(QStringList audioSuffixes READ audioSuffixes CONSTANT)
     Q_PROPERTY(QStringList subtitleSuffixes READ subtitleSuffixes CONSTANT)
@@ -84,8 +112,63 @@ class MDKPLAYER_API MDKPlayer : public QQuickItem
     Q_PROPERTY(FillMode fillMode READ fillMode WRITE setFillMode NOTIFY fillModeChanged)
     Q_PROPERTY(MediaInfo mediaInfo READ mediaInfo NOTIFY mediaInfoChanged)
     Q_PROPERTY(bool loop READ loop WRITE setLoop NOTIFY loopChanged)
+    Q_PROPERTY(qint64 startPosition READ startPosition WRITE setStartPosition NOTIFY startPositionChanged)
+    Q_PROPERTY(qint64 firstFrameLatency READ firstFrameLatency NOTIFY firstFrameLatencyChanged)
+    Q_PROPERTY(bool seekAfterOpen READ seekAfterOpen WRITE setSeekAfterOpen NOTIFY seekAfterOpenChanged)
+    Q_PROPERTY(bool rememberPosition READ rememberPosition WRITE setRememberPosition NOTIFY rememberPositionChanged)
+    Q_PROPERTY(bool autoSelectDecoders READ autoSelectDecoders WRITE setAutoSelectDecoders NOTIFY autoSelectDecodersChanged)
+    Q_PROPERTY(QVariantList decoderPolicy READ decoderPolicy WRITE setDecoderPolicy NOTIFY decoderPolicyChanged)
+    Q_PROPERTY(QStringList selectedVideoDecoders READ selectedVideoDecoders NOTIFY selectedVideoDecodersChanged)
+    Q_PROPERTY(QString activeVideoDecoder READ activeVideoDecoder NOTIFY activeVideoDecoderChanged)
+    Q_PROPERTY(bool autoDecoderFallback READ autoDecoderFallback WRITE setAutoDecoderFallback NOTIFY autoDecoderFallbackChanged)
+    Q_PROPERTY(int maxDecodeErrors READ maxDecodeErrors WRITE setMaxDecodeErrors NOTIFY maxDecodeErrorsChanged)
+    Q_PROPERTY(qreal maxDroppedFrameRatio READ maxDroppedFrameRatio WRITE setMaxDroppedFrameRatio NOTIFY maxDroppedFrameRatioChanged)
+    Q_PROPERTY(qint64 decoderSwitchLatency READ decoderSwitchLatency NOTIFY decoderSwitchLatencyChanged)
+    Q_PROPERTY(bool adaptiveBuffering READ adaptiveBuffering WRITE setAdaptiveBuffering NOTIFY adaptiveBufferingChanged)
+    Q_PROPERTY(qint64 minBufferDuration READ minBufferDuration WRITE setMinBufferDuration NOTIFY minBufferDurationChanged)
+    Q_PROPERTY(qint64 maxBufferDuration READ maxBufferDuration WRITE setMaxBufferDuration NOTIFY maxBufferDurationChanged)
+    Q_PROPERTY(qint64 maxBufferBytes READ maxBufferBytes WRITE setMaxBufferBytes NOTIFY maxBufferBytesChanged)
+    Q_PROPERTY(qint64 bufferTarget READ bufferTarget NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(qint64 bufferedDuration READ bufferedDuration NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(qint64 bufferedBytes READ bufferedBytes NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(int stallCount READ stallCount NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(qint64 stallDuration READ stallDuration NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(LatencyMode latencyMode READ latencyMode WRITE setLatencyMode NOTIFY latencyModeChanged)
+    Q_PROPERTY(qint64 latencyTarget READ latencyTarget WRITE setLatencyTarget NOTIFY latencyTargetChanged)
+    Q_PROPERTY(qint64 maxLatency READ maxLatency WRITE setMaxLatency NOTIFY maxLatencyChanged)
+    Q_PROPERTY(qint64 measuredLatency READ measuredLatency NOTIFY liveStatisticsChanged)
+    Q_PROPERTY(int catchUpCount READ catchUpCount NOTIFY liveStatisticsChanged)
+    Q_PROPERTY(int liveResetCount READ liveResetCount NOTIFY liveStatisticsChanged)
+    Q_PROPERTY(bool tailMode READ tailMode WRITE setTailMode NOTIFY tailModeChanged)
+    Q_PROPERTY(qint64 tailDistance READ tailDistance WRITE setTailDistance NOTIFY tailDistanceChanged)
+    Q_PROPERTY(bool mappedFileIO READ mappedFileIO WRITE setMappedFileIO NOTIFY mappedFileIOChanged)
+    Q_PROPERTY(qint64 ioWaitTime READ ioWaitTime NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(bool httpCache READ httpCache WRITE setHttpCache NOTIFY httpCacheChanged)
+    Q_PROPERTY(qint64 seekLatency READ seekLatency NOTIFY seekLatencyChanged)
+    Q_PROPERTY(bool adaptiveBitrate READ adaptiveBitrate WRITE setAdaptiveBitrate NOTIFY adaptiveBitrateChanged)
+    Q_PROPERTY(int currentVariant READ currentVariant NOTIFY variantChanged)
+    Q_PROPERTY(qint64 variantBitRate READ variantBitRate NOTIFY variantChanged)
+    Q_PROPERTY(int variantSwitchCount READ variantSwitchCount NOTIFY variantChanged)
+    Q_PROPERTY(qint64 estimatedThroughput READ estimatedThroughput NOTIFY bufferStatisticsChanged)
+    Q_PROPERTY(HiddenBehavior hiddenBehavior READ hiddenBehavior WRITE setHiddenBehavior NOTIFY hiddenBehaviorChanged)
+    Q_PROPERTY(bool effectivelyVisible READ effectivelyVisible NOTIFY effectivelyVisibleChanged)
+    Q_PROPERTY(qint64 hiddenDuration READ hiddenDuration NOTIFY hiddenStatisticsChanged)
+    Q_PROPERTY(qint64 skippedRenders READ skippedRenders NOTIFY hiddenStatisticsChanged)
+    Q_PROPERTY(qint64 savedRenderTime READ savedRenderTime NOTIFY hiddenStatisticsChanged)
+    Q_PROPERTY(bool adaptiveDecodeResolution READ adaptiveDecodeResolution WRITE setAdaptiveDecodeResolution NOTIFY adaptiveDecodeResolutionChanged)
+    Q_PROPERTY(int decodeScale READ decodeScale NOTIFY decodeScaleChanged)
+    Q_PROPERTY(qint64 savedPixelRate READ savedPixelRate NOTIFY decodeScaleChanged)
+    Q_PROPERTY(FrameSkip frameSkip READ frameSkip WRITE setFrameSkip NOTIFY frameSkipChanged)
+    Q_PROPERTY(FrameSkip activeFrameSkip READ activeFrameSkip NOTIFY activeFrameSkipChanged)
+    Q_PROPERTY(QualityTier qualityTier READ qualityTier NOTIFY qualityTierChanged)
+    Q_PROPERTY(bool textureAtlas READ textureAtlas WRITE setTextureAtlas NOTIFY textureAtlasChanged)
+    Q_PROPERTY(int atlasPage READ atlasPage NOTIFY atlasPageChanged)
+    Q_PROPERTY(SyncGroup *syncGroup READ syncGroup WRITE setSyncGroup NOTIFY syncGroupChanged)
 
     friend class VideoTextureNode;
+    friend class DecodeScheduler;
+    friend class SyncGroup;
+    friend class ChannelZapper;
 
 public:
     enum class PlaybackState : int
@@ -142,6 +225,39 @@ public:
     };
     Q_ENUM(FillMode)
 
+    enum class LatencyMode : int
+    {
+        Default = 0,
+        Live
+    };
+    Q_ENUM(LatencyMode)
+
+    enum class HiddenBehavior : int
+    {
+        KeepDecoding = 0,
+        AudioOnly,
+        Suspend
+    };
+    Q_ENUM(HiddenBehavior)
+
+    enum class FrameSkip : int
+    {
+        Auto = 0,
+        None,
+        NonReference,
+        KeyFrames
+    };
+    Q_ENUM(FrameSkip)
+
+    enum class QualityTier : int
+    {
+        Full = 0,
+        ReducedResolution,
+        ReducedFrameRate,
+        KeyFramesOnly
+    };
+    Q_ENUM(QualityTier)
+
     struct VideoStreamInfo
     {
         int index = 0;
@@ -153,6 +269,8 @@ public:
         QString format = {};
         int width = 0;
         int height = 0;
+        int profile = 0;
+        int bitDepth = 8;
         MetaData metaData = {};
     };
     using VideoStreams = QList<VideoStreamInfo>;
@@ -234,8 +352,28 @@ public:
     void setSnapshotFormat(const QString &value);
 
     QString snapshotTemplate() const;
+    // The file name (without suffix) of snapshots. Available placeholders:
+    // ${filename}, ${basename}, ${position} (milliseconds), ${time} (hh-mm-ss-zzz),
+    // ${datetime} (capture time) and ${counter}. Empty means "${filename}_${position}".
     void setSnapshotTemplate(const QString &value);
 
+    // Milliseconds from capturing the last snapshot to having it on disk.
+    qint64 snapshotLatency() const;
+
+    // How many milliseconds of the current media are kept in memory for
+    // instant replay. 0 disables the DVR buffer.
+    qint64 dvrWindow() const;
+    void setDvrWindow(const qint64 value);
+
+    // In bytes.
+    qint64 dvrMemoryLimit() const;
+    void setDvrMemoryLimit(const qint64 value);
+
+    qint64 dvrDuration() const;
+    qint64 dvrMemoryUsage() const;
+    qint64 dvrFlushLatency() const;
+    bool timeShifted() const;
+
     static inline QStringList videoSuffixes()
     {
         static const QStringList list =
@@ -418,8 +556,233 @@ public:
     bool loop() const;
     void setLoop(const bool value);
 
+    // Order the video decoders of every stream by the speed DecoderProbe
+    // measured for its codec, profile and bit depth. Streams that have never
+    // been probed use the configured order and are probed in the background.
+    bool autoSelectDecoders() const;
+    void setAutoSelectDecoders(const bool value);
+
+    // Per stream decoder chains, see DecoderPolicy for the format. A matching
+    // rule takes precedence over both autoSelectDecoders and videoDecoders.
+    QVariantList decoderPolicy() const;
+    void setDecoderPolicy(const QVariantList &value);
+
+    // The decoder chain chosen for the current stream, with options.
+    QStringList selectedVideoDecoders() const;
+    // The decoder MDK actually opened.
+    QString activeVideoDecoder() const;
+
+    // Switch to the next decoder of the chain in place once the active one
+    // reports maxDecodeErrors errors or keeps dropping more than
+    // maxDroppedFrameRatio of the frames. 0 disables a threshold.
+    bool autoDecoderFallback() const;
+    void setAutoDecoderFallback(const bool value);
+
+    int maxDecodeErrors() const;
+    void setMaxDecodeErrors(const int value);
+
+    qreal maxDroppedFrameRatio() const;
+    void setMaxDroppedFrameRatio(const qreal value);
+
+    // Milliseconds from the last decoder switch to the first frame of the new decoder.
+    qint64 decoderSwitchLatency() const;
+
+    // Let BufferController pick the buffer range between minBufferDuration
+    // and maxBufferDuration (further limited by maxBufferBytes, 0 means no
+    // limit) instead of the fixed default one.
+    bool adaptiveBuffering() const;
+    void setAdaptiveBuffering(const bool value);
+
+    qint64 minBufferDuration() const;
+    void setMinBufferDuration(const qint64 value);
+
+    qint64 maxBufferDuration() const;
+    void setMaxBufferDuration(const qint64 value);
+
+    qint64 maxBufferBytes() const;
+    void setMaxBufferBytes(const qint64 value);
+
+    // How much has to be buffered before playback resumes after a stall.
+    qint64 bufferTarget() const;
+    qint64 bufferedDuration() const;
+    qint64 bufferedBytes() const;
+    // Stalls of the current media and their total duration in milliseconds.
+    int stallCount() const;
+    qint64 stallDuration() const;
+
+    // Live is meant for cameras (RTSP/RTP/UDP): minimal probing and
+    // buffering, stale packets are dropped and playback runs slightly faster
+    // while the latency is above latencyTarget. Beyond maxLatency the stream
+    // is reopened. Takes effect on the next media.
+    LatencyMode latencyMode() const;
+    void setLatencyMode(const LatencyMode value);
+
+    qint64 latencyTarget() const;
+    void setLatencyTarget(const qint64 value);
+
+    qint64 maxLatency() const;
+    void setMaxLatency(const qint64 value);
+
+    // An estimate of how far playback is behind the stream in Live mode:
+    // what was buffered when the first frame was shown plus the time
+    // playback fell behind the stream's clock since then. The path from the
+    // camera to the first packet isn't included, the stream carries no wall
+    // clock for that, so the real latency is always higher.
+    // In tail mode: how far playback is behind the end of the file.
+    qint64 measuredLatency() const;
+    int catchUpCount() const;
+    int liveResetCount() const;
+
+    // Play local files that are still being written, see GrowingFileSource.
+    // The file is watched for changes and the duration grows with it,
+    // playback runs a little faster while it's more than tailDistance
+    // milliseconds (300 by default) behind the end of the file. Takes
+    // effect on the next media.
+    bool tailMode() const;
+    void setTailMode(const bool value);
+
+    qint64 tailDistance() const;
+    void setTailDistance(const qint64 value);
+
+    // Read local files through a memory mapping with read-ahead instead of
+    // MDK's own file reads, see MappedFileSource. Takes effect on the next media.
+    bool mappedFileIO() const;
+    void setMappedFileIO(const bool value);
+
+    // Milliseconds spent waiting for the data of the current media, if it's
+    // served by MediaServer (mapped files, devices, memory), 0 otherwise.
+    qint64 ioWaitTime() const;
+
+    // Play HTTP(S) media and HLS streams through HttpCache, so that seeking
+    // back and replaying read the disk. Not used in the live latency mode.
+    // Takes effect on the next media.
+    bool httpCache() const;
+    void setHttpCache(const bool value);
+
+    // Milliseconds from the last seek to the first frame after it.
+    qint64 seekLatency() const;
+
+    // Let VariantSelector pick the variant of HLS/DASH streams from the
+    // throughput, the buffer and the size of the item, instead of always
+    // playing the first one. On by default.
+    bool adaptiveBitrate() const;
+    void setAdaptiveBitrate(const bool value);
+
+    // The index of the playing variant in mediaInfo.videoStreams, -1 if the
+    // media isn't an adaptive stream.
+    int currentVariant() const;
+    // Bits per second as announced by the playlist.
+    qint64 variantBitRate() const;
+    int variantSwitchCount() const;
+    // Bits per second, as measured from the growth of MDK's buffer.
+    qint64 estimatedThroughput() const;
+
+    // What to do while the item can't be seen: hidden, transparent, clipped
+    // away by its ancestors (e.g. scrolled out of a ListView) or in a
+    // minimized or covered window. AudioOnly (the default) stops decoding
+    // and rendering video, Suspend stops decoding altogether and keeps
+    // counting the position. Video resumes at the current frame once the
+    // item is visible again.
+    HiddenBehavior hiddenBehavior() const;
+    void setHiddenBehavior(const HiddenBehavior value);
+
+    bool effectivelyVisible() const;
+
+    // Milliseconds spent hidden with video decoding stopped.
+    qint64 hiddenDuration() const;
+    // Frames of the window that didn't render the video, and the time that
+    // saved on the render thread, from the average cost of a render.
+    qint64 skippedRenders() const;
+    qint64 savedRenderTime() const;
+
+    // Decode or convert video at a half, a quarter or an eighth of its
+    // resolution while that still fills the item, e.g. a 4K stream in a
+    // small tile. Codecs with lowres support (MJPEG, MPEG-1/2, DV,
+    // JPEG 2000) are decoded at the lower resolution, other software
+    // decoded video is downscaled before it's uploaded. Hardware decoders
+    // are left alone. Back to the full resolution as soon as the item grows.
+    bool adaptiveDecodeResolution() const;
+    void setAdaptiveDecodeResolution(const bool value);
+
+    // The divisor of the width and height, 1 is the full resolution.
+    int decodeScale() const;
+    // Pixels per second that aren't decoded because of it. Always 0 for
+    // codecs without lowres, they are decoded at the full size and scaled
+    // down afterwards, which only saves on the upload.
+    qint64 savedPixelRate() const;
+
+    // Which frames the decoder skips instead of decoding them only to be
+    // dropped: None, NonReference (frames nothing else refers to) or
+    // KeyFrames (decode key frames only). Auto picks from the playback
+    // rate (4x and up skips non-reference frames, 8x and up decodes key
+    // frames only) and skips non-reference frames in very small items.
+    // Audio and the position aren't affected. Only FFmpeg's software
+    // decoders can skip frames. None by default.
+    FrameSkip frameSkip() const;
+    void setFrameSkip(const FrameSkip value);
+
+    // What is in effect right now, never Auto.
+    FrameSkip activeFrameSkip() const;
+
+    // How much DecodeScheduler lets this player decode when the budget of
+    // all players is exceeded: ReducedResolution decodes at half the size
+    // at most (see decodeScale), ReducedFrameRate and KeyFramesOnly skip
+    // frames (see activeFrameSkip). Full unless a budget is set.
+    QualityTier qualityTier() const;
+
+    // Renders into a tile of a texture shared with the other small players
+    // of the window (up to 512x512 device pixels), so the scenegraph can
+    // draw all of them with a few draw calls instead of one each. Only
+    // with OpenGL, larger players keep their own texture.
+    bool textureAtlas() const;
+    void setTextureAtlas(const bool value);
+
+    // The shared texture in use, -1 if the player has its own.
+    int atlasPage() const;
+
+    // Plays in lockstep with the other members of the group, see SyncGroup.
+    SyncGroup *syncGroup() const;
+    void setSyncGroup(SyncGroup *value);
+
+    // The position the next opened media starts from. It's handed to the
+    // decoder directly so the first decoded frame is the target frame instead
+    // of the first frame of the media. Reset to 0 once it has been consumed.
+    qint64 startPosition() const;
+    void setStartPosition(const qint64 value);
+
+    // Milliseconds from opening the media to its first decoded frame at the
+    // start position.
+    qint64 firstFrameLatency() const;
+
+    // Opens from 0 and seeks to the start position once the media has been
+    // prepared, the way setUrl() followed by seek() used to work. Only meant
+    // for comparing firstFrameLatency with the direct start.
+    bool seekAfterOpen() const;
+    void setSeekAfterOpen(const bool value);
+
+    // Opt-in warm-up of the decoders and the render path, see PlayerWarmUp.
+    // Call it once at application start, e.g. right after registerMDKWrapper().
+    static void warmUp(const QUrl &sample = {}, const QStringList &decoders = {});
+
+    // Play media MDK can't open by itself, without a temporary file. It's
+    // served to MDK through MediaServer, see MediaSource for the rules.
+    // "name" is only used to show a file name and to guess the format.
+    // "qrc:" urls are handled this way automatically.
+    void openDevice(QIODevice *device, const QString &name, const qint64 startPosition = 0);
+    void openData(const QByteArray &data, const QString &name, const qint64 startPosition = 0);
+
+    // Save the playback position to the history store while playing and
+    // resume from it the next time the same media is opened.
+    bool rememberPosition() const;
+    void setRememberPosition(const bool value);
+
 public Q_SLOTS:
     void open(const QUrl &value);
+    void open(const QUrl &value, const qint64 startPosition, const bool keyFrame = false);
+    // Opens the media, even if it's the current one, and stops paused at
+    // its first frame whatever autoStart says, ready for play(). Reopening
+    // brings a live stream back to its live edge.
+    void preload(const QUrl &value);
     void play();
     void play(const QUrl &value);
     void pause();
@@ -435,12 +798,33 @@ public Q_SLOTS:
     void rotateImage(const int value);
     void scaleImage(const qreal x, const qreal y);
     void snapshot();
+    // Captures the current frame into memory. The returned object emits
+    // ready() once the image is available. The caller takes the ownership.
+    FrameGrabResult *grabFrame();
     bool isLoaded() const;
     bool isPlaying() const;
     bool isPaused() const;
     bool isStopped() const;
+    // Returns -1 if the media has never been played before.
+    qint64 savedPosition(const QUrl &value) const;
     void startRecording(const QUrl &value, const QString &format = {});
     void stopRecording();
+    // Writes the last "duration" milliseconds (everything if negative) of the
+    // DVR buffer to a local MPEG-TS file, without re-encoding.
+    bool saveReplay(const QUrl &value, const qint64 duration = -1);
+    // Plays the DVR buffer from "offset" milliseconds before the live position.
+    bool replay(const qint64 offset);
+    void returnToLive();
+    // Queues a lossless export of [start, end] of "source" (the current media
+    // if invalid) on the shared ClipExporter.
+    ClipExportJob *exportClip(const QUrl &source, const qint64 start, const qint64 end,
+                              const QUrl &destination, const QString &format = {});
+    // Replaces the video decoders of the current media without reopening it:
+    // the decoder is recreated and playback resumes from the nearest key frame
+    // before the current position. Only takes effect on the next media if
+    // nothing is loaded. The lowres and skip_frame options of the current
+    // decode scale and frame skip mode are added to the FFmpeg entries.
+    void switchVideoDecoders(const QStringList &value);
     void seekBackward(const int value = 5000);
     void seekForward(const int value = 5000);
     void playPrevious();
@@ -448,6 +832,7 @@ public Q_SLOTS:
 
 protected:
     void timerEvent(QTimerEvent *event) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
     QSGNode *updatePaintNode(QSGNode *node, UpdatePaintNodeData *data) override;
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
     void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
@@ -457,6 +842,7 @@ protected:
 
 private Q_SLOTS:
     void invalidateSceneGraph();
+    void handleNewFrame();
 
 private:
     void releaseResources() override;
@@ -464,6 +850,47 @@ private:
     void resetInternalData();
     void advance();
     void advance(const QUrl &value);
+    bool openMedia(const QUrl &value, const qint64 startPosition, const bool keyFrame,
+                   const bool reopen = false, const bool paused = false);
+    void savePosition();
+    void selectVideoDecoders();
+    void updateDecoderSelection();
+    QStringList plainVideoDecoders() const;
+    QStringList videoDecoderChain(const QStringList &value) const;
+    void requestFrame(const std::function<void(const QImage &, const qreal)> &callback);
+    void handleSnapshotTaken(const QString &filePath, const qint64 latency);
+    void updateDvr();
+    void rotateDvrFile();
+    void stopDvr();
+    void handleDecoderEvent(const QString &decoder, const bool failed);
+    void checkDecoderHealth();
+    void fallbackVideoDecoder(const QString &reason);
+    void applyBufferRange();
+    void sampleBuffer();
+    void handleStall(const bool begin);
+    qint64 bufferLimit() const;
+    void selectVariant();
+    bool isEffectivelyVisible() const;
+    void updateVisibility();
+    void setHiddenState(const HiddenBehavior value);
+    void updateDecodeScale();
+    void applyDecodeScale(const int requested);
+    // FFmpeg decoders of these codecs can decode at a lower resolution.
+    static bool hasLowres(const QString &codec);
+    void updateFrameSkip();
+    void setQualityTier(const QualityTier value);
+    void setRateTrim(const qreal value);
+    qreal rateFactor() const;
+    void setCatchingUp(const bool value);
+    void applyLatencyMode();
+    QString mediaLocation(const QUrl &value);
+    QUrl publishMedia(const QSharedPointer<MediaSource> &source, const QUrl &originalUrl = {});
+    QSharedPointer<MediaSource> currentMediaSource() const;
+    void unpublishMedia();
+    void checkLiveLatency();
+    void checkTailLatency();
+    void catchUpTo(const qint64 latency, const qint64 target);
+    void refreshTail(const QString &filePath);
 
 Q_SIGNALS:
     void loaded();
@@ -488,6 +915,11 @@ Q_SIGNALS:
     void snapshotDirectoryChanged();
     void snapshotFormatChanged();
     void snapshotTemplateChanged();
+    void snapshotLatencyChanged();
+    void snapshotTaken(const QString &param1);
+    void dvrWindowChanged();
+    void dvrMemoryLimitChanged();
+    void dvrChanged();
     void positionTextChanged();
     void durationTextChanged();
     void hardwareDecodingChanged();
@@ -499,6 +931,48 @@ Q_SIGNALS:
     void fillModeChanged();
     void mediaInfoChanged();
     void loopChanged();
+    void startPositionChanged();
+    void firstFrameLatencyChanged();
+    void seekAfterOpenChanged();
+    void rememberPositionChanged();
+    void autoSelectDecodersChanged();
+    void decoderPolicyChanged();
+    void selectedVideoDecodersChanged();
+    void activeVideoDecoderChanged();
+    void autoDecoderFallbackChanged();
+    void maxDecodeErrorsChanged();
+    void maxDroppedFrameRatioChanged();
+    void decoderSwitchLatencyChanged();
+    void decoderFallback(const QString &param1, const QString &param2);
+    void adaptiveBufferingChanged();
+    void minBufferDurationChanged();
+    void maxBufferDurationChanged();
+    void maxBufferBytesChanged();
+    void bufferStatisticsChanged();
+    void latencyModeChanged();
+    void latencyTargetChanged();
+    void maxLatencyChanged();
+    void liveStatisticsChanged();
+    void catchUp(const qint64 param1);
+    void liveReset(const qint64 param1);
+    void tailModeChanged();
+    void tailDistanceChanged();
+    void mappedFileIOChanged();
+    void httpCacheChanged();
+    void seekLatencyChanged();
+    void adaptiveBitrateChanged();
+    void variantChanged();
+    void hiddenBehaviorChanged();
+    void effectivelyVisibleChanged();
+    void hiddenStatisticsChanged();
+    void adaptiveDecodeResolutionChanged();
+    void decodeScaleChanged();
+    void frameSkipChanged();
+    void activeFrameSkipChanged();
+    void qualityTierChanged();
+    void textureAtlasChanged();
+    void atlasPageChanged();
+    void syncGroupChanged();
     void newHistory(const QUrl &param1, const qint64 param2);
 
 private:
@@ -520,18 +994,148 @@ private:
     bool m_autoStart = true;
     bool m_livePreview = false;
     bool m_loop = false;
+    bool m_rememberPosition = false;
+    bool m_autoSelectDecoders = false;
+    bool m_autoDecoderFallback = false;
 
     QString m_snapshotDirectory = {};
     QString m_snapshotFormat = QStringLiteral("png");
     QString m_snapshotTemplate = {};
+    qint64 m_snapshotLatency = 0;
+    int m_snapshotCounter = 0;
 
     QStringList m_videoDecoders = {};
     QStringList m_audioDecoders = {};
     QStringList m_audioBackends = {};
+    QVariantList m_decoderPolicy = {};
+    QSharedPointer<const DecoderPolicy> m_parsedDecoderPolicy = {};
+    // What selectVideoDecoders() reads on MDK's thread, a copy of the gui
+    // thread's settings made by updateDecoderSelection().
+    struct DecoderSelection
+    {
+        QStringList configured = {};
+        QSharedPointer<const DecoderPolicy> policy = {};
+        bool autoSelect = false;
+        bool livePreview = false;
+    };
+    mutable QMutex m_decoderSelectionMutex;
+    DecoderSelection m_decoderSelection = {};
+    // The chain in use without the options the player adds itself,
+    // m_selectedVideoDecoders is what MDK got.
+    QStringList m_plainVideoDecoders = {};
+    QStringList m_selectedVideoDecoders = {};
+    QString m_activeVideoDecoder = {};
+    int m_maxDecodeErrors = 3;
+    int m_decodeErrors = 0;
+    qreal m_maxDroppedFrameRatio = 0.5;
+    qint64 m_renderedFrames = 0;
+    qint64 m_decoderSwitchLatency = 0;
+    QElapsedTimer m_decoderSwitchTimer;
+    QElapsedTimer m_decoderHealthTimer;
+
+    bool m_adaptiveBuffering = false;
+    BufferController m_bufferController;
+    qint64 m_bufferedDuration = 0;
+    qint64 m_bufferedBytes = 0;
+    qint64 m_bufferPosition = -1;
+    int m_stallCount = 0;
+    qint64 m_stallDuration = 0;
+    QElapsedTimer m_bufferTimer;
+    QElapsedTimer m_stallTimer;
+
+    LatencyMode m_latencyMode = LatencyMode::Default;
+    qint64 m_latencyTarget = 200;
+    qint64 m_maxLatency = 2000;
+    qint64 m_measuredLatency = 0;
+    qint64 m_liveAnchorPosition = 0;
+    qint64 m_liveAnchorLatency = 0;
+    int m_catchUpCount = 0;
+    int m_liveResetCount = 0;
+    bool m_catchingUp = false;
+    // Whether the low latency demuxer options are set.
+    bool m_liveDemuxerOptions = false;
+    QElapsedTimer m_liveClock;
+
+    bool m_tailMode = false;
+    qint64 m_tailDistance = 300;
+    QFileSystemWatcher *m_tailWatcher = nullptr;
+    QElapsedTimer m_tailPollTimer;
+
+    // Media served by MediaServer, by published url.
+    QHash<QUrl, QSharedPointer<MediaSource>> m_publishedMedia = {};
+    bool m_mappedFileIO = false;
+    bool m_httpCache = false;
+    qint64 m_seekLatency = 0;
+    QElapsedTimer m_seekTimer;
+
+    bool m_adaptiveBitrate = true;
+    VariantSelector m_variantSelector;
+    // Device pixels, set by VideoTextureNode::sync().
+    QSize m_renderSize = {};
+
+    HiddenBehavior m_hiddenBehavior = HiddenBehavior::AudioOnly;
+    // What is in effect right now.
+    HiddenBehavior m_hiddenState = HiddenBehavior::KeepDecoding;
+    bool m_effectivelyVisible = true;
+    qint64 m_hiddenDuration = 0;
+    QElapsedTimer m_hiddenTimer;
+    QElapsedTimer m_visibilityTimer;
+    qint64 m_suspendedPosition = 0;
+    bool m_suspendedPlaying = false;
+    // Shared with VideoTextureNode::render().
+    QAtomicInt m_skipRendering = 0;
+    QAtomicInteger<qint64> m_skippedRenders = 0;
+    QAtomicInteger<qint64> m_renderCount = 0;
+    QAtomicInteger<qint64> m_renderTime = 0;
+
+    bool m_adaptiveDecodeResolution = false;
+    int m_decodeScale = 1;
+    // The last scale applyDecodeScale() was asked for, a hardware decoder
+    // stays at 1.
+    int m_requestedDecodeScale = 1;
+    bool m_decodeScaleFiltered = false;
+    int m_pendingDecodeScale = 1;
+    QElapsedTimer m_decodeScaleTimer;
+
+    FrameSkip m_frameSkip = FrameSkip::None;
+    FrameSkip m_activeFrameSkip = FrameSkip::None;
+
+    QualityTier m_qualityTier = QualityTier::Full;
+    // Never reset, DecodeScheduler takes the difference.
+    quint64 m_totalRenderedFrames = 0;
+
+    bool m_textureAtlas = false;
+    // Set by VideoTextureNode::sync().
+    int m_atlasPage = -1;
+
+    QPointer<SyncGroup> m_syncGroup = nullptr;
+    // The sync group's adjustment, hidden from playbackRate.
+    qreal m_rateTrim = 1.0;
 
     FillMode m_fillMode = FillMode::PreserveAspectFit;
     MediaInfo m_mediaInfo = {};
     int m_mediaStatus = 0;
+
+    qint64 m_startPosition = 0;
+    qint64 m_firstFrameLatency = 0;
+    QElapsedTimer m_openTimer;
+    bool m_seekAfterOpen = false;
+    // The frames decoded before the seek of seekAfterOpen don't count.
+    bool m_startSeekPending = false;
+    quint64 m_openCount = 0;
+    QElapsedTimer m_historyTimer;
+
+    QScopedPointer<DvrBuffer> m_dvr;
+    qint64 m_dvrWindow = 0;
+    qint64 m_dvrFlushLatency = 0;
+    int m_dvrCounter = 0;
+    bool m_recording = false;
+    bool m_dvrKeepBuffer = false;
+    QString m_dvrFile = {};
+    QUrl m_dvrLiveUrl = {};
+    QElapsedTimer m_dvrTimer;
+    QElapsedTimer m_dvrPollTimer;
+    QSharedPointer<DvrIngest> m_dvrIngest;
 };
 
 MDKPLAYER_END_NAMESPACE
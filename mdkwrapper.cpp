@@ -24,6 +24,16 @@
 
 #include "mdkwrapper.h"
 #include "mdkplayer.h"
+#include "imageencoder.h"
+#include "frameexporter.h"
+#include "clipexporter.h"
+#include "decoderprobe.h"
+#include "playerwarmup.h"
+#include "pipelinecache.h"
+#include "httpcache.h"
+#include "decodescheduler.h"
+#include "syncgroup.h"
+#include "channelzapper.h"
 
 static const char MDKPlayer_QtQuick_URI[] = "wangwenx190.MDKWrapper";
 
@@ -32,6 +42,19 @@ MDKPLAYER_BEGIN_NAMESPACE
 void registerMDKWrapper()
 {
     qmlRegisterType<MDKPlayer>(MDKPlayer_QtQuick_URI, 1, 0, "MDKPlayer");
+    qmlRegisterUncreatableType<FrameGrabResult>(MDKPlayer_QtQuick_URI, 1, 0, "FrameGrabResult",
+        QStringLiteral("FrameGrabResult can only be obtained from MDKPlayer.grabFrame()."));
+    qmlRegisterType<FrameExporter>(MDKPlayer_QtQuick_URI, 1, 0, "FrameExporter");
+    qmlRegisterType<SyncGroup>(MDKPlayer_QtQuick_URI, 1, 0, "SyncGroup");
+    qmlRegisterType<ChannelZapper>(MDKPlayer_QtQuick_URI, 1, 0, "ChannelZapper");
+    qmlRegisterUncreatableType<ClipExportJob>(MDKPlayer_QtQuick_URI, 1, 0, "ClipExportJob",
+        QStringLiteral("ClipExportJob can only be obtained from ClipExporter.exportClip()."));
+    qmlRegisterSingletonInstance(MDKPlayer_QtQuick_URI, 1, 0, "ClipExporter", ClipExporter::instance());
+    qmlRegisterSingletonInstance(MDKPlayer_QtQuick_URI, 1, 0, "DecoderProbe", DecoderProbe::instance());
+    qmlRegisterSingletonInstance(MDKPlayer_QtQuick_URI, 1, 0, "PlayerWarmUp", PlayerWarmUp::instance());
+    qmlRegisterSingletonInstance(MDKPlayer_QtQuick_URI, 1, 0, "PipelineCache", PipelineCache::instance());
+    qmlRegisterSingletonInstance(MDKPlayer_QtQuick_URI, 1, 0, "HttpCache", HttpCache::instance());
+    qmlRegisterSingletonInstance(MDKPlayer_QtQuick_URI, 1, 0, "DecodeScheduler", DecodeScheduler::instance());
 }
 
 MDKPLAYER_END_NAMESPACE
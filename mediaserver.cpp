@@ -0,0 +1,347 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mediaserver.h"
+#include "mediasource.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qthread.h>
+#include <QtCore/quuid.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtNetwork/qtcpserver.h>
+#include <QtNetwork/qtcpsocket.h>
+
+// What is read from a source at once, and how much may wait in a socket.
+static constexpr const qint64 kChunkSize = 256 * 1024;
+static constexpr const qint64 kHighWaterMark = 1024 * 1024;
+// Requests are tiny, anything bigger isn't from FFmpeg.
+static constexpr const int kMaxRequestSize = 16 * 1024;
+
+static inline QByteArray tokenFromUrl(const QUrl &value)
+{
+    return value.path(QUrl::FullyEncoded).section(QLatin1Char('/'), 1, 1).toUtf8();
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+MediaServer::MediaServer(QObject *parent) : QObject(parent)
+{
+}
+
+MediaServer::~MediaServer()
+{
+    if (!m_thread) {
+        return;
+    }
+    // The sockets are children of the server.
+    QMetaObject::invokeMethod(m_worker, [this]() {
+        delete m_server;
+        m_server = nullptr;
+    }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_worker;
+    delete m_thread;
+}
+
+MediaServer *MediaServer::instance()
+{
+    static MediaServer server;
+    return &server;
+}
+
+bool MediaServer::ensureStarted()
+{
+    if (m_port != 0) {
+        return true;
+    }
+    if (!m_thread) {
+        m_thread = new QThread;
+        m_thread->setObjectName(QStringLiteral("MediaServer"));
+        m_worker = new QObject;
+        m_worker->moveToThread(m_thread);
+        m_thread->start();
+    }
+    QMetaObject::invokeMethod(m_worker, [this]() {
+        if (!m_server) {
+            m_server = new QTcpServer;
+            connect(m_server, &QTcpServer::newConnection, m_server, [this]() {
+                handleConnection();
+            });
+        }
+        if (m_server->listen(QHostAddress::LocalHost, 0)) {
+            m_port = m_server->serverPort();
+        } else {
+            qWarning() << "Media server: failed to listen on the loopback interface:" << m_server->errorString();
+        }
+    }, Qt::BlockingQueuedConnection);
+    return (m_port != 0);
+}
+
+QUrl MediaServer::publish(const QSharedPointer<MediaSource> &source, const QUrl &originalUrl)
+{
+    if (!source) {
+        return {};
+    }
+    const QMutexLocker locker(&m_mutex);
+    if (!ensureStarted()) {
+        return {};
+    }
+    const QByteArray token = QUuid::createUuid().toByteArray(QUuid::Id128);
+    m_entries.insert(token, {source, originalUrl});
+    QUrl url = {};
+    url.setScheme(QStringLiteral("http"));
+    url.setHost(QStringLiteral("127.0.0.1"));
+    url.setPort(m_port);
+    url.setPath(QLatin1Char('/') + QString::fromLatin1(token) + QLatin1Char('/')
+                + QString::fromUtf8(QUrl::toPercentEncoding(source->name())));
+    return url;
+}
+
+void MediaServer::unpublish(const QUrl &value)
+{
+    const QMutexLocker locker(&m_mutex);
+    m_entries.remove(tokenFromUrl(value));
+}
+
+bool MediaServer::isPublished(const QUrl &value) const
+{
+    const QMutexLocker locker(&m_mutex);
+    if ((m_port == 0) || (value.host() != QStringLiteral("127.0.0.1")) || (value.port() != m_port)) {
+        return false;
+    }
+    return m_entries.contains(tokenFromUrl(value));
+}
+
+QUrl MediaServer::originalUrl(const QUrl &value) const
+{
+    if (!isPublished(value)) {
+        return value;
+    }
+    const QMutexLocker locker(&m_mutex);
+    const QUrl url = m_entries.value(tokenFromUrl(value)).originalUrl;
+    return url.isValid() ? url : value;
+}
+
+qint64 MediaServer::bytesServed() const
+{
+    return m_bytesServed.loadAcquire();
+}
+
+qint64 MediaServer::readTime() const
+{
+    return (m_readTime.loadAcquire() / 1000);
+}
+
+void MediaServer::handleConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        m_connections.insert(socket, {});
+        connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+            handleRequest(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, socket, [this, socket]() {
+            pump(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, socket, [this, socket]() {
+            m_connections.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MediaServer::handleRequest(QTcpSocket *socket)
+{
+    const auto it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+        return;
+    }
+    Connection &connection = it.value();
+    connection.request += socket->readAll();
+    if (connection.source) {
+        // Still sending the previous response, see pump().
+        return;
+    }
+    const int headerEnd = connection.request.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (connection.request.size() > kMaxRequestSize) {
+            socket->abort();
+        }
+        return;
+    }
+    const QByteArray rawRequest = connection.request.left(headerEnd + 4);
+    const QList<QByteArray> lines = connection.request.left(headerEnd).split('\n');
+    connection.request.remove(0, headerEnd + 4);
+    const QList<QByteArray> requestLine = lines.constFirst().trimmed().split(' ');
+    const QByteArray method = requestLine.value(0);
+    const QByteArray target = requestLine.value(1);
+    // /<token>/<name or a path relative to the media>
+    const int nameStart = target.indexOf('/', 1);
+    const QByteArray token = target.mid(1, (nameStart < 0) ? -1 : (nameStart - 1));
+    const QString path = (nameStart < 0) ? QString{} : QString::fromUtf8(target.mid(nameStart + 1));
+    qint64 rangeStart = 0;
+    qint64 rangeEnd = -1;
+    bool hasRange = false;
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray line = lines.at(i).trimmed();
+        if (!line.toLower().startsWith("range:")) {
+            continue;
+        }
+        // bytes=<start>-[<end>], multiple ranges aren't used by FFmpeg.
+        const QByteArray spec = line.mid(6).trimmed().mid(6);
+        const int dash = spec.indexOf('-');
+        if (dash > 0) {
+            hasRange = true;
+            rangeStart = spec.left(dash).toLongLong();
+            const QByteArray last = spec.mid(dash + 1).trimmed();
+            rangeEnd = last.isEmpty() ? -1 : last.toLongLong();
+        }
+    }
+    QSharedPointer<MediaSource> source;
+    {
+        const QMutexLocker locker(&m_mutex);
+        source = m_entries.value(token).source;
+    }
+    if (source && (path != QString::fromUtf8(QUrl::toPercentEncoding(source->name())))) {
+        source = source->resolve(path);
+    }
+    if (source && !source->isReady(rangeStart)) {
+        // Parsed again once the source is ready.
+        source->setReadyCallback([this]() {
+            QMetaObject::invokeMethod(m_worker, [this]() {
+                resumeWaiting();
+            }, Qt::QueuedConnection);
+        });
+        connection.request.prepend(rawRequest);
+        connection.waiting = true;
+        connection.pending = source;
+        if (!source->isReady(rangeStart)) {
+            return;
+        }
+        connection.request.remove(0, rawRequest.size());
+        connection.waiting = false;
+    }
+    connection.pending.reset();
+    if (!source || ((method != "GET") && (method != "HEAD"))) {
+        socket->write(source ? "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n"
+                             : "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        return;
+    }
+    const qint64 size = source->size();
+    QByteArray header = {};
+    connection.offset = 0;
+    connection.end = -1;
+    if (size < 0) {
+        // Can only be streamed once, from where it is now.
+        header = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nConnection: close\r\n\r\n";
+    } else {
+        if (rangeStart >= size) {
+            socket->write("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */"
+                          + QByteArray::number(size) + "\r\nContent-Length: 0\r\n\r\n");
+            return;
+        }
+        connection.offset = rangeStart;
+        connection.end = ((rangeEnd < 0) || (rangeEnd >= size)) ? size : (rangeEnd + 1);
+        header = hasRange ? "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + QByteArray::number(connection.offset)
+                                + '-' + QByteArray::number(connection.end - 1) + '/' + QByteArray::number(size) + "\r\n"
+                          : QByteArray("HTTP/1.1 200 OK\r\n");
+        header += "Content-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\nContent-Length: "
+                  + QByteArray::number(connection.end - connection.offset) + "\r\nConnection: keep-alive\r\n\r\n";
+    }
+    socket->write(header);
+    if (method == "HEAD") {
+        return;
+    }
+    connection.source = source;
+    pump(socket);
+}
+
+void MediaServer::pump(QTcpSocket *socket)
+{
+    const auto it = m_connections.find(socket);
+    if ((it == m_connections.end()) || !it.value().source) {
+        return;
+    }
+    Connection &connection = it.value();
+    const QSharedPointer<MediaSource> source = connection.source;
+    QElapsedTimer timer;
+    timer.start();
+    while ((socket->bytesToWrite() < kHighWaterMark)
+           && ((connection.end < 0) || (connection.offset < connection.end))) {
+        if (!source->isReady(connection.offset)) {
+            source->setReadyCallback([this]() {
+                QMetaObject::invokeMethod(m_worker, [this]() {
+                    resumeWaiting();
+                }, Qt::QueuedConnection);
+            });
+            connection.waiting = true;
+            // It may have become ready meanwhile.
+            if (!source->isReady(connection.offset)) {
+                break;
+            }
+            connection.waiting = false;
+        }
+        const qint64 wanted = (connection.end < 0) ? kChunkSize : qMin(kChunkSize, connection.end - connection.offset);
+        const QByteArray data = source->read(connection.offset, wanted);
+        if (data.isEmpty()) {
+            // The end of a stream without size, or a broken source. Either
+            // way the client can only tell by the connection being closed.
+            connection.source.reset();
+            socket->disconnectFromHost();
+            break;
+        }
+        socket->write(data);
+        connection.offset += data.size();
+        m_bytesServed.fetchAndAddOrdered(data.size());
+    }
+    const qint64 us = timer.nsecsElapsed() / 1000;
+    m_readTime.fetchAndAddOrdered(us);
+    source->addReadTime(us);
+    if ((connection.end >= 0) && (connection.offset >= connection.end)) {
+        connection.source.reset();
+        // A request may have arrived while we were busy.
+        if (!connection.request.isEmpty()) {
+            handleRequest(socket);
+        }
+    }
+}
+
+void MediaServer::resumeWaiting()
+{
+    const QList<QTcpSocket *> sockets = m_connections.keys();
+    for (auto &&socket : qAsConst(sockets)) {
+        const auto it = m_connections.find(socket);
+        if ((it == m_connections.end()) || !it.value().waiting) {
+            continue;
+        }
+        it.value().waiting = false;
+        if (it.value().source) {
+            pump(socket);
+        } else {
+            handleRequest(socket);
+        }
+    }
+}
+
+MDKPLAYER_END_NAMESPACE
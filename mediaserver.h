@@ -0,0 +1,114 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qatomic.h>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QThread)
+QT_FORWARD_DECLARE_CLASS(QTcpServer)
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_END_NAMESPACE
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class MediaSource;
+
+// A tiny HTTP/1.1 server on the loopback interface that serves MediaSources
+// to MDK, so it can play anything it can't open by itself (resources,
+// memory, encrypted containers) without a temporary file. FFmpeg's http
+// protocol does the rest: range requests make seeking work and keep-alive
+// connections are reused. Every source gets an unguessable url, nothing is
+// reachable from other machines.
+class MDKPLAYER_API MediaServer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MediaServer)
+
+public:
+    explicit MediaServer(QObject *parent = nullptr);
+    ~MediaServer() override;
+
+    static MediaServer *instance();
+
+    // Returns the url MDK should open, invalid if the server can't start.
+    QUrl publish(const QSharedPointer<MediaSource> &source, const QUrl &originalUrl = {});
+    void unpublish(const QUrl &value);
+    bool isPublished(const QUrl &value) const;
+    // The url the source was published for, the published url itself if none.
+    QUrl originalUrl(const QUrl &value) const;
+
+    // Bytes sent to MDK so far and the milliseconds spent reading them from
+    // the sources, for throughput measurements.
+    qint64 bytesServed() const;
+    qint64 readTime() const;
+
+private:
+    bool ensureStarted();
+    void handleConnection();
+    void handleRequest(QTcpSocket *socket);
+    void pump(QTcpSocket *socket);
+    void resumeWaiting();
+
+private:
+    struct Entry
+    {
+        QSharedPointer<MediaSource> source;
+        QUrl originalUrl = {};
+    };
+
+    struct Connection
+    {
+        QByteArray request = {};
+        QSharedPointer<MediaSource> source;
+        qint64 offset = 0;
+        // -1 to read until the source ends.
+        qint64 end = -1;
+        // For the source to get the data, see MediaSource::isReady().
+        bool waiting = false;
+        // Keeps the source of a deferred request alive.
+        QSharedPointer<MediaSource> pending;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<QByteArray, Entry> m_entries = {};
+    QThread *m_thread = nullptr;
+    QObject *m_worker = nullptr;
+    QTcpServer *m_server = nullptr;
+    quint16 m_port = 0;
+    // Only touched by the server thread.
+    QHash<QTcpSocket *, Connection> m_connections = {};
+    QAtomicInteger<qint64> m_bytesServed = 0;
+    // In microseconds.
+    QAtomicInteger<qint64> m_readTime = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,340 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mediasource.h"
+#include <QtCore/qfileinfo.h>
+#ifdef Q_OS_WINDOWS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-ahead in seconds of media, and its bounds in bytes.
+static constexpr const qint64 kReadAheadDuration = 4;
+static constexpr const qint64 kMinReadAhead = 8 * 1024 * 1024;
+static constexpr const qint64 kMaxReadAhead = 256 * 1024 * 1024;
+// FFmpeg seeks back a little now and then, e.g. to re-read an index.
+static constexpr const qint64 kKeepBehind = 32 * 1024 * 1024;
+
+// A growing file is over once it hasn't grown for this long.
+static constexpr const qint64 kTailIdleTimeout = 10000;
+// How much of a growing MPEG-TS file is played before the write head,
+// enough for a key frame at usual bit rates.
+static constexpr const qint64 kTailStartBytes = 2 * 1024 * 1024;
+// Weight of a new measurement in the growth rate.
+static constexpr const qreal kGrowthWeight = 0.2;
+
+static inline qint64 pageSize()
+{
+#ifdef Q_OS_WINDOWS
+    SYSTEM_INFO info = {};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+MediaSource::MediaSource(const QString &name) : m_name(name)
+{
+}
+
+MediaSource::~MediaSource() = default;
+
+QString MediaSource::name() const
+{
+    return m_name;
+}
+
+bool MediaSource::isReady(const qint64 offset)
+{
+    Q_UNUSED(offset);
+    return true;
+}
+
+QSharedPointer<MediaSource> MediaSource::resolve(const QString &path)
+{
+    Q_UNUSED(path);
+    return {};
+}
+
+void MediaSource::setReadyCallback(const std::function<void()> &callback)
+{
+    const QMutexLocker locker(&m_callbackMutex);
+    m_readyCallback = callback;
+}
+
+void MediaSource::notifyReady()
+{
+    const QMutexLocker locker(&m_callbackMutex);
+    if (m_readyCallback) {
+        m_readyCallback();
+    }
+}
+
+qint64 MediaSource::readTime() const
+{
+    return (m_readTime.loadAcquire() / 1000);
+}
+
+void MediaSource::addReadTime(const qint64 us)
+{
+    m_readTime.fetchAndAddOrdered(us);
+}
+
+BufferSource::BufferSource(const QByteArray &data, const QString &name) : MediaSource(name), m_data(data)
+{
+}
+
+BufferSource::~BufferSource() = default;
+
+qint64 BufferSource::size() const
+{
+    return m_data.size();
+}
+
+QByteArray BufferSource::read(const qint64 offset, const qint64 maxSize)
+{
+    if ((offset < 0) || (offset >= m_data.size()) || (maxSize <= 0)) {
+        return {};
+    }
+    const qint64 length = qMin(maxSize, m_data.size() - offset);
+    // m_data outlives the result, it's only dropped with the source.
+    return QByteArray::fromRawData(m_data.constData() + offset, length);
+}
+
+DeviceSource::DeviceSource(QIODevice *device, const QString &name, const bool owned)
+    : MediaSource(name), m_device(device)
+{
+    if (owned) {
+        m_ownedDevice.reset(device);
+    }
+    if (m_device && !m_device->isOpen()) {
+        m_device->open(QIODevice::ReadOnly);
+    }
+}
+
+DeviceSource::~DeviceSource() = default;
+
+qint64 DeviceSource::size() const
+{
+    const QMutexLocker locker(&m_mutex);
+    if (!m_device || m_device->isSequential()) {
+        return -1;
+    }
+    return m_device->size();
+}
+
+QByteArray DeviceSource::read(const qint64 offset, const qint64 maxSize)
+{
+    const QMutexLocker locker(&m_mutex);
+    if (!m_device || !m_device->isReadable() || (maxSize <= 0)) {
+        return {};
+    }
+    if (!m_device->isSequential() && (m_device->pos() != offset) && !m_device->seek(offset)) {
+        return {};
+    }
+    return m_device->read(maxSize);
+}
+
+MappedFileSource::MappedFileSource(const QString &filePath)
+    : MediaSource(QFileInfo(filePath).fileName()), m_file(filePath)
+{
+    if (!m_file.open(QFile::ReadOnly)) {
+        return;
+    }
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        m_file.close();
+        return;
+    }
+    m_readAhead = kMinReadAhead;
+#ifndef Q_OS_WINDOWS
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+#endif
+}
+
+MappedFileSource::~MappedFileSource()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+    }
+}
+
+bool MappedFileSource::isValid() const
+{
+    return (m_data != nullptr);
+}
+
+void MappedFileSource::setBitRate(const qint64 value)
+{
+    const QMutexLocker locker(&m_mutex);
+    m_readAhead = qBound(kMinReadAhead, value / 8 * kReadAheadDuration, kMaxReadAhead);
+}
+
+qint64 MappedFileSource::size() const
+{
+    return m_size;
+}
+
+QByteArray MappedFileSource::read(const qint64 offset, const qint64 maxSize)
+{
+    if (!m_data || (offset < 0) || (offset >= m_size) || (maxSize <= 0)) {
+        return {};
+    }
+    advise(offset);
+    // The mapping outlives the result, see BufferSource.
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_data) + offset, qMin(maxSize, m_size - offset));
+}
+
+// Keeps the window ahead of "offset" on its way into memory. It's renewed
+// once half of it has been consumed, or at once after a seek.
+void MappedFileSource::advise(const qint64 offset)
+{
+    const QMutexLocker locker(&m_mutex);
+    if ((offset >= m_advisedBegin) && (offset < (m_advisedEnd - m_readAhead / 2))) {
+        return;
+    }
+    const qint64 page = pageSize();
+    const qint64 begin = offset & ~(page - 1);
+    const qint64 end = qMin(m_size, offset + m_readAhead);
+    m_advisedBegin = begin;
+    m_advisedEnd = end;
+#ifdef Q_OS_WINDOWS
+#if (_WIN32_WINNT >= 0x0602)
+    WIN32_MEMORY_RANGE_ENTRY range = {m_data + begin, static_cast<SIZE_T>(end - begin)};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+    madvise(m_data + begin, end - begin, MADV_WILLNEED);
+    // Drop what we have played, both from the mapping and the page cache.
+    const qint64 dropUntil = qMax(qint64(0), (offset - kKeepBehind)) & ~(page - 1);
+    if (dropUntil < m_droppedUntil) {
+        // Seeked backwards.
+        m_droppedUntil = dropUntil;
+    } else if (dropUntil > m_droppedUntil) {
+        madvise(m_data + m_droppedUntil, dropUntil - m_droppedUntil, MADV_DONTNEED);
+#if defined(POSIX_FADV_DONTNEED)
+        posix_fadvise(m_file.handle(), m_droppedUntil, dropUntil - m_droppedUntil, POSIX_FADV_DONTNEED);
+#endif
+        m_droppedUntil = dropUntil;
+    }
+#endif
+}
+
+GrowingFileSource::GrowingFileSource(const QString &filePath)
+    : MediaSource(QFileInfo(filePath).fileName()), m_file(filePath)
+{
+    if (!m_file.open(QFile::ReadOnly)) {
+        return;
+    }
+    m_fileSize = m_file.size();
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == QStringLiteral("ts")) {
+        m_start = qMax(qint64(0), m_fileSize - kTailStartBytes) / 188 * 188;
+    } else if ((suffix == QStringLiteral("m2ts")) || (suffix == QStringLiteral("mts"))) {
+        m_start = qMax(qint64(0), m_fileSize - kTailStartBytes) / 192 * 192;
+    }
+    m_readOffset = m_start;
+    m_growthTimer.start();
+}
+
+GrowingFileSource::~GrowingFileSource() = default;
+
+bool GrowingFileSource::isValid() const
+{
+    return m_file.isOpen();
+}
+
+QString GrowingFileSource::filePath() const
+{
+    return m_file.fileName();
+}
+
+void GrowingFileSource::refresh()
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        if (m_finished || !m_file.isOpen()) {
+            return;
+        }
+        const qint64 fileSize = m_file.size();
+        if (fileSize > m_fileSize) {
+            const qint64 elapsed = m_growthTimer.restart();
+            if (elapsed > 0) {
+                const qreal rate = qreal(fileSize - m_fileSize) / elapsed;
+                m_bytesPerMs = (m_bytesPerMs <= 0.0) ? rate : ((m_bytesPerMs * (1.0 - kGrowthWeight)) + (rate * kGrowthWeight));
+            }
+            m_fileSize = fileSize;
+        } else if ((fileSize < m_fileSize) || m_growthTimer.hasExpired(kTailIdleTimeout)) {
+            // Truncated or no longer written to.
+            m_finished = true;
+        } else {
+            return;
+        }
+    }
+    notifyReady();
+}
+
+qint64 GrowingFileSource::backlog() const
+{
+    const QMutexLocker locker(&m_mutex);
+    if (m_bytesPerMs <= 0.0) {
+        return 0;
+    }
+    return qRound64((m_fileSize - m_readOffset) / m_bytesPerMs);
+}
+
+qint64 GrowingFileSource::size() const
+{
+    return -1;
+}
+
+QByteArray GrowingFileSource::read(const qint64 offset, const qint64 maxSize)
+{
+    const QMutexLocker locker(&m_mutex);
+    const qint64 position = m_start + offset;
+    if ((offset < 0) || (maxSize <= 0) || (position >= m_fileSize)) {
+        return {};
+    }
+    if ((m_file.pos() != position) && !m_file.seek(position)) {
+        return {};
+    }
+    const QByteArray data = m_file.read(qMin(maxSize, m_fileSize - position));
+    m_readOffset = position + data.size();
+    return data;
+}
+
+bool GrowingFileSource::isReady(const qint64 offset)
+{
+    const QMutexLocker locker(&m_mutex);
+    return (m_finished || !m_file.isOpen() || ((m_start + offset) < m_fileSize));
+}
+
+MDKPLAYER_END_NAMESPACE
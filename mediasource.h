@@ -0,0 +1,204 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qbytearray.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qiodevice.h>
+#include <QtCore/qscopedpointer.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qelapsedtimer.h>
+#include <functional>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Random access to the bytes of a media, served to MDK by MediaServer.
+// read() is called from the server thread.
+class MDKPLAYER_API MediaSource
+{
+    Q_DISABLE_COPY_MOVE(MediaSource)
+
+public:
+    explicit MediaSource(const QString &name);
+    virtual ~MediaSource();
+
+    // Used for the url, so that the file name and the extension survive.
+    QString name() const;
+
+    // -1 if unknown, the media is then streamed from the start only.
+    virtual qint64 size() const = 0;
+    // Returns at most maxSize bytes starting at offset, an empty array at
+    // the end or on error. Implementations should avoid copying when the
+    // data is in memory already, the result may refer to it directly.
+    virtual QByteArray read(const qint64 offset, const qint64 maxSize) = 0;
+
+    // Sources that have to fetch their data return false until the data at
+    // "offset" (and the size) is available and call notifyReady() then.
+    // A failed source must return true, read() reports the error.
+    virtual bool isReady(const qint64 offset);
+    // Another media relative to this one, e.g. a segment of a playlist,
+    // "path" is percent-encoded. Null if there is no such thing.
+    virtual QSharedPointer<MediaSource> resolve(const QString &path);
+    // Called from any thread.
+    void setReadyCallback(const std::function<void()> &callback);
+
+    // Milliseconds the server spent getting the data of this source to MDK,
+    // page faults and blocking reads included.
+    qint64 readTime() const;
+    void addReadTime(const qint64 us);
+
+protected:
+    void notifyReady();
+
+private:
+    QString m_name = {};
+    QMutex m_callbackMutex;
+    std::function<void()> m_readyCallback = nullptr;
+    // In microseconds.
+    QAtomicInteger<qint64> m_readTime = 0;
+};
+
+// Memory the caller already has, e.g. a decrypted media. Reads refer to
+// the buffer without copying it.
+class MDKPLAYER_API BufferSource : public MediaSource
+{
+    Q_DISABLE_COPY_MOVE(BufferSource)
+
+public:
+    explicit BufferSource(const QByteArray &data, const QString &name);
+    ~BufferSource() override;
+
+    qint64 size() const override;
+    QByteArray read(const qint64 offset, const qint64 maxSize) override;
+
+private:
+    // Implicitly shared, we only keep a reference.
+    QByteArray m_data = {};
+};
+
+// Any QIODevice: files in resources, decrypting devices and so on. The
+// device must not be used by anyone else while it's being played, it's read
+// from the server thread.
+class MDKPLAYER_API DeviceSource : public MediaSource
+{
+    Q_DISABLE_COPY_MOVE(DeviceSource)
+
+public:
+    // Takes the ownership if "owned" is true, otherwise the device must stay
+    // alive until the media is closed.
+    explicit DeviceSource(QIODevice *device, const QString &name, const bool owned = false);
+    ~DeviceSource() override;
+
+    qint64 size() const override;
+    QByteArray read(const qint64 offset, const qint64 maxSize) override;
+
+private:
+    mutable QMutex m_mutex;
+    QPointer<QIODevice> m_device = nullptr;
+    QScopedPointer<QIODevice> m_ownedDevice;
+};
+
+// A local file mapped into memory, for high bit rate media on slow or
+// network storage: reads are served from the mapping without a syscall,
+// the kernel is asked to read ahead of the play head (sized from the bit
+// rate) and the pages far behind it are dropped so a long media doesn't
+// fill the page cache. Seeks get their read-ahead at once.
+class MDKPLAYER_API MappedFileSource : public MediaSource
+{
+    Q_DISABLE_COPY_MOVE(MappedFileSource)
+
+public:
+    explicit MappedFileSource(const QString &filePath);
+    ~MappedFileSource() override;
+
+    // False if the file can't be opened or mapped, e.g. too large for the
+    // address space. Play the file directly in that case.
+    bool isValid() const;
+
+    // Bits per second, 0 if unknown.
+    void setBitRate(const qint64 value);
+
+    qint64 size() const override;
+    QByteArray read(const qint64 offset, const qint64 maxSize) override;
+
+private:
+    void advise(const qint64 offset);
+
+private:
+    mutable QMutex m_mutex;
+    QFile m_file;
+    uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_readAhead = 0;
+    qint64 m_advisedBegin = -1;
+    qint64 m_advisedEnd = -1;
+    qint64 m_droppedUntil = 0;
+};
+
+// A local file that is still being written, e.g. a recording. It's served
+// as a stream without a size and reads wait at the end of the file, so
+// FFmpeg never hits the end while the writer is active. The owner calls
+// refresh() whenever the file may have grown. The stream ends once the
+// file hasn't grown for a while. MPEG-TS files start close to the write
+// head, other containers need their header and start from the beginning.
+class MDKPLAYER_API GrowingFileSource : public MediaSource
+{
+    Q_DISABLE_COPY_MOVE(GrowingFileSource)
+
+public:
+    explicit GrowingFileSource(const QString &filePath);
+    ~GrowingFileSource() override;
+
+    bool isValid() const;
+    QString filePath() const;
+
+    // Checks the size of the file, wakes up waiting reads if it has grown.
+    void refresh();
+
+    // Milliseconds of media written but not read yet, estimated from how
+    // fast the file grows.
+    qint64 backlog() const;
+
+    qint64 size() const override;
+    QByteArray read(const qint64 offset, const qint64 maxSize) override;
+    bool isReady(const qint64 offset) override;
+
+private:
+    mutable QMutex m_mutex;
+    QFile m_file;
+    // Where the stream starts in the file.
+    qint64 m_start = 0;
+    qint64 m_fileSize = 0;
+    qint64 m_readOffset = 0;
+    qreal m_bytesPerMs = 0.0;
+    bool m_finished = false;
+    QElapsedTimer m_growthTimer;
+};
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,237 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pipelinecache.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qcryptographichash.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtQuick/qquickwindow.h>
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
+#include <QtQuick/qquickgraphicsconfiguration.h>
+#endif
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 6, 0))
+#include <rhi/qrhi.h>
+#elif (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
+#include <QtGui/private/qrhi_p.h>
+#endif
+
+// Pipelines are created lazily, the ones of the video item are usually
+// there after the first frames.
+static constexpr const int kStatisticsFrame = 60;
+
+static const char kAttachedProperty[] = "_mdkplayer_pipelineCacheAttached";
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+PipelineCache::PipelineCache(const QString &directory, QObject *parent) : QObject(parent), m_directory(directory)
+{
+}
+
+PipelineCache::~PipelineCache() = default;
+
+PipelineCache *PipelineCache::instance()
+{
+    static PipelineCache cache(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+                                   .filePath(QStringLiteral("mdkplayer_pipelines")));
+    return &cache;
+}
+
+bool PipelineCache::supported()
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
+    return true;
+#else
+    return false;
+#endif
+}
+
+QString PipelineCache::directory() const
+{
+    return m_directory;
+}
+
+int PipelineCache::hits() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+int PipelineCache::misses() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+qint64 PipelineCache::loadTime() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_loadTime;
+}
+
+qint64 PipelineCache::pipelineCreationTime() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_pipelineCreationTime;
+}
+
+QString PipelineCache::driver() const
+{
+    const QMutexLocker locker(&m_mutex);
+    return m_driver;
+}
+
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
+// One file per graphics API, device and Qt version. QRhi also refuses the
+// data of another driver version, that's counted as a miss then.
+QString PipelineCache::cacheFilePath(const QRhi *rhi) const
+{
+    const QRhiDriverInfo info = rhi->driverInfo();
+    const QByteArray device = info.deviceName + '/' + QByteArray::number(info.vendorId) + '/' + QByteArray::number(info.deviceId);
+    const QString deviceKey = QString::fromLatin1(QCryptographicHash::hash(device, QCryptographicHash::Sha1).toHex().left(16));
+    return QDir(m_directory).filePath(QStringLiteral("pipelines_%1_%2_qt%3.bin").arg(
+        QString::fromLatin1(rhi->backendName()).toLower(), deviceKey, QString::fromLatin1(qVersion())));
+}
+
+// Called on the render thread right after the QRhi has been created, no
+// pipeline exists yet.
+void PipelineCache::load(QQuickWindow *window)
+{
+    const auto rhi = static_cast<QRhi *>(window->rendererInterface()->getResource(window, QSGRendererInterface::RhiResource));
+    if (!rhi) {
+        return;
+    }
+    const QString filePath = cacheFilePath(rhi);
+    QElapsedTimer timer;
+    timer.start();
+    QFile file(filePath);
+    const QByteArray data = file.open(QFile::ReadOnly) ? file.readAll() : QByteArray{};
+    file.close();
+    bool hit = false;
+    if (!data.isEmpty()) {
+        rhi->setPipelineCacheData(data);
+        // QRhi drops the data of another driver or device silently. What it
+        // took, it serializes back at about the same size.
+        hit = (rhi->pipelineCacheData().size() >= (data.size() / 2));
+    }
+    const qint64 loadTime = timer.elapsed();
+    const QString driver = QString::fromUtf8(rhi->driverInfo().deviceName);
+    {
+        const QMutexLocker locker(&m_mutex);
+        if (hit) {
+            ++m_hits;
+        } else {
+            ++m_misses;
+        }
+        m_loadTime = loadTime;
+        m_driver = driver;
+    }
+    qDebug() << "Pipeline cache" << (hit ? "hit:" : (data.isEmpty() ? "miss:" : "rejected:")) << filePath
+             << "loaded in" << loadTime << "ms.";
+    QMetaObject::invokeMethod(this, &PipelineCache::statisticsChanged, Qt::QueuedConnection);
+}
+
+// Called on the render thread.
+void PipelineCache::save(QQuickWindow *window)
+{
+    const auto rhi = static_cast<QRhi *>(window->rendererInterface()->getResource(window, QSGRendererInterface::RhiResource));
+    if (!rhi) {
+        return;
+    }
+    const QByteArray data = rhi->pipelineCacheData();
+    if (data.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(m_directory);
+    QSaveFile file(cacheFilePath(rhi));
+    if (!file.open(QFile::WriteOnly) || (file.write(data) != data.size()) || !file.commit()) {
+        qWarning() << "Pipeline cache: failed to write" << file.fileName();
+    }
+}
+#endif
+
+bool PipelineCache::attach(QQuickWindow *window)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
+    if (!window) {
+        return false;
+    }
+    if (window->property(kAttachedProperty).toBool()) {
+        return true;
+    }
+    if (window->isSceneGraphInitialized()) {
+        qDebug() << "Pipeline cache: the scene graph of" << window << "is running already, attach it before it's shown.";
+        return false;
+    }
+    QDir().mkpath(m_directory);
+    QQuickGraphicsConfiguration config = window->graphicsConfiguration();
+    // The device isn't known before the scene graph is initialized, so we
+    // load and save the cache ourselves. Qt only lets QRhi hand out its
+    // cache data if a save file is set, Qt writes that one on exit and it's
+    // never read.
+    config.setPipelineCacheSaveFile(QDir(m_directory).filePath(QStringLiteral("pipelines_last.bin")));
+    window->setGraphicsConfiguration(config);
+    window->setProperty(kAttachedProperty, true);
+    // All emitted on the render thread.
+    connect(window, &QQuickWindow::sceneGraphInitialized, this, [this, window]() {
+        load(window);
+    }, Qt::DirectConnection);
+    connect(window, &QQuickWindow::sceneGraphAboutToStop, this, [this, window]() {
+        save(window);
+    }, Qt::DirectConnection);
+    const auto frames = QSharedPointer<int>::create(0);
+    const auto connection = QSharedPointer<QMetaObject::Connection>::create();
+    *connection = connect(window, &QQuickWindow::afterFrameEnd, this, [this, window, frames, connection]() {
+        if (++(*frames) < kStatisticsFrame) {
+            return;
+        }
+        disconnect(*connection);
+        const auto rhi = static_cast<QRhi *>(window->rendererInterface()->getResource(window, QSGRendererInterface::RhiResource));
+        if (!rhi) {
+            return;
+        }
+        const qint64 creationTime = rhi->statistics().totalPipelineCreationTime;
+        {
+            const QMutexLocker locker(&m_mutex);
+            m_pipelineCreationTime = creationTime;
+        }
+        qDebug() << "Pipeline cache:" << driver() << "spent" << creationTime << "ms creating pipelines.";
+        // Don't rely on a clean exit alone, the pipelines of the first
+        // frames are the ones that matter.
+        save(window);
+        QMetaObject::invokeMethod(this, &PipelineCache::statisticsChanged, Qt::QueuedConnection);
+    }, Qt::DirectConnection);
+    return true;
+#else
+    Q_UNUSED(window);
+    return false;
+#endif
+}
+
+MDKPLAYER_END_NAMESPACE
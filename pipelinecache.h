@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qmutex.h>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QQuickWindow)
+QT_FORWARD_DECLARE_CLASS(QRhi)
+QT_END_NAMESPACE
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Keeps Qt Quick's graphics pipelines (shaders included) on disk between
+// runs, so a new process doesn't have to compile them again. Every window a
+// player is shown in is attached automatically, but that's only effective if
+// it happens before the window's scene graph is initialized, i.e. before the
+// window is shown. Attach windows created from C++ manually in that case.
+// Needs Qt 6.5 or newer, it's a no-op otherwise. The cache is kept per
+// graphics API, device and Qt version. It's handed to QRhi once the device
+// is known, QRhi validates the driver itself and a cache it refuses is
+// counted as a miss, recompiled and replaced.
+class MDKPLAYER_API PipelineCache : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(PipelineCache)
+
+    Q_PROPERTY(bool supported READ supported CONSTANT)
+    Q_PROPERTY(QString directory READ directory CONSTANT)
+    Q_PROPERTY(int hits READ hits NOTIFY statisticsChanged)
+    Q_PROPERTY(int misses READ misses NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 loadTime READ loadTime NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 pipelineCreationTime READ pipelineCreationTime NOTIFY statisticsChanged)
+    Q_PROPERTY(QString driver READ driver NOTIFY statisticsChanged)
+
+public:
+    explicit PipelineCache(const QString &directory, QObject *parent = nullptr);
+    ~PipelineCache() override;
+
+    static PipelineCache *instance();
+
+    static bool supported();
+
+    QString directory() const;
+
+    // Windows whose cache QRhi accepted and windows without a usable one.
+    int hits() const;
+    int misses() const;
+    // Milliseconds the last attached window took to read its cache and hand
+    // it to QRhi.
+    qint64 loadTime() const;
+    // Milliseconds the last attached window spent creating pipelines for its
+    // first frames, the number the cache is supposed to bring down.
+    qint64 pipelineCreationTime() const;
+    // Driver of the last attached window, as reported by the graphics backend.
+    QString driver() const;
+
+public Q_SLOTS:
+    // Returns false if the window can't use a cache (anymore).
+    bool attach(QQuickWindow *window);
+
+Q_SIGNALS:
+    void statisticsChanged();
+
+private:
+    QString cacheFilePath(const QRhi *rhi) const;
+    void load(QQuickWindow *window);
+    void save(QQuickWindow *window);
+
+private:
+    QString m_directory = {};
+    mutable QMutex m_mutex;
+    int m_hits = 0;
+    int m_misses = 0;
+    qint64 m_loadTime = 0;
+    qint64 m_pipelineCreationTime = 0;
+    QString m_driver = {};
+};
+
+MDKPLAYER_END_NAMESPACE
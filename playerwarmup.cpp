@@ -0,0 +1,437 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "playerwarmup.h"
+#include "mdkplayer.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qtemporaryfile.h>
+#include <QtQuick/qquickwindow.h>
+
+#if QT_CONFIG(opengl)
+#include <QtGui/qopenglcontext.h>
+#include <QtGui/qoffscreensurface.h>
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+#include <QtOpenGL/qopenglframebufferobject.h>
+#else
+#include <QtGui/qopenglframebufferobject.h>
+#endif
+#endif
+
+// MDK headers must be placed under these graphic headers.
+#include <mdk/Player.h>
+#include <mdk/RenderAPI.h>
+#include <mdk/VideoFrame.h>
+#include <set>
+
+// Enough frames to get past the decoder's and the renderer's initialization.
+static constexpr const int kWarmUpFrames = 8;
+static constexpr const qint64 kWarmUpTimeout = 5000;
+static constexpr const int kWarmUpSurfaceSize = 64;
+// The generated sample, in macroblocks. Small, but not below the minimum
+// size of the hardware decoders.
+static constexpr const int kSampleWidthInMbs = 4;
+static constexpr const int kSampleHeightInMbs = 4;
+
+// Writes the bits of an H.264 RBSP.
+class BitWriter
+{
+public:
+    void bits(const quint32 value, const int count)
+    {
+        for (int i = count - 1; i >= 0; --i) {
+            m_current = quint8((m_current << 1) | ((value >> i) & 1));
+            if (++m_count == 8) {
+                m_data.append(char(m_current));
+                m_current = 0;
+                m_count = 0;
+            }
+        }
+    }
+
+    // Exp-Golomb, ue(v).
+    void ue(const quint32 value)
+    {
+        const quint32 code = value + 1;
+        int length = 0;
+        while ((code >> length) > 1) {
+            ++length;
+        }
+        bits(0, length);
+        bits(code, length + 1);
+    }
+
+    void align()
+    {
+        while (m_count != 0) {
+            bits(0, 1);
+        }
+    }
+
+    void bytes(const QByteArray &value)
+    {
+        m_data.append(value);
+    }
+
+    // rbsp_trailing_bits()
+    QByteArray finish()
+    {
+        bits(1, 1);
+        align();
+        return m_data;
+    }
+
+private:
+    QByteArray m_data = {};
+    quint8 m_current = 0;
+    int m_count = 0;
+};
+
+// Annex B start code, header and the RBSP with emulation prevention bytes.
+static inline QByteArray nalUnit(const quint8 header, const QByteArray &rbsp)
+{
+    QByteArray result = QByteArrayLiteral("\x00\x00\x00\x01");
+    result.append(char(header));
+    int zeros = 0;
+    for (auto &&byte : rbsp) {
+        if ((zeros >= 2) && (quint8(byte) <= 3)) {
+            result.append('\x03');
+            zeros = 0;
+        }
+        result.append(byte);
+        zeros = (byte == 0) ? (zeros + 1) : 0;
+    }
+    return result;
+}
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+PlayerWarmUp::PlayerWarmUp(QObject *parent) : QObject(parent)
+{
+}
+
+PlayerWarmUp::~PlayerWarmUp()
+{
+    if (running()) {
+        finish();
+    }
+}
+
+PlayerWarmUp *PlayerWarmUp::instance()
+{
+    static PlayerWarmUp warmUp;
+    return &warmUp;
+}
+
+bool PlayerWarmUp::running() const
+{
+    return !m_player.isNull();
+}
+
+bool PlayerWarmUp::done() const
+{
+    return m_done;
+}
+
+qint64 PlayerWarmUp::coldOpenLatency() const
+{
+    return m_coldOpenLatency;
+}
+
+qint64 PlayerWarmUp::warmOpenLatency() const
+{
+    return m_warmOpenLatency;
+}
+
+qint64 PlayerWarmUp::duration() const
+{
+    return m_duration;
+}
+
+void PlayerWarmUp::start(const QUrl &sample, const QStringList &decoders)
+{
+    if (running() || m_done) {
+        return;
+    }
+    if (sample.isValid()) {
+        m_source = sample.isLocalFile() ? QDir::toNativeSeparators(sample.toLocalFile()) : sample.url();
+    } else {
+        m_generatedSample.reset(generateSample());
+        m_source = m_generatedSample ? m_generatedSample->fileName() : QString{};
+    }
+    if (m_source.isEmpty()) {
+        qWarning() << "Warm-up: no sample media available.";
+        m_generatedSample.reset();
+        return;
+    }
+    m_decoders = decoders.isEmpty() ? MDKPlayer::defaultVideoDecoders() : decoders;
+    m_coldOpenLatency = -1;
+    m_warmOpenLatency = -1;
+    m_warm = false;
+    m_elapsed.start();
+    createOffscreenRenderer();
+    startPass();
+    m_timerId = startTimer(20);
+    qDebug() << "Warm-up started with" << m_source;
+    Q_EMIT runningChanged();
+}
+
+void PlayerWarmUp::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+    if (!running()) {
+        return;
+    }
+    const auto status = m_player->mediaStatus();
+    if ((m_frames.loadAcquire() < kWarmUpFrames)
+            && !MDK_NS_PREPEND(test_flag)(status & MDK_NS_PREPEND(MediaStatus)::End)
+            && !MDK_NS_PREPEND(test_flag)(status & MDK_NS_PREPEND(MediaStatus)::Invalid)
+            && !m_passTimer.hasExpired(kWarmUpTimeout)) {
+        return;
+    }
+    const qint64 latency = m_firstFrame.loadAcquire();
+    stopPass();
+    if (m_warm) {
+        m_warmOpenLatency = latency;
+        finish();
+        return;
+    }
+    m_coldOpenLatency = latency;
+    if (latency < 0) {
+        // Nothing to compare with.
+        finish();
+        return;
+    }
+    // The same sample once more, what every player pays from now on.
+    m_warm = true;
+    startPass();
+}
+
+void PlayerWarmUp::startPass()
+{
+    m_frames.storeRelease(0);
+    m_firstFrame.storeRelease(-1);
+    m_player.reset(new MDK_NS_PREPEND(Player));
+    m_player->setMute(true);
+    m_player->setActiveTracks(MDK_NS_PREPEND(MediaType)::Subtitle, std::set<int>{});
+    m_player->setDecoders(MDK_NS_PREPEND(MediaType)::Video,
+        [this]() {
+            std::vector<std::string> result = {};
+            for (auto &&decoder : qAsConst(m_decoders)) {
+                result.push_back(decoder.toStdString());
+            }
+            return result;
+        }());
+#if QT_CONFIG(opengl)
+    if (m_fbo) {
+        MDK_NS_PREPEND(GLRenderAPI) ra = {};
+        ra.fbo = m_fbo->handle();
+        m_player->setRenderAPI(&ra);
+        m_player->setVideoSurfaceSize(kWarmUpSurfaceSize, kWarmUpSurfaceSize);
+        m_player->setRenderCallback([this](void *) {
+            QMetaObject::invokeMethod(this, [this]() {
+                renderFrame();
+            }, Qt::QueuedConnection);
+        });
+    } else
+#endif
+    {
+        // Decoding alone still loads the libraries and the device contexts.
+        m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>([this](MDK_NS_PREPEND(VideoFrame) &frame, int track) {
+            Q_UNUSED(track);
+            if (frame) {
+                m_firstFrame.testAndSetOrdered(-1, m_passTimer.elapsed());
+                m_frames.fetchAndAddOrdered(1);
+            }
+            return 0;
+        });
+    }
+    m_passTimer.start();
+    m_player->setMedia(qUtf8Printable(m_source));
+    m_player->prepare();
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Playing);
+}
+
+void PlayerWarmUp::stopPass()
+{
+    m_player->setRenderCallback(nullptr);
+    m_player->onFrame<MDK_NS_PREPEND(VideoFrame)>(nullptr);
+    m_player->setState(MDK_NS_PREPEND(PlaybackState)::Stopped);
+    m_player->waitFor(MDK_NS_PREPEND(PlaybackState)::Stopped);
+#if QT_CONFIG(opengl)
+    if (m_context && m_context->makeCurrent(m_surface.data())) {
+        // The renderer's GL resources must go while their context is current.
+        m_player->setVideoSurfaceSize(-1, -1);
+        m_player.reset();
+        m_context->doneCurrent();
+    }
+#endif
+    m_player.reset();
+}
+
+// Same setup as the OpenGL path of VideoTextureNodePublic, so the shaders MDK
+// compiles here are the ones the first real player needs.
+bool PlayerWarmUp::createOffscreenRenderer()
+{
+#if QT_CONFIG(opengl)
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    if (QQuickWindow::graphicsApi() != QSGRendererInterface::OpenGL) {
+        return false;
+    }
+#else
+    if (!QQuickWindow::sceneGraphBackend().isEmpty()) {
+        return false;
+    }
+#endif
+    m_surface.reset(new QOffscreenSurface);
+    m_surface->setFormat(QSurfaceFormat::defaultFormat());
+    m_surface->create();
+    m_context.reset(new QOpenGLContext);
+    m_context->setFormat(QSurfaceFormat::defaultFormat());
+    if (!m_context->create() || !m_context->makeCurrent(m_surface.data())) {
+        qWarning() << "Warm-up: failed to create an offscreen OpenGL context, only decoding.";
+        m_context.reset();
+        m_surface.reset();
+        return false;
+    }
+    m_fbo.reset(new QOpenGLFramebufferObject(kWarmUpSurfaceSize, kWarmUpSurfaceSize));
+    m_context->doneCurrent();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PlayerWarmUp::renderFrame()
+{
+#if QT_CONFIG(opengl)
+    if (!running() || !m_context || !m_context->makeCurrent(m_surface.data())) {
+        return;
+    }
+    if (m_player->renderVideo() >= 0) {
+        m_firstFrame.testAndSetOrdered(-1, m_passTimer.elapsed());
+        m_frames.fetchAndAddOrdered(1);
+    }
+    m_context->doneCurrent();
+#endif
+}
+
+void PlayerWarmUp::finish()
+{
+    killTimer(m_timerId);
+    m_timerId = 0;
+    if (m_player) {
+        stopPass();
+    }
+#if QT_CONFIG(opengl)
+    if (m_context && m_context->makeCurrent(m_surface.data())) {
+        m_fbo.reset();
+        m_context->doneCurrent();
+    }
+    m_fbo.reset();
+    m_context.reset();
+    m_surface.reset();
+#endif
+    // Removes the file.
+    m_generatedSample.reset();
+    m_duration = m_elapsed.elapsed();
+    m_done = true;
+    qDebug() << "Warm-up finished in" << m_duration << "ms, first open latency -->" << m_coldOpenLatency
+             << "ms cold," << m_warmOpenLatency << "ms warm.";
+    Q_EMIT runningChanged();
+    Q_EMIT finished();
+}
+
+// A short H.264 clip, so that the decoder chain comes up as it would for
+// real media, hardware decoders included. There's no encoder around, but
+// I_PCM macroblocks carry raw samples: constrained baseline, every frame a
+// single IDR slice. A temporary file, every process gets its own.
+QTemporaryFile *PlayerWarmUp::generateSample()
+{
+    QScopedPointer<QTemporaryFile> file(new QTemporaryFile(QDir::temp().filePath(QStringLiteral("mdkplayer_warmup_XXXXXX.h264"))));
+    if (!file->open()) {
+        return nullptr;
+    }
+    BitWriter sps;
+    sps.bits(66, 8);   // profile_idc: baseline
+    sps.bits(0xC0, 8); // constraint_set0_flag, constraint_set1_flag: constrained baseline
+    sps.bits(10, 8);   // level_idc
+    sps.ue(0);         // seq_parameter_set_id
+    sps.ue(0);         // log2_max_frame_num_minus4
+    sps.ue(2);         // pic_order_cnt_type
+    sps.ue(1);         // max_num_ref_frames
+    sps.bits(0, 1);    // gaps_in_frame_num_value_allowed_flag
+    sps.ue(kSampleWidthInMbs - 1);
+    sps.ue(kSampleHeightInMbs - 1);
+    sps.bits(1, 1);    // frame_mbs_only_flag
+    sps.bits(1, 1);    // direct_8x8_inference_flag
+    sps.bits(0, 1);    // frame_cropping_flag
+    sps.bits(0, 1);    // vui_parameters_present_flag
+    file->write(nalUnit(0x67, sps.finish()));
+    BitWriter pps;
+    pps.ue(0);         // pic_parameter_set_id
+    pps.ue(0);         // seq_parameter_set_id
+    pps.bits(0, 1);    // entropy_coding_mode_flag: CAVLC
+    pps.bits(0, 1);    // bottom_field_pic_order_in_frame_present_flag
+    pps.ue(0);         // num_slice_groups_minus1
+    pps.ue(0);         // num_ref_idx_l0_default_active_minus1
+    pps.ue(0);         // num_ref_idx_l1_default_active_minus1
+    pps.bits(0, 1);    // weighted_pred_flag
+    pps.bits(0, 2);    // weighted_bipred_idc
+    pps.ue(0);         // pic_init_qp_minus26, se(v) 0 is ue(v) 0
+    pps.ue(0);         // pic_init_qs_minus26
+    pps.ue(0);         // chroma_qp_index_offset
+    pps.bits(0, 1);    // deblocking_filter_control_present_flag
+    pps.bits(0, 1);    // constrained_intra_pred_flag
+    pps.bits(0, 1);    // redundant_pic_cnt_present_flag
+    file->write(nalUnit(0x68, pps.finish()));
+    // Mid grey, no zero bytes that would need escaping.
+    const QByteArray macroblock = QByteArray(16 * 16, '\x80') + QByteArray(8 * 8 * 2, '\x80');
+    for (int i = 0; i != kWarmUpFrames * 2; ++i) {
+        BitWriter slice;
+        slice.ue(0);       // first_mb_in_slice
+        slice.ue(7);       // slice_type: I, all slices
+        slice.ue(0);       // pic_parameter_set_id
+        slice.bits(0, 4);  // frame_num
+        slice.ue(i % 2);   // idr_pic_id, differs between consecutive IDRs
+        slice.bits(0, 1);  // no_output_of_prior_pics_flag
+        slice.bits(0, 1);  // long_term_reference_flag
+        slice.ue(0);       // slice_qp_delta
+        for (int mb = 0; mb != (kSampleWidthInMbs * kSampleHeightInMbs); ++mb) {
+            slice.ue(25);  // mb_type: I_PCM
+            slice.align(); // pcm_alignment_zero_bit
+            slice.bytes(macroblock);
+        }
+        file->write(nalUnit(0x65, slice.finish()));
+    }
+    if (file->error() != QFile::NoError) {
+        return nullptr;
+    }
+    // MDK opens it on its own.
+    file->close();
+    return file.take();
+}
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qscopedpointer.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qstringlist.h>
+
+namespace mdk
+{
+
+class Player;
+
+}
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QOpenGLContext)
+QT_FORWARD_DECLARE_CLASS(QOffscreenSurface)
+QT_FORWARD_DECLARE_CLASS(QOpenGLFramebufferObject)
+QT_FORWARD_DECLARE_CLASS(QTemporaryFile)
+QT_END_NAMESPACE
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Pays the one-time costs of the first media of a session up front: loading
+// the FFmpeg and decoder libraries, creating the hardware device contexts of
+// the decoder chain and, when Qt Quick renders with OpenGL, compiling MDK's
+// conversion shaders (which fills the driver's shader disk cache). A few
+// frames of a sample media are decoded and rendered into an offscreen
+// framebuffer, nothing is shown or played back.
+// Hardware decoders only come up for codecs they support, so pass a short
+// clip in the codec the application actually plays. Without one a tiny
+// H.264 clip is generated. The sample is opened twice, the second time
+// shows what the warm-up saved.
+class MDKPLAYER_API PlayerWarmUp : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(PlayerWarmUp)
+
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(bool done READ done NOTIFY finished)
+    Q_PROPERTY(qint64 coldOpenLatency READ coldOpenLatency NOTIFY finished)
+    Q_PROPERTY(qint64 warmOpenLatency READ warmOpenLatency NOTIFY finished)
+    Q_PROPERTY(qint64 duration READ duration NOTIFY finished)
+
+public:
+    explicit PlayerWarmUp(QObject *parent = nullptr);
+    ~PlayerWarmUp() override;
+
+    static PlayerWarmUp *instance();
+
+    bool running() const;
+    bool done() const;
+
+    // Milliseconds from opening the sample to its first frame, i.e. what the
+    // first MDKPlayer would have paid. Compare with MDKPlayer.firstFrameLatency.
+    qint64 coldOpenLatency() const;
+    // The same once the warm-up is done, the sample is opened again by a new
+    // player. The difference is what the warm-up saves every later player.
+    qint64 warmOpenLatency() const;
+    // Milliseconds the whole warm-up took.
+    qint64 duration() const;
+
+public Q_SLOTS:
+    // Must be called from the gui thread. Does nothing if a warm-up is
+    // running or has been done already.
+    void start(const QUrl &sample = {}, const QStringList &decoders = {});
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    bool createOffscreenRenderer();
+    void startPass();
+    void stopPass();
+    void renderFrame();
+    void finish();
+    static QTemporaryFile *generateSample();
+
+Q_SIGNALS:
+    void runningChanged();
+    void finished();
+
+private:
+    QSharedPointer<mdk::Player> m_player;
+    QScopedPointer<QOffscreenSurface> m_surface;
+    QScopedPointer<QOpenGLContext> m_context;
+    QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    QScopedPointer<QTemporaryFile> m_generatedSample;
+    QString m_source = {};
+    QStringList m_decoders = {};
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_passTimer;
+    qint64 m_coldOpenLatency = -1;
+    qint64 m_warmOpenLatency = -1;
+    bool m_warm = false;
+    qint64 m_duration = 0;
+    int m_timerId = 0;
+    bool m_done = false;
+    // Written by MDK's threads.
+    QAtomicInt m_frames = 0;
+    QAtomicInteger<qint64> m_firstFrame = -1;
+};
+
+MDKPLAYER_END_NAMESPACE
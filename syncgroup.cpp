@@ -0,0 +1,347 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "syncgroup.h"
+#include "mdkplayer.h"
+#include <QtCore/qdebug.h>
+#include <limits>
+
+// How often the members are compared with the clock, in milliseconds.
+static constexpr const int kSyncInterval = 50;
+// Closer than this is in sync, a frame at 60 fps is about 17 ms.
+static constexpr const qint64 kSkewTolerance = 10;
+// A skew is corrected within roughly this time, in milliseconds.
+static constexpr const qreal kCorrectionTime = 2000.0;
+// The largest rate adjustment, hardly audible with pitch correction.
+static constexpr const qreal kMaxRateTrim = 0.05;
+// Rate adjustments are rounded to this, so the rate doesn't change on every check.
+static constexpr const qreal kRateTrimStep = 0.005;
+// Further off than this is faster to fix with a seek.
+static constexpr const qint64 kResyncThreshold = 500;
+// Don't wait forever for a member that never becomes ready.
+static constexpr const qint64 kMaxHoldTime = 3000;
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+SyncGroup::SyncGroup(QObject *parent) : QObject(parent)
+{
+}
+
+SyncGroup::~SyncGroup()
+{
+    for (auto &&player : qAsConst(m_players)) {
+        if (!player) {
+            continue;
+        }
+        player->m_syncGroup = nullptr;
+        player->setRateTrim(1.0);
+        Q_EMIT player->syncGroupChanged();
+    }
+}
+
+QList<MDKPlayer *> SyncGroup::players() const
+{
+    QList<MDKPlayer *> result = {};
+    for (auto &&player : qAsConst(m_players)) {
+        if (player) {
+            result.append(player);
+        }
+    }
+    return result;
+}
+
+int SyncGroup::playerCount() const
+{
+    return m_players.size();
+}
+
+bool SyncGroup::isPlaying() const
+{
+    return m_playing;
+}
+
+qreal SyncGroup::playbackRate() const
+{
+    return m_playbackRate;
+}
+
+void SyncGroup::setPlaybackRate(const qreal value)
+{
+    if (qFuzzyCompare(m_playbackRate, value)) {
+        return;
+    }
+    // Re-anchor, the time so far was at the old rate.
+    m_anchor = position();
+    if (m_clock.isValid()) {
+        m_clock.start();
+    }
+    m_playbackRate = value;
+    for (auto &&player : qAsConst(m_players)) {
+        if (player) {
+            player->setPlaybackRate(m_playbackRate);
+        }
+    }
+    Q_EMIT playbackRateChanged();
+    qDebug() << "Sync group: playback rate -->" << m_playbackRate;
+}
+
+qint64 SyncGroup::position() const
+{
+    if (!m_clock.isValid()) {
+        return m_anchor;
+    }
+    return qMax(qint64(0), m_anchor + qRound64(m_clock.elapsed() * m_playbackRate));
+}
+
+qint64 SyncGroup::skew() const
+{
+    return m_skew;
+}
+
+qint64 SyncGroup::peakSkew() const
+{
+    return m_peakSkew;
+}
+
+qint64 SyncGroup::resyncCount() const
+{
+    return m_resyncCount;
+}
+
+void SyncGroup::join(MDKPlayer *player)
+{
+    if (player) {
+        player->setSyncGroup(this);
+    }
+}
+
+void SyncGroup::leave(MDKPlayer *player)
+{
+    if (player && (player->syncGroup() == this)) {
+        player->setSyncGroup(nullptr);
+    }
+}
+
+void SyncGroup::play()
+{
+    if (m_playing) {
+        return;
+    }
+    m_playing = true;
+    // Started by the next check, once every member has its frame.
+    hold();
+    Q_EMIT playingChanged();
+    qDebug() << "Sync group: play @" << m_anchor;
+}
+
+void SyncGroup::pause()
+{
+    if (!m_playing) {
+        return;
+    }
+    m_anchor = position();
+    m_clock.invalidate();
+    m_holdTimer.invalidate();
+    m_playing = false;
+    for (auto &&player : qAsConst(m_players)) {
+        if (!player) {
+            continue;
+        }
+        player->pause();
+        player->setRateTrim(1.0);
+        // Show the very same moment everywhere.
+        player->seek(m_anchor, false);
+    }
+    Q_EMIT playingChanged();
+    Q_EMIT positionChanged();
+    qDebug() << "Sync group: pause @" << m_anchor;
+}
+
+void SyncGroup::seek(const qint64 value)
+{
+    m_anchor = qMax(qint64(0), value);
+    m_clock.invalidate();
+    m_holdTimer.start();
+    for (auto &&player : qAsConst(m_players)) {
+        if (!player) {
+            continue;
+        }
+        player->pause();
+        player->setRateTrim(1.0);
+        player->seek(m_anchor, false);
+    }
+    m_peakSkew = 0;
+    Q_EMIT positionChanged();
+    Q_EMIT statisticsChanged();
+    qDebug() << "Sync group: seek -->" << m_anchor;
+}
+
+void SyncGroup::resetStatistics()
+{
+    m_skew = 0;
+    m_peakSkew = 0;
+    m_resyncCount = 0;
+    Q_EMIT statisticsChanged();
+}
+
+void SyncGroup::timerEvent(QTimerEvent *event)
+{
+    QObject::timerEvent(event);
+    m_players.removeAll(nullptr);
+    if (m_playing) {
+        if (m_clock.isValid()) {
+            correct();
+        } else if (isReady() || (m_holdTimer.isValid() && m_holdTimer.hasExpired(kMaxHoldTime))) {
+            start();
+        }
+    }
+    Q_EMIT positionChanged();
+}
+
+void SyncGroup::attach(MDKPlayer *player)
+{
+    if (!player || m_players.contains(player)) {
+        return;
+    }
+    if (m_players.isEmpty()) {
+        // The first member sets the pace.
+        m_playing = player->isPlaying();
+        m_playbackRate = player->isStopped() ? 1.0 : player->playbackRate();
+        m_anchor = player->position();
+        m_clock.invalidate();
+        Q_EMIT playingChanged();
+        Q_EMIT playbackRateChanged();
+    }
+    m_players.append(player);
+    if (m_timer == 0) {
+        m_timer = startTimer(kSyncInterval);
+    }
+    // Everyone waits for the newcomer to get to the clock.
+    hold();
+    player->setPlaybackRate(m_playbackRate);
+    player->seek(m_anchor, false);
+    Q_EMIT playersChanged();
+    qDebug() << "Sync group:" << m_players.size() << "players.";
+}
+
+void SyncGroup::detach(MDKPlayer *player)
+{
+    if (!m_players.removeAll(player)) {
+        return;
+    }
+    player->setRateTrim(1.0);
+    if (m_players.isEmpty()) {
+        m_anchor = position();
+        m_clock.invalidate();
+        if (m_timer != 0) {
+            killTimer(m_timer);
+            m_timer = 0;
+        }
+    }
+    Q_EMIT playersChanged();
+}
+
+// Stops the clock and the members until all of them are ready again.
+void SyncGroup::hold()
+{
+    m_anchor = position();
+    m_clock.invalidate();
+    m_holdTimer.start();
+    for (auto &&player : qAsConst(m_players)) {
+        if (player) {
+            player->pause();
+        }
+    }
+}
+
+bool SyncGroup::isReady() const
+{
+    for (auto &&player : qAsConst(m_players)) {
+        // Members without media don't hold anybody up.
+        if (!player || player->isStopped()) {
+            continue;
+        }
+        // Seeks are over with their first frame.
+        if (player->m_seekTimer.isValid() || player->m_stallTimer.isValid()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SyncGroup::start()
+{
+    m_holdTimer.invalidate();
+    m_clock.start();
+    for (auto &&player : qAsConst(m_players)) {
+        if (!player) {
+            continue;
+        }
+        player->setRateTrim(1.0);
+        player->play();
+    }
+}
+
+void SyncGroup::correct()
+{
+    const qint64 clock = position();
+    // A faster rate catches up when playing backwards, too.
+    const qreal direction = (m_playbackRate < 0.0) ? -1.0 : 1.0;
+    qint64 ahead = std::numeric_limits<qint64>::min();
+    qint64 behind = std::numeric_limits<qint64>::max();
+    for (auto &&player : qAsConst(m_players)) {
+        if (!player || player->isStopped()) {
+            continue;
+        }
+        if (player->m_stallTimer.isValid()) {
+            // Wait for it instead of leaving it behind.
+            hold();
+            return;
+        }
+        if (player->m_seekTimer.isValid()) {
+            // Still on its way back.
+            continue;
+        }
+        const qint64 skew = player->position() - clock;
+        ahead = qMax(ahead, skew);
+        behind = qMin(behind, skew);
+        if (qAbs(skew) > kResyncThreshold) {
+            // Aim where the clock will be once the seek is done.
+            player->setRateTrim(1.0);
+            player->seek(clock + qRound64(player->m_seekLatency * m_playbackRate), false);
+            ++m_resyncCount;
+            qDebug() << "Sync group: resync, skew" << skew << "ms.";
+        } else if (qAbs(skew) > kSkewTolerance) {
+            const qreal trim = qBound(-kMaxRateTrim, direction * qreal(skew) / kCorrectionTime, kMaxRateTrim);
+            player->setRateTrim(1.0 - qRound(trim / kRateTrimStep) * kRateTrimStep);
+        } else {
+            player->setRateTrim(1.0);
+        }
+    }
+    m_skew = (ahead >= behind) ? (ahead - behind) : 0;
+    m_peakSkew = qMax(m_peakSkew, m_skew);
+    Q_EMIT statisticsChanged();
+}
+
+MDKPLAYER_END_NAMESPACE
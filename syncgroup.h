@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qobject.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qelapsedtimer.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+class MDKPlayer;
+
+// Plays its members in lockstep, e.g. the angles of a multi-camera
+// recording. The group has its own clock: play, pause, seek and rate
+// changes go to all members at once, and the clock only starts once every
+// member has its frame ready, so they start together. While playing, each
+// member's playback rate is nudged by a few percent to follow the clock,
+// members that are too far off are seeked back into place. Members join
+// with MDKPlayer::syncGroup and should be controlled through the group.
+class MDKPLAYER_API SyncGroup : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(SyncGroup)
+
+    Q_PROPERTY(int playerCount READ playerCount NOTIFY playersChanged)
+    Q_PROPERTY(bool playing READ isPlaying NOTIFY playingChanged)
+    Q_PROPERTY(qreal playbackRate READ playbackRate WRITE setPlaybackRate NOTIFY playbackRateChanged)
+    Q_PROPERTY(qint64 position READ position WRITE seek NOTIFY positionChanged)
+    Q_PROPERTY(qint64 skew READ skew NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 peakSkew READ peakSkew NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 resyncCount READ resyncCount NOTIFY statisticsChanged)
+
+    friend class MDKPlayer;
+
+public:
+    explicit SyncGroup(QObject *parent = nullptr);
+    ~SyncGroup() override;
+
+    QList<MDKPlayer *> players() const;
+    int playerCount() const;
+
+    bool isPlaying() const;
+
+    qreal playbackRate() const;
+    void setPlaybackRate(const qreal value);
+
+    // The position of the group clock.
+    qint64 position() const;
+
+    // Milliseconds between the members furthest ahead and behind, and the
+    // largest value since the last seek.
+    qint64 skew() const;
+    qint64 peakSkew() const;
+    // How often a member had to be seeked back to the clock.
+    qint64 resyncCount() const;
+
+    Q_INVOKABLE void join(MDKPlayer *player);
+    Q_INVOKABLE void leave(MDKPlayer *player);
+
+public Q_SLOTS:
+    void play();
+    void pause();
+    void seek(const qint64 value);
+    void resetStatistics();
+
+Q_SIGNALS:
+    void playersChanged();
+    void playingChanged();
+    void playbackRateChanged();
+    void positionChanged();
+    void statisticsChanged();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void attach(MDKPlayer *player);
+    void detach(MDKPlayer *player);
+    void hold();
+    bool isReady() const;
+    void start();
+    void correct();
+
+private:
+    QList<QPointer<MDKPlayer>> m_players = {};
+    bool m_playing = false;
+    qreal m_playbackRate = 1.0;
+    // The clock is m_anchor plus the time since m_clock was started, it
+    // stands still while m_clock is invalid.
+    qint64 m_anchor = 0;
+    QElapsedTimer m_clock;
+    QElapsedTimer m_holdTimer;
+    qint64 m_skew = 0;
+    qint64 m_peakSkew = 0;
+    qint64 m_resyncCount = 0;
+    int m_timer = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
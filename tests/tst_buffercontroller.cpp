@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtTest/qtest.h>
+#include "buffercontroller.h"
+
+MDKPLAYER_USE_NAMESPACE
+
+class tst_BufferController : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void stallDoublesTarget();
+    void fullBufferStallIsDecodeStall();
+    void slowDownloadGrowsTarget();
+    void stableDownloadShrinksTarget();
+    void maxBytesLowersLimit();
+};
+
+void tst_BufferController::stallDoublesTarget()
+{
+    BufferController controller = {};
+    controller.reset();
+    QCOMPARE(controller.target(), qint64(500));
+    QCOMPARE(controller.limit(), qint64(10000));
+    QVERIFY(controller.stalled(0));
+    QCOMPARE(controller.target(), qint64(1000));
+    QVERIFY(controller.stalled(0));
+    QVERIFY(controller.stalled(0));
+    QVERIFY(controller.stalled(0));
+    QCOMPARE(controller.target(), qint64(8000));
+    // Capped at the limit.
+    QVERIFY(controller.stalled(0));
+    QCOMPARE(controller.target(), qint64(10000));
+    QVERIFY(!controller.stalled(0));
+    QCOMPARE(controller.decodeStalls(), 0);
+}
+
+void tst_BufferController::fullBufferStallIsDecodeStall()
+{
+    BufferController controller = {};
+    controller.reset();
+    QVERIFY(!controller.stalled(9500));
+    QCOMPARE(controller.target(), qint64(500));
+    QCOMPARE(controller.decodeStalls(), 1);
+}
+
+void tst_BufferController::slowDownloadGrowsTarget()
+{
+    BufferController controller = {};
+    controller.reset();
+    // 100 bytes per millisecond, nothing played yet.
+    QVERIFY(!controller.update({1000, 10000, 1000000, 0}));
+    // The buffer drains as fast as it's played: nothing is downloaded.
+    QVERIFY(controller.update({1000, 9000, 900000, 1000}));
+    QVERIFY(controller.throughputRatio() < 1.0);
+    QCOMPARE(controller.target(), qint64(625));
+    QCOMPARE(controller.decodeStalls(), 0);
+}
+
+void tst_BufferController::stableDownloadShrinksTarget()
+{
+    BufferController controller = {};
+    controller.reset();
+    controller.stalled(0);
+    controller.stalled(0);
+    controller.stalled(0);
+    QCOMPARE(controller.target(), qint64(4000));
+    qint64 bytes = 400000;
+    qint64 duration = 4000;
+    QVERIFY(!controller.update({1000, duration, bytes, 0}));
+    // Twice as much is downloaded as played.
+    for (int i = 1; i < 30; ++i) {
+        bytes += 100000;
+        duration += 1000;
+        QVERIFY(!controller.update({1000, duration, bytes, 1000}));
+        QCOMPARE(controller.target(), qint64(4000));
+    }
+    QVERIFY(controller.throughputRatio() >= 1.5);
+    bytes += 100000;
+    duration += 1000;
+    QVERIFY(controller.update({1000, duration, bytes, 1000}));
+    QCOMPARE(controller.target(), qint64(3600));
+}
+
+void tst_BufferController::maxBytesLowersLimit()
+{
+    BufferController controller = {};
+    BufferController::Settings settings = {};
+    settings.maxBytes = 500000;
+    controller.setSettings(settings);
+    controller.reset();
+    QCOMPARE(controller.limit(), qint64(10000));
+    // 100 bytes per millisecond, 500000 bytes hold 5 seconds.
+    QVERIFY(controller.update({1000, 2000, 200000, 0}));
+    QCOMPARE(controller.limit(), qint64(5000));
+    for (int i = 0; i != 10; ++i) {
+        controller.stalled(0);
+    }
+    QCOMPARE(controller.target(), qint64(5000));
+}
+
+QTEST_APPLESS_MAIN(tst_BufferController)
+
+#include "tst_buffercontroller.moc"
@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtTest/qtest.h>
+#include "decoderpolicy.h"
+
+MDKPLAYER_USE_NAMESPACE
+
+static inline MDKPlayer::VideoStreamInfo makeStream(const QString &codec, const int width, const int bitDepth)
+{
+    MDKPlayer::VideoStreamInfo stream = {};
+    stream.codec = codec;
+    stream.width = width;
+    stream.height = (width * 9 / 16);
+    stream.frameRate = 30.0;
+    stream.bitDepth = bitDepth;
+    return stream;
+}
+
+class tst_DecoderPolicy : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void decoderName();
+    void emptyPolicy();
+    void firstMatchingRuleWins();
+};
+
+void tst_DecoderPolicy::decoderName()
+{
+    QCOMPARE(DecoderPolicy::decoderName(QStringLiteral("FFmpeg"), {}), QStringLiteral("FFmpeg"));
+    const QVariantMap options = {
+        {QStringLiteral("threads"), 4},
+        {QStringLiteral("thread_type"), QStringLiteral("slice")}
+    };
+    QCOMPARE(DecoderPolicy::decoderName(QStringLiteral("FFmpeg"), options),
+             QStringLiteral("FFmpeg:thread_type=slice:threads=4"));
+}
+
+void tst_DecoderPolicy::emptyPolicy()
+{
+    QVERIFY(DecoderPolicy::fromVariant({}).isEmpty());
+    // A rule without decoders is ignored.
+    const QVariantList value = {
+        QVariantMap{{QStringLiteral("codec"), QStringLiteral("h264")}}
+    };
+    const DecoderPolicy policy = DecoderPolicy::fromVariant(value);
+    QVERIFY(policy.isEmpty());
+    QCOMPARE(policy.match(makeStream(QStringLiteral("h264"), 1920, 8)), -1);
+}
+
+void tst_DecoderPolicy::firstMatchingRuleWins()
+{
+    const QVariantList value = {
+        QVariantMap{
+            {QStringLiteral("codec"), QStringLiteral("hevc")},
+            {QStringLiteral("minBitDepth"), 10},
+            {QStringLiteral("decoders"), QVariantList{QStringLiteral("CUDA"), QStringLiteral("FFmpeg")}}
+        },
+        QVariantMap{
+            {QStringLiteral("codec"), QStringList{QStringLiteral("h264"), QStringLiteral("mpeg2video")}},
+            {QStringLiteral("maxWidth"), 1920},
+            {QStringLiteral("decoders"), QVariantList{
+                QVariantMap{
+                    {QStringLiteral("name"), QStringLiteral("FFmpeg")},
+                    {QStringLiteral("options"), QVariantMap{{QStringLiteral("threads"), 4}}}
+                }
+            }}
+        },
+        QVariantMap{
+            {QStringLiteral("decoders"), QVariantList{QStringLiteral("FFmpeg")}}
+        }
+    };
+    const DecoderPolicy policy = DecoderPolicy::fromVariant(value);
+    QVERIFY(!policy.isEmpty());
+    QCOMPARE(policy.match(makeStream(QStringLiteral("hevc"), 3840, 10)), 0);
+    QCOMPARE(policy.decoders(0), QStringList({QStringLiteral("CUDA"), QStringLiteral("FFmpeg")}));
+    // Codecs are compared case insensitively.
+    QCOMPARE(policy.match(makeStream(QStringLiteral("H264"), 1920, 8)), 1);
+    QCOMPARE(policy.decoders(1), QStringList{QStringLiteral("FFmpeg:threads=4")});
+    // Too wide for the second rule, 8-bit hevc is too shallow for the first.
+    QCOMPARE(policy.match(makeStream(QStringLiteral("h264"), 3840, 8)), 2);
+    QCOMPARE(policy.match(makeStream(QStringLiteral("hevc"), 3840, 8)), 2);
+    QCOMPARE(policy.decoders(3), QStringList());
+    QCOMPARE(policy.decoders(-1), QStringList());
+}
+
+QTEST_APPLESS_MAIN(tst_DecoderPolicy)
+
+#include "tst_decoderpolicy.moc"
@@ -0,0 +1,166 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtTest/qtest.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qscopedpointer.h>
+#include "historystore.h"
+
+MDKPLAYER_USE_NAMESPACE
+
+static inline bool writeFile(const QString &filePath, const QByteArray &data)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+    return (file.write(data) == data.size());
+}
+
+static inline QByteArray readFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        return {};
+    }
+    return file.readAll();
+}
+
+class tst_HistoryStore : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void roundTrip();
+    void removeSurvivesReload();
+    void tornRecordIsDropped();
+    void malformedRecordsAreSkipped();
+    void writesAfterShutdown();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+    QString m_filePath = {};
+};
+
+void tst_HistoryStore::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+    m_filePath = m_dir->filePath(QStringLiteral("history.log"));
+}
+
+void tst_HistoryStore::roundTrip()
+{
+    const QUrl a(QStringLiteral("file:///a.mkv"));
+    const QUrl b(QStringLiteral("https://example.com/b video.mp4"));
+    {
+        HistoryStore store(m_filePath);
+        QCOMPARE(store.count(), 0);
+        QCOMPARE(store.position(a), qint64(-1));
+        store.setPosition(a, 1000);
+        store.setPosition(b, 2000);
+        store.setPosition(a, 3000);
+        // Served from memory before anything is written.
+        QCOMPARE(store.position(a), qint64(3000));
+        store.flush();
+    }
+    HistoryStore store(m_filePath);
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(store.position(a), qint64(3000));
+    QCOMPARE(store.position(b), qint64(2000));
+}
+
+void tst_HistoryStore::removeSurvivesReload()
+{
+    const QUrl a(QStringLiteral("file:///a.mkv"));
+    const QUrl b(QStringLiteral("file:///b.mkv"));
+    {
+        HistoryStore store(m_filePath);
+        store.setPosition(a, 1000);
+        store.setPosition(b, 2000);
+        store.remove(a);
+        QCOMPARE(store.position(a), qint64(-1));
+        // The destructor writes what's left.
+    }
+    HistoryStore store(m_filePath);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.position(a), qint64(-1));
+    QCOMPARE(store.position(b), qint64(2000));
+}
+
+void tst_HistoryStore::tornRecordIsDropped()
+{
+    const QByteArray complete = "1000\tfile:///a.mkv\n2000\tfile:///b.mkv\n";
+    // A crash in the middle of appending a record.
+    QVERIFY(writeFile(m_filePath, complete + "30"));
+    const QUrl c(QStringLiteral("file:///c.mkv"));
+    {
+        HistoryStore store(m_filePath);
+        QCOMPARE(store.count(), 2);
+        QCOMPARE(store.position(QUrl(QStringLiteral("file:///a.mkv"))), qint64(1000));
+        QCOMPARE(store.position(QUrl(QStringLiteral("file:///b.mkv"))), qint64(2000));
+        // The torn record is cut off so the next one starts on its own line.
+        QCOMPARE(readFile(m_filePath), complete);
+        store.setPosition(c, 4000);
+        store.flush();
+    }
+    QCOMPARE(readFile(m_filePath), complete + "4000\tfile:///c.mkv\n");
+    HistoryStore store(m_filePath);
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.position(c), qint64(4000));
+}
+
+void tst_HistoryStore::malformedRecordsAreSkipped()
+{
+    QVERIFY(writeFile(m_filePath, "garbage\n\tfile:///x.mkv\n1000\t\n1000\tfile:///a.mkv\n-1\tfile:///a.mkv\n2000\tfile:///b.mkv\n"));
+    HistoryStore store(m_filePath);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.position(QUrl(QStringLiteral("file:///a.mkv"))), qint64(-1));
+    QCOMPARE(store.position(QUrl(QStringLiteral("file:///b.mkv"))), qint64(2000));
+}
+
+void tst_HistoryStore::writesAfterShutdown()
+{
+    const QUrl a(QStringLiteral("file:///a.mkv"));
+    const QUrl b(QStringLiteral("file:///b.mkv"));
+    {
+        HistoryStore store(m_filePath);
+        store.setPosition(a, 1000);
+        store.shutdown();
+        // Written by this thread now.
+        store.setPosition(b, 2000);
+        QCOMPARE(readFile(m_filePath), QByteArray("1000\tfile:///a.mkv\n2000\tfile:///b.mkv\n"));
+        store.remove(a);
+    }
+    HistoryStore store(m_filePath);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.position(b), qint64(2000));
+}
+
+QTEST_GUILESS_MAIN(tst_HistoryStore)
+
+#include "tst_historystore.moc"
@@ -0,0 +1,120 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtTest/qtest.h>
+#include "variantselector.h"
+
+MDKPLAYER_USE_NAMESPACE
+
+static inline VariantSelector::Variants testVariants()
+{
+    return {
+        {2, 1920, 1080, 5000000},
+        {0, 640, 360, 800000},
+        {1, 1280, 720, 2500000}
+    };
+}
+
+class tst_VariantSelector : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initialSelection();
+    void viewCapsVariant();
+    void lowThroughputSwitchesDown();
+    void upSwitchWaitsForInterval();
+};
+
+void tst_VariantSelector::initialSelection()
+{
+    VariantSelector selector = {};
+    selector.setVariants({{0, 640, 360, 800000}}, 0);
+    QVERIFY(!selector.isAdaptive());
+    QCOMPARE(selector.select({}, false), 0);
+
+    selector.setVariants(testVariants(), -1);
+    QVERIFY(selector.isAdaptive());
+    // 3 Mbps initially, times the safety factor.
+    QCOMPARE(selector.select({}, false), 0);
+
+    VariantSelector::Settings settings = {};
+    settings.initialThroughput = 10000000;
+    selector.setSettings(settings);
+    QCOMPARE(selector.select({}, false), 2);
+}
+
+void tst_VariantSelector::viewCapsVariant()
+{
+    VariantSelector selector = {};
+    VariantSelector::Settings settings = {};
+    settings.initialThroughput = 10000000;
+    selector.setSettings(settings);
+    selector.setVariants(testVariants(), -1);
+    QCOMPARE(selector.select(QSize(640, 360), false), 0);
+    QCOMPARE(selector.select(QSize(600, 340), false), 0);
+    QCOMPARE(selector.select(QSize(1280, 720), false), 1);
+    // Fitting only needs one side to fill the view, cropping needs both.
+    QCOMPARE(selector.select(QSize(1280, 1000), false), 1);
+    QCOMPARE(selector.select(QSize(1280, 1000), true), 2);
+}
+
+void tst_VariantSelector::lowThroughputSwitchesDown()
+{
+    VariantSelector selector = {};
+    selector.setVariants(testVariants(), 2);
+    QCOMPARE(selector.currentBitRate(), qint64(5000000));
+    selector.update({1000, 2000, 1000000, 10000, 0});
+    // 125000 bytes arrived in a second while 625000 were played.
+    selector.update({1000, 1000, 500000, 10000, 1000});
+    QCOMPARE(selector.throughput(), qint64(1000000));
+    QCOMPARE(selector.select({}, false), 0);
+    selector.switched(0);
+    QCOMPARE(selector.currentTrack(), 0);
+    QCOMPARE(selector.switchCount(), 1);
+}
+
+void tst_VariantSelector::upSwitchWaitsForInterval()
+{
+    VariantSelector selector = {};
+    selector.setVariants(testVariants(), 2);
+    selector.update({1000, 2000, 1000000, 10000, 0});
+    selector.update({1000, 1000, 500000, 10000, 1000});
+    selector.switched(0);
+    qint64 bytes = 1000000;
+    selector.update({1000, 5000, bytes, 10000, 0});
+    // 20 Mbps from now on, the buffer is healthy.
+    for (int i = 1; i < 5; ++i) {
+        bytes += 2400000;
+        selector.update({1000, 5000, bytes, 10000, 1000});
+        QCOMPARE(selector.select({}, false), 0);
+    }
+    bytes += 2400000;
+    selector.update({1000, 5000, bytes, 10000, 1000});
+    QCOMPARE(selector.select({}, false), 2);
+}
+
+QTEST_APPLESS_MAIN(tst_VariantSelector)
+
+#include "tst_variantselector.moc"
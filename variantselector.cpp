@@ -0,0 +1,206 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "variantselector.h"
+#include <algorithm>
+
+// Weight of a new sample in the throughput average.
+static constexpr const qreal kSampleWeight = 0.3;
+// The buffer counts as full, and the download as throttled, above this
+// share of the limit.
+static constexpr const qreal kFullBuffer = 0.9;
+// A variant this much smaller than the view still fills it, scaling up by
+// 10% isn't visible.
+static constexpr const qreal kViewTolerance = 0.9;
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+VariantSelector::Settings VariantSelector::settings() const
+{
+    return m_settings;
+}
+
+void VariantSelector::setSettings(const Settings &value)
+{
+    m_settings = value;
+    m_settings.safetyFactor = qBound(0.1, m_settings.safetyFactor, 1.0);
+    m_settings.lowBuffer = qBound(0.0, m_settings.lowBuffer, 1.0);
+    m_settings.highBuffer = qBound(m_settings.lowBuffer, m_settings.highBuffer, 1.0);
+    m_settings.minUpSwitchInterval = qMax(qint64(0), m_settings.minUpSwitchInterval);
+    m_settings.initialThroughput = qMax(qint64(0), m_settings.initialThroughput);
+}
+
+void VariantSelector::setVariants(const Variants &value, const int currentTrack)
+{
+    m_variants = value;
+    std::stable_sort(m_variants.begin(), m_variants.end(), [](const Variant &lhs, const Variant &rhs) {
+        return (lhs.bitRate < rhs.bitRate);
+    });
+    m_currentTrack = currentTrack;
+    // The throughput is kept, the next media most likely comes over the
+    // same network.
+    m_lastBufferedBytes = -1;
+    m_bufferedDuration = 0;
+    m_bufferLimit = 0;
+    m_sinceSwitch = m_settings.minUpSwitchInterval;
+    m_switchCount = 0;
+}
+
+VariantSelector::Variants VariantSelector::variants() const
+{
+    return m_variants;
+}
+
+bool VariantSelector::isAdaptive() const
+{
+    return (m_variants.size() > 1);
+}
+
+void VariantSelector::update(const Sample &sample)
+{
+    if (sample.elapsed <= 0) {
+        return;
+    }
+    m_sinceSwitch += sample.elapsed;
+    m_bufferedDuration = sample.bufferedDuration;
+    m_bufferLimit = sample.bufferLimit;
+    if (m_lastBufferedBytes < 0) {
+        m_lastBufferedBytes = sample.bufferedBytes;
+        return;
+    }
+    // Downloaded = buffer growth + what was played from the buffer.
+    const qreal bytes = qMax(0.0, (sample.bufferedBytes - m_lastBufferedBytes)
+                                      + (sample.played * currentBitRate() / 8000.0));
+    m_lastBufferedBytes = sample.bufferedBytes;
+    const qreal measured = bytes * 8.0 * 1000.0 / sample.elapsed;
+    const bool throttled = (sample.bufferedDuration >= qRound64(sample.bufferLimit * kFullBuffer));
+    if (throttled && (measured < m_throughput)) {
+        // Only a lower bound.
+        return;
+    }
+    m_throughput = (m_throughput <= 0.0) ? measured : ((m_throughput * (1.0 - kSampleWeight)) + (measured * kSampleWeight));
+}
+
+int VariantSelector::select(const QSize &viewSize, const bool cover) const
+{
+    if (!isAdaptive()) {
+        return m_currentTrack;
+    }
+    const int current = qMax(0, currentIndex());
+    const int cap = capIndex(viewSize, cover);
+    const qreal budget = ((m_throughput > 0.0) ? m_throughput : m_settings.initialThroughput) * m_settings.safetyFactor;
+    int best = 0;
+    for (int i = 1; i <= cap; ++i) {
+        if (m_variants.at(i).bitRate <= budget) {
+            best = i;
+        }
+    }
+    if ((m_bufferLimit <= 0) || (currentIndex() < 0)) {
+        // Nothing measured yet, the first choice.
+        return m_variants.at(best).track;
+    }
+    if (current > cap) {
+        // The view has shrunk, the pixels would be wasted.
+        return m_variants.at(best).track;
+    }
+    if (best < current) {
+        return (m_bufferedDuration < qRound64(m_bufferLimit * m_settings.highBuffer)) ? m_variants.at(best).track
+                                                                                     : m_currentTrack;
+    }
+    const bool canSwitchUp = (m_bufferedDuration >= qRound64(m_bufferLimit * m_settings.lowBuffer))
+                             && (m_sinceSwitch >= m_settings.minUpSwitchInterval);
+    if (best > current) {
+        return canSwitchUp ? m_variants.at(best).track : m_currentTrack;
+    }
+    const bool throttled = (m_bufferedDuration >= qRound64(m_bufferLimit * kFullBuffer));
+    if (throttled && canSwitchUp && (current < cap)) {
+        return m_variants.at(current + 1).track;
+    }
+    return m_currentTrack;
+}
+
+void VariantSelector::switched(const int track)
+{
+    if (m_currentTrack == track) {
+        return;
+    }
+    m_currentTrack = track;
+    ++m_switchCount;
+    m_sinceSwitch = 0;
+    m_lastBufferedBytes = -1;
+}
+
+int VariantSelector::currentTrack() const
+{
+    return m_currentTrack;
+}
+
+qint64 VariantSelector::currentBitRate() const
+{
+    const int index = currentIndex();
+    return (index < 0) ? 0 : m_variants.at(index).bitRate;
+}
+
+qint64 VariantSelector::throughput() const
+{
+    return qRound64(m_throughput);
+}
+
+int VariantSelector::switchCount() const
+{
+    return m_switchCount;
+}
+
+int VariantSelector::currentIndex() const
+{
+    for (int i = 0; i < m_variants.size(); ++i) {
+        if (m_variants.at(i).track == m_currentTrack) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int VariantSelector::capIndex(const QSize &viewSize, const bool cover) const
+{
+    if (viewSize.isEmpty()) {
+        return (m_variants.size() - 1);
+    }
+    const qreal width = viewSize.width() * kViewTolerance;
+    const qreal height = viewSize.height() * kViewTolerance;
+    for (int i = 0; i < m_variants.size(); ++i) {
+        const Variant &variant = m_variants.at(i);
+        if ((variant.width <= 0) || (variant.height <= 0)) {
+            continue;
+        }
+        const bool wide = (variant.width >= width);
+        const bool tall = (variant.height >= height);
+        if (cover ? (wide && tall) : (wide || tall)) {
+            return i;
+        }
+    }
+    return (m_variants.size() - 1);
+}
+
+MDKPLAYER_END_NAMESPACE
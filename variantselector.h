@@ -0,0 +1,125 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qlist.h>
+#include <QtCore/qsize.h>
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// Picks the variant of an adaptive stream (HLS/DASH) to play:
+// - Never more pixels than the item shows: the smallest variant that fills
+//   the view is the largest one considered.
+// - Below that, the highest bit rate the measured throughput can carry with
+//   some margin.
+// - A full buffer rides out a drop in throughput, a low buffer switches
+//   down at once. Switching up waits for a healthy buffer and for some time
+//   since the last switch, so the variant doesn't flap.
+// - While MDK's buffer is full the download is throttled and the throughput
+//   can't be measured, switching up is then tried one step at a time.
+// Like BufferController it's fed samples by the caller and has no
+// dependencies on MDK or on timers.
+class MDKPLAYER_API VariantSelector
+{
+public:
+    struct Variant
+    {
+        // The index of the video track in MDK's media info.
+        int track = -1;
+        int width = 0;
+        int height = 0;
+        // Bits per second.
+        qint64 bitRate = 0;
+    };
+    using Variants = QList<Variant>;
+
+    struct Settings
+    {
+        // The share of the throughput that is planned with.
+        qreal safetyFactor = 0.75;
+        // Relative to the buffer limit.
+        qreal lowBuffer = 0.3;
+        qreal highBuffer = 0.75;
+        // Milliseconds.
+        qint64 minUpSwitchInterval = 6000;
+        // Bits per second, until the first measurement.
+        qint64 initialThroughput = 3000000;
+    };
+
+    struct Sample
+    {
+        // Milliseconds since the previous sample.
+        qint64 elapsed = 0;
+        // As reported by MDK.
+        qint64 bufferedDuration = 0;
+        qint64 bufferedBytes = 0;
+        qint64 bufferLimit = 0;
+        // Playback position advance since the previous sample.
+        qint64 played = 0;
+    };
+
+    VariantSelector() = default;
+    ~VariantSelector() = default;
+
+    Settings settings() const;
+    void setSettings(const Settings &value);
+
+    // Less than two variants means it's not an adaptive stream.
+    void setVariants(const Variants &value, const int currentTrack);
+    Variants variants() const;
+    bool isAdaptive() const;
+
+    void update(const Sample &sample);
+    // The track that should be played in a view of "viewSize" device
+    // pixels, "cover" if the video fills the view in both directions
+    // (cropped or stretched). The current track if nothing should change.
+    int select(const QSize &viewSize, const bool cover) const;
+    void switched(const int track);
+
+    int currentTrack() const;
+    qint64 currentBitRate() const;
+    // Bits per second, 0 if not measured yet.
+    qint64 throughput() const;
+    int switchCount() const;
+
+private:
+    int currentIndex() const;
+    int capIndex(const QSize &viewSize, const bool cover) const;
+
+private:
+    Settings m_settings = {};
+    // Ordered by bit rate.
+    Variants m_variants = {};
+    int m_currentTrack = -1;
+    qreal m_throughput = 0.0;
+    qint64 m_lastBufferedBytes = -1;
+    qint64 m_bufferedDuration = 0;
+    qint64 m_bufferLimit = 0;
+    qint64 m_sinceSwitch = 0;
+    int m_switchCount = 0;
+};
+
+MDKPLAYER_END_NAMESPACE
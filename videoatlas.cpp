@@ -0,0 +1,270 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "videoatlas.h"
+#include <QtCore/qdebug.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qscopedpointer.h>
+#include <QtQuick/qquickwindow.h>
+#include <QtQuick/qsgtexture.h>
+
+#if QT_CONFIG(opengl)
+#include <QtGui/qopenglcontext.h>
+#include <QtGui/qopenglfunctions.h>
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+#include <QtOpenGL/qopenglframebufferobject.h>
+#else
+#include <QtGui/qopenglframebufferobject.h>
+#endif
+#endif
+
+// Supported by every GPU that runs Qt Quick.
+static constexpr const int kPageSize = 2048;
+// Larger players gain little from batching and would waste the atlas.
+static constexpr const int kMaxTileSize = 512;
+static constexpr const int kMaxPages = 4;
+// Keeps linear filtering from picking up the neighbouring tiles.
+static constexpr const int kTileSpacing = 2;
+// Shelf heights are rounded up to this, so similar tiles share shelves.
+static constexpr const int kShelfAlignment = 16;
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+struct VideoAtlas::Page
+{
+#if QT_CONFIG(opengl)
+    QScopedPointer<QOpenGLFramebufferObject> fbo;
+#endif
+    QScopedPointer<QSGTexture> texture;
+    QList<Shelf> shelves = {};
+    int top = 0;
+    int tiles = 0;
+};
+
+VideoAtlas::VideoAtlas(QQuickWindow *window)
+{
+    m_window = window;
+}
+
+VideoAtlas::~VideoAtlas()
+{
+    qDeleteAll(m_pages);
+    m_pages.clear();
+}
+
+QSharedPointer<VideoAtlas> VideoAtlas::forWindow(QQuickWindow *window)
+{
+    static QMutex mutex;
+    static QHash<QQuickWindow *, QWeakPointer<VideoAtlas>> atlases = {};
+    QMutexLocker locker(&mutex);
+    QSharedPointer<VideoAtlas> atlas = atlases.value(window).toStrongRef();
+    if (!atlas) {
+        atlas.reset(new VideoAtlas(window));
+        atlases.insert(window, atlas);
+    }
+    return atlas;
+}
+
+bool VideoAtlas::fits(const QSize &size)
+{
+    return (!size.isEmpty() && (size.width() <= kMaxTileSize) && (size.height() <= kMaxTileSize));
+}
+
+VideoAtlas::Tile VideoAtlas::allocate(const QSize &size)
+{
+    if (!fits(size)) {
+        return {};
+    }
+    const int width = size.width() + kTileSpacing;
+    const int height = (size.height() + kTileSpacing + kShelfAlignment - 1) / kShelfAlignment * kShelfAlignment;
+    for (int i = 0; i != kMaxPages; ++i) {
+        if ((i == m_pages.size()) && !addPage()) {
+            return {};
+        }
+        const auto page = m_pages.at(i);
+        QPoint pos = {};
+        if (place(page, width, height, &pos)) {
+            ++page->tiles;
+            return {i, QRect(pos, size)};
+        }
+    }
+    return {};
+}
+
+void VideoAtlas::release(const VideoAtlas::Tile &tile)
+{
+    if (!tile.isValid() || (tile.page >= m_pages.size())) {
+        return;
+    }
+    const auto page = m_pages.at(tile.page);
+    if (--page->tiles <= 0) {
+        page->tiles = 0;
+        page->shelves.clear();
+        page->top = 0;
+        return;
+    }
+    for (auto &&shelf : page->shelves) {
+        if (shelf.y != tile.rect.y()) {
+            continue;
+        }
+        int x = tile.rect.x();
+        int width = tile.rect.width() + kTileSpacing;
+        // Merge with the free neighbours, the spans are kept sorted.
+        int i = 0;
+        while ((i != shelf.free.size()) && (shelf.free.at(i).first < x)) {
+            ++i;
+        }
+        if ((i != 0) && ((shelf.free.at(i - 1).first + shelf.free.at(i - 1).second) == x)) {
+            --i;
+            x = shelf.free.at(i).first;
+            width += shelf.free.at(i).second;
+            shelf.free.removeAt(i);
+        }
+        if ((i != shelf.free.size()) && (shelf.free.at(i).first == (x + width))) {
+            width += shelf.free.at(i).second;
+            shelf.free.removeAt(i);
+        }
+        shelf.free.insert(i, {x, width});
+        break;
+    }
+}
+
+QSGTexture *VideoAtlas::texture(const int page) const
+{
+    return m_pages.at(page)->texture.data();
+}
+
+quint32 VideoAtlas::framebuffer(const int page) const
+{
+#if QT_CONFIG(opengl)
+    return m_pages.at(page)->fbo->handle();
+#else
+    Q_UNUSED(page);
+    return 0;
+#endif
+}
+
+QSize VideoAtlas::pageSize() const
+{
+    return {kPageSize, kPageSize};
+}
+
+int VideoAtlas::pageCount() const
+{
+    return m_pages.size();
+}
+
+void VideoAtlas::clear(const VideoAtlas::Tile &tile)
+{
+#if QT_CONFIG(opengl)
+    const auto context = QOpenGLContext::currentContext();
+    if (!tile.isValid() || !context) {
+        return;
+    }
+    const auto f = context->functions();
+    f->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer(tile.page));
+    f->glEnable(GL_SCISSOR_TEST);
+    f->glScissor(tile.rect.x(), tile.rect.y(), tile.rect.width(), tile.rect.height());
+    // The letterbox, MDK leaves it alone in the atlas.
+    f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+    f->glDisable(GL_SCISSOR_TEST);
+#else
+    Q_UNUSED(tile);
+#endif
+}
+
+bool VideoAtlas::addPage()
+{
+#if QT_CONFIG(opengl)
+    const QSize size = pageSize();
+    QScopedPointer<Page> page(new Page);
+    page->fbo.reset(new QOpenGLFramebufferObject(size));
+    if (!page->fbo->isValid()) {
+        qWarning() << "Failed to create a video atlas page.";
+        return false;
+    }
+    // Also the spacing between the tiles, it's sampled at their edges.
+    if (page->fbo->bind()) {
+        const auto f = QOpenGLContext::currentContext()->functions();
+        f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        f->glClear(GL_COLOR_BUFFER_BIT);
+        page->fbo->release();
+    }
+    const auto tex = page->fbo->texture();
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+    page->texture.reset(QNativeInterface::QSGOpenGLTexture::fromNative(tex, m_window, size));
+#elif (QT_VERSION > QT_VERSION_CHECK(5, 14, 0))
+    intmax_t nativeObj = static_cast<intmax_t>(tex);
+    page->texture.reset(m_window->createTextureFromNativeObject(QQuickWindow::NativeObjectTexture, &nativeObj, 0, size));
+#else
+    page->texture.reset(m_window->createTextureFromId(tex, size));
+#endif
+    if (!page->texture) {
+        return false;
+    }
+    m_pages.append(page.take());
+    qDebug() << "Video atlas page" << m_pages.size() << "created for" << m_window;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool VideoAtlas::place(VideoAtlas::Page *page, const int width, const int height, QPoint *pos)
+{
+    for (auto &&shelf : page->shelves) {
+        // Don't waste a tall shelf on a flat tile.
+        if ((shelf.height < height) || (shelf.height > (height * 3 / 2))) {
+            continue;
+        }
+        for (int i = 0; i != shelf.free.size(); ++i) {
+            auto &span = shelf.free[i];
+            if (span.second < width) {
+                continue;
+            }
+            *pos = {span.first, shelf.y};
+            span.first += width;
+            span.second -= width;
+            if (span.second == 0) {
+                shelf.free.removeAt(i);
+            }
+            return true;
+        }
+    }
+    if ((page->top + height) > kPageSize) {
+        return false;
+    }
+    Shelf shelf = {};
+    shelf.y = page->top;
+    shelf.height = height;
+    shelf.free.append({width, kPageSize - width});
+    page->shelves.append(shelf);
+    page->top += height;
+    *pos = {0, shelf.y};
+    return true;
+}
+
+MDKPLAYER_END_NAMESPACE
@@ -0,0 +1,95 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "mdkplayer_global.h"
+#include <QtCore/qlist.h>
+#include <QtCore/qrect.h>
+#include <QtCore/qsharedpointer.h>
+
+QT_BEGIN_NAMESPACE
+QT_FORWARD_DECLARE_CLASS(QQuickWindow)
+QT_FORWARD_DECLARE_CLASS(QSGTexture)
+QT_END_NAMESPACE
+
+MDKPLAYER_BEGIN_NAMESPACE
+
+// A few large render targets shared by the small players of one window.
+// Every player renders into its own tile, so all of their nodes use the
+// same texture and the scenegraph can draw them in one batch instead of
+// one draw call per tile. Tiles are packed into shelves of similar height.
+// OpenGL only, lives on the render thread of its window.
+class VideoAtlas
+{
+    Q_DISABLE_COPY_MOVE(VideoAtlas)
+
+public:
+    struct Tile
+    {
+        int page = -1;
+        QRect rect = {};
+
+        bool isValid() const { return (page >= 0); }
+    };
+
+    explicit VideoAtlas(QQuickWindow *window);
+    ~VideoAtlas();
+
+    // The nodes of a window share its atlas, it's gone with the last one.
+    static QSharedPointer<VideoAtlas> forWindow(QQuickWindow *window);
+
+    static bool fits(const QSize &size);
+
+    // Returns an invalid tile if the atlas is full.
+    Tile allocate(const QSize &size);
+    void release(const Tile &tile);
+
+    QSGTexture *texture(const int page) const;
+    quint32 framebuffer(const int page) const;
+    QSize pageSize() const;
+    int pageCount() const;
+
+    // Nothing but the tile may be cleared, the players render one by one.
+    void clear(const Tile &tile);
+
+private:
+    struct Shelf
+    {
+        int y = 0;
+        int height = 0;
+        // x and width of the unused parts.
+        QList<QPair<int, int>> free = {};
+    };
+    struct Page;
+
+    bool addPage();
+    static bool place(Page *page, const int width, const int height, QPoint *pos);
+
+private:
+    QQuickWindow *m_window = nullptr;
+    QList<Page *> m_pages = {};
+};
+
+MDKPLAYER_END_NAMESPACE
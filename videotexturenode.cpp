@@ -26,6 +26,7 @@
 #include "mdkplayer.h"
 #include <QtQuick/qquickwindow.h>
 #include <QtGui/qscreen.h>
+#include <QtCore/qelapsedtimer.h>
 #include <mdk/Player.h>
 
 MDKPLAYER_BEGIN_NAMESPACE
@@ -44,7 +45,9 @@ VideoTextureNode::VideoTextureNode(MDKPlayer *item)
 
 VideoTextureNode::~VideoTextureNode()
 {
-    delete texture();
+    if (!m_sharedTexture) {
+        delete texture();
+    }
     // When device lost occurs
     const auto player = m_player.lock();
     if (!player) {
@@ -68,7 +71,9 @@ void VideoTextureNode::sync()
 #else
     const QSize newSize = {qRound(m_item->width() * dpr), qRound(m_item->height() * dpr)};
 #endif
-    if (texture() && (newSize == m_size)) {
+    const auto item = static_cast<MDKPlayer *>(m_item);
+    const bool useAtlas = item->m_textureAtlas;
+    if (texture() && (newSize == m_size) && (useAtlas == m_useAtlas)) {
         return;
     }
     const auto player = m_player.lock();
@@ -76,18 +81,33 @@ void VideoTextureNode::sync()
         return;
     }
     m_size = newSize;
+    m_useAtlas = useAtlas;
+    const bool ownedTexture = !m_sharedTexture;
     const auto tex = ensureTexture(player.data(), m_size);
     if (!tex) {
         return;
     }
-    delete texture();
+    if (ownedTexture && (tex != texture())) {
+        delete texture();
+    }
     setTexture(tex);
     // MUST set when texture() is available
     setTextureCoordinatesTransform(m_transformMode);
     setFiltering(QSGTexture::Linear);
+    // An empty rect selects the whole texture.
+    setSourceRect(QRectF(m_sourceRect));
     // Qt's own API will apply correct DPR automatically. Don't double scale.
     setRect(0, 0, m_item->width(), m_item->height());
-    player->setVideoSurfaceSize(m_size.width(), m_size.height());
+    // A tile is placed on the surface with the video viewport.
+    const QSize surfaceSize = m_sharedTexture ? tex->textureSize() : m_size;
+    player->setVideoSurfaceSize(surfaceSize.width(), surfaceSize.height());
+    // The gui thread is blocked while we are here. Picked up by the next
+    // variant selection.
+    item->m_renderSize = m_size;
+    if (item->m_atlasPage != m_atlasPage) {
+        item->m_atlasPage = m_atlasPage;
+        QMetaObject::invokeMethod(item, "atlasPageChanged", Qt::QueuedConnection);
+    }
 }
 
 // This is hooked up to beforeRendering() so we can start our own render
@@ -100,7 +120,17 @@ void VideoTextureNode::render()
     if (!player) {
         return;
     }
+    const auto item = static_cast<MDKPlayer *>(m_item);
+    if (item->m_skipRendering.loadAcquire()) {
+        item->m_skippedRenders.fetchAndAddOrdered(1);
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    prepareRender();
     player->renderVideo();
+    item->m_renderTime.fetchAndAddOrdered(timer.nsecsElapsed());
+    item->m_renderCount.fetchAndAddOrdered(1);
 }
 
 MDKPLAYER_END_NAMESPACE
@@ -60,12 +60,21 @@ private Q_SLOTS:
 
 private:
     virtual QSGTexture *ensureTexture(MDK_NS_PREPEND(Player) *player, const QSize &size) = 0;
+    // Called on the render thread right before the frame is rendered.
+    virtual void prepareRender() {}
 
 protected:
     TextureCoordinatesTransformMode m_transformMode = TextureCoordinatesTransformFlag::NoTransform;
     QQuickWindow *m_window = nullptr;
     QQuickItem *m_item = nullptr;
     QSize m_size = {};
+    // Whether the player asked for a tile of the window's VideoAtlas.
+    bool m_useAtlas = false;
+    // Set by ensureTexture() if the texture isn't ours to delete. Only the
+    // sourceRect part of it belongs to this node then.
+    bool m_sharedTexture = false;
+    QRect m_sourceRect = {};
+    int m_atlasPage = -1;
 
 private:
     QWeakPointer<MDK_NS_PREPEND(Player)> m_player;
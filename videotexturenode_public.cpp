@@ -23,6 +23,7 @@
  */
 
 #include "videotexturenode.h"
+#include "videoatlas.h"
 #include <QtQuick/qquickwindow.h>
 
 #ifdef Q_OS_WINDOWS
@@ -77,6 +78,7 @@ public:
         // Release gfx resources
 #if QT_CONFIG(opengl)
         fbo_gl.reset();
+        releaseTile();
 #endif
 #if QT_CONFIG(vulkan) && __has_include(<vulkan/vulkan.h>)
         freeTexture();
@@ -85,6 +87,11 @@ public:
 
 private:
     QSGTexture *ensureTexture(MDK_NS_PREPEND(Player) *player, const QSize &size) override;
+#if QT_CONFIG(opengl)
+    void prepareRender() override;
+    QSGTexture *ensureTile(MDK_NS_PREPEND(Player) *player, const QSize &size);
+    void releaseTile();
+#endif
 #if QT_CONFIG(vulkan) && __has_include(<vulkan/vulkan.h>)
     bool buildTexture(const QSize &size);
     void freeTexture();
@@ -93,6 +100,8 @@ private:
 private:
 #if QT_CONFIG(opengl)
     QScopedPointer<QOpenGLFramebufferObject> fbo_gl;
+    QSharedPointer<VideoAtlas> m_atlas;
+    VideoAtlas::Tile m_tile = {};
 #endif
 #ifdef Q_OS_WINDOWS
     Microsoft::WRL::ComPtr<ID3D11Texture2D> m_texture_d3d11 = nullptr;
@@ -131,6 +140,18 @@ QSGTexture *VideoTextureNodePublic::ensureTexture(MDK_NS_PREPEND(Player) *player
     {
 #if QT_CONFIG(opengl)
         m_transformMode = TextureCoordinatesTransformFlag::MirrorVertically;
+        if (m_useAtlas) {
+            if (const auto tex = ensureTile(player, size)) {
+                fbo_gl.reset();
+                return tex;
+            }
+        }
+        if (m_sharedTexture) {
+            releaseTile();
+            m_sharedTexture = false;
+            player->setVideoViewport(0.0f, 0.0f, 1.0f, 1.0f);
+            player->setBackgroundColor(0.0f, 0.0f, 0.0f, 0.0f);
+        }
         fbo_gl.reset(new QOpenGLFramebufferObject(size));
         MDK_NS_PREPEND(GLRenderAPI) ra = {};
         ra.fbo = fbo_gl->handle();
@@ -266,6 +287,62 @@ QSGTexture *VideoTextureNodePublic::ensureTexture(MDK_NS_PREPEND(Player) *player
     return nullptr;
 }
 
+#if QT_CONFIG(opengl)
+void VideoTextureNodePublic::prepareRender()
+{
+    if (m_atlas && m_tile.isValid()) {
+        m_atlas->clear(m_tile);
+    }
+}
+
+QSGTexture *VideoTextureNodePublic::ensureTile(MDK_NS_PREPEND(Player) *player, const QSize &size)
+{
+    if (!VideoAtlas::fits(size)) {
+        return nullptr;
+    }
+    if (!m_atlas) {
+        m_atlas = VideoAtlas::forWindow(m_window);
+    }
+    // Give the old tile back first, the new one may take its place.
+    if (m_tile.isValid()) {
+        m_atlas->release(m_tile);
+        m_tile = {};
+    }
+    const VideoAtlas::Tile tile = m_atlas->allocate(size);
+    if (!tile.isValid()) {
+        qDebug() << "The video atlas is full, rendering" << size << "on its own.";
+        return nullptr;
+    }
+    m_tile = tile;
+    MDK_NS_PREPEND(GLRenderAPI) ra = {};
+    ra.fbo = m_atlas->framebuffer(m_tile.page);
+    player->setRenderAPI(&ra);
+    // MDK would clear the whole page, prepareRender() clears the tile.
+    player->setBackgroundColor(0.0f, 0.0f, 0.0f, -1.0f);
+    // The viewport is measured from the top of the surface, and MDK renders
+    // upside down into framebuffers, which is why the image is mirrored.
+    const QSize pageSize = m_atlas->pageSize();
+    player->setVideoViewport(float(m_tile.rect.x()) / float(pageSize.width()),
+                             float(pageSize.height() - m_tile.rect.bottom() - 1) / float(pageSize.height()),
+                             float(m_tile.rect.width()) / float(pageSize.width()),
+                             float(m_tile.rect.height()) / float(pageSize.height()));
+    m_sharedTexture = true;
+    m_sourceRect = m_tile.rect;
+    m_atlasPage = m_tile.page;
+    return m_atlas->texture(m_tile.page);
+}
+
+void VideoTextureNodePublic::releaseTile()
+{
+    if (m_atlas && m_tile.isValid()) {
+        m_atlas->release(m_tile);
+    }
+    m_tile = {};
+    m_sourceRect = {};
+    m_atlasPage = -1;
+}
+#endif
+
 #if QT_CONFIG(vulkan) && __has_include(<vulkan/vulkan.h>)
 bool VideoTextureNodePublic::buildTexture(const QSize &size)
 {